@@ -20,9 +20,14 @@
 #include <algorithm>
 #include <iostream>
 #include <vector>
-#include <unordered_map>
 #include <unordered_set>
 #include <iterator>
+#include <atomic>
+#include <thread>
+#include <system_error>
+#include <mutex>
+#include <list>
+#include <map>
 #include "src/mine-common.h"
 #include "src/base16.h"
 #include "src/base64.h"
@@ -43,6 +48,31 @@ void endProfiling(T& started, const std::string& name) {
 
 #endif
 
+#if defined(__GNUC__) || defined(__clang__)
+#   define MINE_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#   define MINE_ALWAYS_INLINE __forceinline
+#else
+#   define MINE_ALWAYS_INLINE inline
+#endif
+
+#if !defined(MINE_DISABLE_AES_NI) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#   define MINE_AES_NI 1
+#   include <cpuid.h>
+#   include <immintrin.h>
+#   define MINE_TARGET_AES_NI __attribute__((target("aes,sse4.1")))
+#   define MINE_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#else
+#   define MINE_AES_NI 0
+#endif
+
+#if MINE_AES_NI && defined(__x86_64__) && !defined(MINE_DISABLE_VAES) && ((defined(__clang__) && __clang_major__ >= 6) || (!defined(__clang__) && __GNUC__ >= 8))
+#   define MINE_VAES 1
+#   define MINE_TARGET_VAES __attribute__((target("vaes,avx512f,avx512bw,aes,sse4.1")))
+#else
+#   define MINE_VAES 0
+#endif
+
 using namespace mine;
 
 const byte AES::kSBox[256] = {
@@ -87,894 +117,5582 @@ const uint8_t AES::kRoundConstant[10] = {
     0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
 };
 
-const std::unordered_map<uint8_t, std::vector<uint8_t>> AES::kKeyParams = {
-    { 16, {{ 4, 10 }} },
-    { 24, {{ 6, 12 }} },
-    { 32, {{ 8, 14 }} }
+const uint32_t AES::kTe0[256] = {
+    0xc66363a5, 0xf87c7c84, 0xee777799, 0xf67b7b8d, 0xfff2f20d, 0xd66b6bbd, 0xde6f6fb1, 0x91c5c554,
+    0x60303050, 0x02010103, 0xce6767a9, 0x562b2b7d, 0xe7fefe19, 0xb5d7d762, 0x4dababe6, 0xec76769a,
+    0x8fcaca45, 0x1f82829d, 0x89c9c940, 0xfa7d7d87, 0xeffafa15, 0xb25959eb, 0x8e4747c9, 0xfbf0f00b,
+    0x41adadec, 0xb3d4d467, 0x5fa2a2fd, 0x45afafea, 0x239c9cbf, 0x53a4a4f7, 0xe4727296, 0x9bc0c05b,
+    0x75b7b7c2, 0xe1fdfd1c, 0x3d9393ae, 0x4c26266a, 0x6c36365a, 0x7e3f3f41, 0xf5f7f702, 0x83cccc4f,
+    0x6834345c, 0x51a5a5f4, 0xd1e5e534, 0xf9f1f108, 0xe2717193, 0xabd8d873, 0x62313153, 0x2a15153f,
+    0x0804040c, 0x95c7c752, 0x46232365, 0x9dc3c35e, 0x30181828, 0x379696a1, 0x0a05050f, 0x2f9a9ab5,
+    0x0e070709, 0x24121236, 0x1b80809b, 0xdfe2e23d, 0xcdebeb26, 0x4e272769, 0x7fb2b2cd, 0xea75759f,
+    0x1209091b, 0x1d83839e, 0x582c2c74, 0x341a1a2e, 0x361b1b2d, 0xdc6e6eb2, 0xb45a5aee, 0x5ba0a0fb,
+    0xa45252f6, 0x763b3b4d, 0xb7d6d661, 0x7db3b3ce, 0x5229297b, 0xdde3e33e, 0x5e2f2f71, 0x13848497,
+    0xa65353f5, 0xb9d1d168, 0x00000000, 0xc1eded2c, 0x40202060, 0xe3fcfc1f, 0x79b1b1c8, 0xb65b5bed,
+    0xd46a6abe, 0x8dcbcb46, 0x67bebed9, 0x7239394b, 0x944a4ade, 0x984c4cd4, 0xb05858e8, 0x85cfcf4a,
+    0xbbd0d06b, 0xc5efef2a, 0x4faaaae5, 0xedfbfb16, 0x864343c5, 0x9a4d4dd7, 0x66333355, 0x11858594,
+    0x8a4545cf, 0xe9f9f910, 0x04020206, 0xfe7f7f81, 0xa05050f0, 0x783c3c44, 0x259f9fba, 0x4ba8a8e3,
+    0xa25151f3, 0x5da3a3fe, 0x804040c0, 0x058f8f8a, 0x3f9292ad, 0x219d9dbc, 0x70383848, 0xf1f5f504,
+    0x63bcbcdf, 0x77b6b6c1, 0xafdada75, 0x42212163, 0x20101030, 0xe5ffff1a, 0xfdf3f30e, 0xbfd2d26d,
+    0x81cdcd4c, 0x180c0c14, 0x26131335, 0xc3ecec2f, 0xbe5f5fe1, 0x359797a2, 0x884444cc, 0x2e171739,
+    0x93c4c457, 0x55a7a7f2, 0xfc7e7e82, 0x7a3d3d47, 0xc86464ac, 0xba5d5de7, 0x3219192b, 0xe6737395,
+    0xc06060a0, 0x19818198, 0x9e4f4fd1, 0xa3dcdc7f, 0x44222266, 0x542a2a7e, 0x3b9090ab, 0x0b888883,
+    0x8c4646ca, 0xc7eeee29, 0x6bb8b8d3, 0x2814143c, 0xa7dede79, 0xbc5e5ee2, 0x160b0b1d, 0xaddbdb76,
+    0xdbe0e03b, 0x64323256, 0x743a3a4e, 0x140a0a1e, 0x924949db, 0x0c06060a, 0x4824246c, 0xb85c5ce4,
+    0x9fc2c25d, 0xbdd3d36e, 0x43acacef, 0xc46262a6, 0x399191a8, 0x319595a4, 0xd3e4e437, 0xf279798b,
+    0xd5e7e732, 0x8bc8c843, 0x6e373759, 0xda6d6db7, 0x018d8d8c, 0xb1d5d564, 0x9c4e4ed2, 0x49a9a9e0,
+    0xd86c6cb4, 0xac5656fa, 0xf3f4f407, 0xcfeaea25, 0xca6565af, 0xf47a7a8e, 0x47aeaee9, 0x10080818,
+    0x6fbabad5, 0xf0787888, 0x4a25256f, 0x5c2e2e72, 0x381c1c24, 0x57a6a6f1, 0x73b4b4c7, 0x97c6c651,
+    0xcbe8e823, 0xa1dddd7c, 0xe874749c, 0x3e1f1f21, 0x964b4bdd, 0x61bdbddc, 0x0d8b8b86, 0x0f8a8a85,
+    0xe0707090, 0x7c3e3e42, 0x71b5b5c4, 0xcc6666aa, 0x904848d8, 0x06030305, 0xf7f6f601, 0x1c0e0e12,
+    0xc26161a3, 0x6a35355f, 0xae5757f9, 0x69b9b9d0, 0x17868691, 0x99c1c158, 0x3a1d1d27, 0x279e9eb9,
+    0xd9e1e138, 0xebf8f813, 0x2b9898b3, 0x22111133, 0xd26969bb, 0xa9d9d970, 0x078e8e89, 0x339494a7,
+    0x2d9b9bb6, 0x3c1e1e22, 0x15878792, 0xc9e9e920, 0x87cece49, 0xaa5555ff, 0x50282878, 0xa5dfdf7a,
+    0x038c8c8f, 0x59a1a1f8, 0x09898980, 0x1a0d0d17, 0x65bfbfda, 0xd7e6e631, 0x844242c6, 0xd06868b8,
+    0x824141c3, 0x299999b0, 0x5a2d2d77, 0x1e0f0f11, 0x7bb0b0cb, 0xa85454fc, 0x6dbbbbd6, 0x2c16163a
 };
 
-AES::AES(const std::string& key)
+const uint32_t AES::kTe1[256] = {
+    0xa5c66363, 0x84f87c7c, 0x99ee7777, 0x8df67b7b, 0x0dfff2f2, 0xbdd66b6b, 0xb1de6f6f, 0x5491c5c5,
+    0x50603030, 0x03020101, 0xa9ce6767, 0x7d562b2b, 0x19e7fefe, 0x62b5d7d7, 0xe64dabab, 0x9aec7676,
+    0x458fcaca, 0x9d1f8282, 0x4089c9c9, 0x87fa7d7d, 0x15effafa, 0xebb25959, 0xc98e4747, 0x0bfbf0f0,
+    0xec41adad, 0x67b3d4d4, 0xfd5fa2a2, 0xea45afaf, 0xbf239c9c, 0xf753a4a4, 0x96e47272, 0x5b9bc0c0,
+    0xc275b7b7, 0x1ce1fdfd, 0xae3d9393, 0x6a4c2626, 0x5a6c3636, 0x417e3f3f, 0x02f5f7f7, 0x4f83cccc,
+    0x5c683434, 0xf451a5a5, 0x34d1e5e5, 0x08f9f1f1, 0x93e27171, 0x73abd8d8, 0x53623131, 0x3f2a1515,
+    0x0c080404, 0x5295c7c7, 0x65462323, 0x5e9dc3c3, 0x28301818, 0xa1379696, 0x0f0a0505, 0xb52f9a9a,
+    0x090e0707, 0x36241212, 0x9b1b8080, 0x3ddfe2e2, 0x26cdebeb, 0x694e2727, 0xcd7fb2b2, 0x9fea7575,
+    0x1b120909, 0x9e1d8383, 0x74582c2c, 0x2e341a1a, 0x2d361b1b, 0xb2dc6e6e, 0xeeb45a5a, 0xfb5ba0a0,
+    0xf6a45252, 0x4d763b3b, 0x61b7d6d6, 0xce7db3b3, 0x7b522929, 0x3edde3e3, 0x715e2f2f, 0x97138484,
+    0xf5a65353, 0x68b9d1d1, 0x00000000, 0x2cc1eded, 0x60402020, 0x1fe3fcfc, 0xc879b1b1, 0xedb65b5b,
+    0xbed46a6a, 0x468dcbcb, 0xd967bebe, 0x4b723939, 0xde944a4a, 0xd4984c4c, 0xe8b05858, 0x4a85cfcf,
+    0x6bbbd0d0, 0x2ac5efef, 0xe54faaaa, 0x16edfbfb, 0xc5864343, 0xd79a4d4d, 0x55663333, 0x94118585,
+    0xcf8a4545, 0x10e9f9f9, 0x06040202, 0x81fe7f7f, 0xf0a05050, 0x44783c3c, 0xba259f9f, 0xe34ba8a8,
+    0xf3a25151, 0xfe5da3a3, 0xc0804040, 0x8a058f8f, 0xad3f9292, 0xbc219d9d, 0x48703838, 0x04f1f5f5,
+    0xdf63bcbc, 0xc177b6b6, 0x75afdada, 0x63422121, 0x30201010, 0x1ae5ffff, 0x0efdf3f3, 0x6dbfd2d2,
+    0x4c81cdcd, 0x14180c0c, 0x35261313, 0x2fc3ecec, 0xe1be5f5f, 0xa2359797, 0xcc884444, 0x392e1717,
+    0x5793c4c4, 0xf255a7a7, 0x82fc7e7e, 0x477a3d3d, 0xacc86464, 0xe7ba5d5d, 0x2b321919, 0x95e67373,
+    0xa0c06060, 0x98198181, 0xd19e4f4f, 0x7fa3dcdc, 0x66442222, 0x7e542a2a, 0xab3b9090, 0x830b8888,
+    0xca8c4646, 0x29c7eeee, 0xd36bb8b8, 0x3c281414, 0x79a7dede, 0xe2bc5e5e, 0x1d160b0b, 0x76addbdb,
+    0x3bdbe0e0, 0x56643232, 0x4e743a3a, 0x1e140a0a, 0xdb924949, 0x0a0c0606, 0x6c482424, 0xe4b85c5c,
+    0x5d9fc2c2, 0x6ebdd3d3, 0xef43acac, 0xa6c46262, 0xa8399191, 0xa4319595, 0x37d3e4e4, 0x8bf27979,
+    0x32d5e7e7, 0x438bc8c8, 0x596e3737, 0xb7da6d6d, 0x8c018d8d, 0x64b1d5d5, 0xd29c4e4e, 0xe049a9a9,
+    0xb4d86c6c, 0xfaac5656, 0x07f3f4f4, 0x25cfeaea, 0xafca6565, 0x8ef47a7a, 0xe947aeae, 0x18100808,
+    0xd56fbaba, 0x88f07878, 0x6f4a2525, 0x725c2e2e, 0x24381c1c, 0xf157a6a6, 0xc773b4b4, 0x5197c6c6,
+    0x23cbe8e8, 0x7ca1dddd, 0x9ce87474, 0x213e1f1f, 0xdd964b4b, 0xdc61bdbd, 0x860d8b8b, 0x850f8a8a,
+    0x90e07070, 0x427c3e3e, 0xc471b5b5, 0xaacc6666, 0xd8904848, 0x05060303, 0x01f7f6f6, 0x121c0e0e,
+    0xa3c26161, 0x5f6a3535, 0xf9ae5757, 0xd069b9b9, 0x91178686, 0x5899c1c1, 0x273a1d1d, 0xb9279e9e,
+    0x38d9e1e1, 0x13ebf8f8, 0xb32b9898, 0x33221111, 0xbbd26969, 0x70a9d9d9, 0x89078e8e, 0xa7339494,
+    0xb62d9b9b, 0x223c1e1e, 0x92158787, 0x20c9e9e9, 0x4987cece, 0xffaa5555, 0x78502828, 0x7aa5dfdf,
+    0x8f038c8c, 0xf859a1a1, 0x80098989, 0x171a0d0d, 0xda65bfbf, 0x31d7e6e6, 0xc6844242, 0xb8d06868,
+    0xc3824141, 0xb0299999, 0x775a2d2d, 0x111e0f0f, 0xcb7bb0b0, 0xfca85454, 0xd66dbbbb, 0x3a2c1616
+};
+
+const uint32_t AES::kTe2[256] = {
+    0x63a5c663, 0x7c84f87c, 0x7799ee77, 0x7b8df67b, 0xf20dfff2, 0x6bbdd66b, 0x6fb1de6f, 0xc55491c5,
+    0x30506030, 0x01030201, 0x67a9ce67, 0x2b7d562b, 0xfe19e7fe, 0xd762b5d7, 0xabe64dab, 0x769aec76,
+    0xca458fca, 0x829d1f82, 0xc94089c9, 0x7d87fa7d, 0xfa15effa, 0x59ebb259, 0x47c98e47, 0xf00bfbf0,
+    0xadec41ad, 0xd467b3d4, 0xa2fd5fa2, 0xafea45af, 0x9cbf239c, 0xa4f753a4, 0x7296e472, 0xc05b9bc0,
+    0xb7c275b7, 0xfd1ce1fd, 0x93ae3d93, 0x266a4c26, 0x365a6c36, 0x3f417e3f, 0xf702f5f7, 0xcc4f83cc,
+    0x345c6834, 0xa5f451a5, 0xe534d1e5, 0xf108f9f1, 0x7193e271, 0xd873abd8, 0x31536231, 0x153f2a15,
+    0x040c0804, 0xc75295c7, 0x23654623, 0xc35e9dc3, 0x18283018, 0x96a13796, 0x050f0a05, 0x9ab52f9a,
+    0x07090e07, 0x12362412, 0x809b1b80, 0xe23ddfe2, 0xeb26cdeb, 0x27694e27, 0xb2cd7fb2, 0x759fea75,
+    0x091b1209, 0x839e1d83, 0x2c74582c, 0x1a2e341a, 0x1b2d361b, 0x6eb2dc6e, 0x5aeeb45a, 0xa0fb5ba0,
+    0x52f6a452, 0x3b4d763b, 0xd661b7d6, 0xb3ce7db3, 0x297b5229, 0xe33edde3, 0x2f715e2f, 0x84971384,
+    0x53f5a653, 0xd168b9d1, 0x00000000, 0xed2cc1ed, 0x20604020, 0xfc1fe3fc, 0xb1c879b1, 0x5bedb65b,
+    0x6abed46a, 0xcb468dcb, 0xbed967be, 0x394b7239, 0x4ade944a, 0x4cd4984c, 0x58e8b058, 0xcf4a85cf,
+    0xd06bbbd0, 0xef2ac5ef, 0xaae54faa, 0xfb16edfb, 0x43c58643, 0x4dd79a4d, 0x33556633, 0x85941185,
+    0x45cf8a45, 0xf910e9f9, 0x02060402, 0x7f81fe7f, 0x50f0a050, 0x3c44783c, 0x9fba259f, 0xa8e34ba8,
+    0x51f3a251, 0xa3fe5da3, 0x40c08040, 0x8f8a058f, 0x92ad3f92, 0x9dbc219d, 0x38487038, 0xf504f1f5,
+    0xbcdf63bc, 0xb6c177b6, 0xda75afda, 0x21634221, 0x10302010, 0xff1ae5ff, 0xf30efdf3, 0xd26dbfd2,
+    0xcd4c81cd, 0x0c14180c, 0x13352613, 0xec2fc3ec, 0x5fe1be5f, 0x97a23597, 0x44cc8844, 0x17392e17,
+    0xc45793c4, 0xa7f255a7, 0x7e82fc7e, 0x3d477a3d, 0x64acc864, 0x5de7ba5d, 0x192b3219, 0x7395e673,
+    0x60a0c060, 0x81981981, 0x4fd19e4f, 0xdc7fa3dc, 0x22664422, 0x2a7e542a, 0x90ab3b90, 0x88830b88,
+    0x46ca8c46, 0xee29c7ee, 0xb8d36bb8, 0x143c2814, 0xde79a7de, 0x5ee2bc5e, 0x0b1d160b, 0xdb76addb,
+    0xe03bdbe0, 0x32566432, 0x3a4e743a, 0x0a1e140a, 0x49db9249, 0x060a0c06, 0x246c4824, 0x5ce4b85c,
+    0xc25d9fc2, 0xd36ebdd3, 0xacef43ac, 0x62a6c462, 0x91a83991, 0x95a43195, 0xe437d3e4, 0x798bf279,
+    0xe732d5e7, 0xc8438bc8, 0x37596e37, 0x6db7da6d, 0x8d8c018d, 0xd564b1d5, 0x4ed29c4e, 0xa9e049a9,
+    0x6cb4d86c, 0x56faac56, 0xf407f3f4, 0xea25cfea, 0x65afca65, 0x7a8ef47a, 0xaee947ae, 0x08181008,
+    0xbad56fba, 0x7888f078, 0x256f4a25, 0x2e725c2e, 0x1c24381c, 0xa6f157a6, 0xb4c773b4, 0xc65197c6,
+    0xe823cbe8, 0xdd7ca1dd, 0x749ce874, 0x1f213e1f, 0x4bdd964b, 0xbddc61bd, 0x8b860d8b, 0x8a850f8a,
+    0x7090e070, 0x3e427c3e, 0xb5c471b5, 0x66aacc66, 0x48d89048, 0x03050603, 0xf601f7f6, 0x0e121c0e,
+    0x61a3c261, 0x355f6a35, 0x57f9ae57, 0xb9d069b9, 0x86911786, 0xc15899c1, 0x1d273a1d, 0x9eb9279e,
+    0xe138d9e1, 0xf813ebf8, 0x98b32b98, 0x11332211, 0x69bbd269, 0xd970a9d9, 0x8e89078e, 0x94a73394,
+    0x9bb62d9b, 0x1e223c1e, 0x87921587, 0xe920c9e9, 0xce4987ce, 0x55ffaa55, 0x28785028, 0xdf7aa5df,
+    0x8c8f038c, 0xa1f859a1, 0x89800989, 0x0d171a0d, 0xbfda65bf, 0xe631d7e6, 0x42c68442, 0x68b8d068,
+    0x41c38241, 0x99b02999, 0x2d775a2d, 0x0f111e0f, 0xb0cb7bb0, 0x54fca854, 0xbbd66dbb, 0x163a2c16
+};
+
+const uint32_t AES::kTe3[256] = {
+    0x6363a5c6, 0x7c7c84f8, 0x777799ee, 0x7b7b8df6, 0xf2f20dff, 0x6b6bbdd6, 0x6f6fb1de, 0xc5c55491,
+    0x30305060, 0x01010302, 0x6767a9ce, 0x2b2b7d56, 0xfefe19e7, 0xd7d762b5, 0xababe64d, 0x76769aec,
+    0xcaca458f, 0x82829d1f, 0xc9c94089, 0x7d7d87fa, 0xfafa15ef, 0x5959ebb2, 0x4747c98e, 0xf0f00bfb,
+    0xadadec41, 0xd4d467b3, 0xa2a2fd5f, 0xafafea45, 0x9c9cbf23, 0xa4a4f753, 0x727296e4, 0xc0c05b9b,
+    0xb7b7c275, 0xfdfd1ce1, 0x9393ae3d, 0x26266a4c, 0x36365a6c, 0x3f3f417e, 0xf7f702f5, 0xcccc4f83,
+    0x34345c68, 0xa5a5f451, 0xe5e534d1, 0xf1f108f9, 0x717193e2, 0xd8d873ab, 0x31315362, 0x15153f2a,
+    0x04040c08, 0xc7c75295, 0x23236546, 0xc3c35e9d, 0x18182830, 0x9696a137, 0x05050f0a, 0x9a9ab52f,
+    0x0707090e, 0x12123624, 0x80809b1b, 0xe2e23ddf, 0xebeb26cd, 0x2727694e, 0xb2b2cd7f, 0x75759fea,
+    0x09091b12, 0x83839e1d, 0x2c2c7458, 0x1a1a2e34, 0x1b1b2d36, 0x6e6eb2dc, 0x5a5aeeb4, 0xa0a0fb5b,
+    0x5252f6a4, 0x3b3b4d76, 0xd6d661b7, 0xb3b3ce7d, 0x29297b52, 0xe3e33edd, 0x2f2f715e, 0x84849713,
+    0x5353f5a6, 0xd1d168b9, 0x00000000, 0xeded2cc1, 0x20206040, 0xfcfc1fe3, 0xb1b1c879, 0x5b5bedb6,
+    0x6a6abed4, 0xcbcb468d, 0xbebed967, 0x39394b72, 0x4a4ade94, 0x4c4cd498, 0x5858e8b0, 0xcfcf4a85,
+    0xd0d06bbb, 0xefef2ac5, 0xaaaae54f, 0xfbfb16ed, 0x4343c586, 0x4d4dd79a, 0x33335566, 0x85859411,
+    0x4545cf8a, 0xf9f910e9, 0x02020604, 0x7f7f81fe, 0x5050f0a0, 0x3c3c4478, 0x9f9fba25, 0xa8a8e34b,
+    0x5151f3a2, 0xa3a3fe5d, 0x4040c080, 0x8f8f8a05, 0x9292ad3f, 0x9d9dbc21, 0x38384870, 0xf5f504f1,
+    0xbcbcdf63, 0xb6b6c177, 0xdada75af, 0x21216342, 0x10103020, 0xffff1ae5, 0xf3f30efd, 0xd2d26dbf,
+    0xcdcd4c81, 0x0c0c1418, 0x13133526, 0xecec2fc3, 0x5f5fe1be, 0x9797a235, 0x4444cc88, 0x1717392e,
+    0xc4c45793, 0xa7a7f255, 0x7e7e82fc, 0x3d3d477a, 0x6464acc8, 0x5d5de7ba, 0x19192b32, 0x737395e6,
+    0x6060a0c0, 0x81819819, 0x4f4fd19e, 0xdcdc7fa3, 0x22226644, 0x2a2a7e54, 0x9090ab3b, 0x8888830b,
+    0x4646ca8c, 0xeeee29c7, 0xb8b8d36b, 0x14143c28, 0xdede79a7, 0x5e5ee2bc, 0x0b0b1d16, 0xdbdb76ad,
+    0xe0e03bdb, 0x32325664, 0x3a3a4e74, 0x0a0a1e14, 0x4949db92, 0x06060a0c, 0x24246c48, 0x5c5ce4b8,
+    0xc2c25d9f, 0xd3d36ebd, 0xacacef43, 0x6262a6c4, 0x9191a839, 0x9595a431, 0xe4e437d3, 0x79798bf2,
+    0xe7e732d5, 0xc8c8438b, 0x3737596e, 0x6d6db7da, 0x8d8d8c01, 0xd5d564b1, 0x4e4ed29c, 0xa9a9e049,
+    0x6c6cb4d8, 0x5656faac, 0xf4f407f3, 0xeaea25cf, 0x6565afca, 0x7a7a8ef4, 0xaeaee947, 0x08081810,
+    0xbabad56f, 0x787888f0, 0x25256f4a, 0x2e2e725c, 0x1c1c2438, 0xa6a6f157, 0xb4b4c773, 0xc6c65197,
+    0xe8e823cb, 0xdddd7ca1, 0x74749ce8, 0x1f1f213e, 0x4b4bdd96, 0xbdbddc61, 0x8b8b860d, 0x8a8a850f,
+    0x707090e0, 0x3e3e427c, 0xb5b5c471, 0x6666aacc, 0x4848d890, 0x03030506, 0xf6f601f7, 0x0e0e121c,
+    0x6161a3c2, 0x35355f6a, 0x5757f9ae, 0xb9b9d069, 0x86869117, 0xc1c15899, 0x1d1d273a, 0x9e9eb927,
+    0xe1e138d9, 0xf8f813eb, 0x9898b32b, 0x11113322, 0x6969bbd2, 0xd9d970a9, 0x8e8e8907, 0x9494a733,
+    0x9b9bb62d, 0x1e1e223c, 0x87879215, 0xe9e920c9, 0xcece4987, 0x5555ffaa, 0x28287850, 0xdfdf7aa5,
+    0x8c8c8f03, 0xa1a1f859, 0x89898009, 0x0d0d171a, 0xbfbfda65, 0xe6e631d7, 0x4242c684, 0x6868b8d0,
+    0x4141c382, 0x9999b029, 0x2d2d775a, 0x0f0f111e, 0xb0b0cb7b, 0x5454fca8, 0xbbbbd66d, 0x16163a2c
+};
+
+const uint32_t AES::kTd0[256] = {
+    0x51f4a750, 0x7e416553, 0x1a17a4c3, 0x3a275e96, 0x3bab6bcb, 0x1f9d45f1, 0xacfa58ab, 0x4be30393,
+    0x2030fa55, 0xad766df6, 0x88cc7691, 0xf5024c25, 0x4fe5d7fc, 0xc52acbd7, 0x26354480, 0xb562a38f,
+    0xdeb15a49, 0x25ba1b67, 0x45ea0e98, 0x5dfec0e1, 0xc32f7502, 0x814cf012, 0x8d4697a3, 0x6bd3f9c6,
+    0x038f5fe7, 0x15929c95, 0xbf6d7aeb, 0x955259da, 0xd4be832d, 0x587421d3, 0x49e06929, 0x8ec9c844,
+    0x75c2896a, 0xf48e7978, 0x99583e6b, 0x27b971dd, 0xbee14fb6, 0xf088ad17, 0xc920ac66, 0x7dce3ab4,
+    0x63df4a18, 0xe51a3182, 0x97513360, 0x62537f45, 0xb16477e0, 0xbb6bae84, 0xfe81a01c, 0xf9082b94,
+    0x70486858, 0x8f45fd19, 0x94de6c87, 0x527bf8b7, 0xab73d323, 0x724b02e2, 0xe31f8f57, 0x6655ab2a,
+    0xb2eb2807, 0x2fb5c203, 0x86c57b9a, 0xd33708a5, 0x302887f2, 0x23bfa5b2, 0x02036aba, 0xed16825c,
+    0x8acf1c2b, 0xa779b492, 0xf307f2f0, 0x4e69e2a1, 0x65daf4cd, 0x0605bed5, 0xd134621f, 0xc4a6fe8a,
+    0x342e539d, 0xa2f355a0, 0x058ae132, 0xa4f6eb75, 0x0b83ec39, 0x4060efaa, 0x5e719f06, 0xbd6e1051,
+    0x3e218af9, 0x96dd063d, 0xdd3e05ae, 0x4de6bd46, 0x91548db5, 0x71c45d05, 0x0406d46f, 0x605015ff,
+    0x1998fb24, 0xd6bde997, 0x894043cc, 0x67d99e77, 0xb0e842bd, 0x07898b88, 0xe7195b38, 0x79c8eedb,
+    0xa17c0a47, 0x7c420fe9, 0xf8841ec9, 0x00000000, 0x09808683, 0x322bed48, 0x1e1170ac, 0x6c5a724e,
+    0xfd0efffb, 0x0f853856, 0x3daed51e, 0x362d3927, 0x0a0fd964, 0x685ca621, 0x9b5b54d1, 0x24362e3a,
+    0x0c0a67b1, 0x9357e70f, 0xb4ee96d2, 0x1b9b919e, 0x80c0c54f, 0x61dc20a2, 0x5a774b69, 0x1c121a16,
+    0xe293ba0a, 0xc0a02ae5, 0x3c22e043, 0x121b171d, 0x0e090d0b, 0xf28bc7ad, 0x2db6a8b9, 0x141ea9c8,
+    0x57f11985, 0xaf75074c, 0xee99ddbb, 0xa37f60fd, 0xf701269f, 0x5c72f5bc, 0x44663bc5, 0x5bfb7e34,
+    0x8b432976, 0xcb23c6dc, 0xb6edfc68, 0xb8e4f163, 0xd731dcca, 0x42638510, 0x13972240, 0x84c61120,
+    0x854a247d, 0xd2bb3df8, 0xaef93211, 0xc729a16d, 0x1d9e2f4b, 0xdcb230f3, 0x0d8652ec, 0x77c1e3d0,
+    0x2bb3166c, 0xa970b999, 0x119448fa, 0x47e96422, 0xa8fc8cc4, 0xa0f03f1a, 0x567d2cd8, 0x223390ef,
+    0x87494ec7, 0xd938d1c1, 0x8ccaa2fe, 0x98d40b36, 0xa6f581cf, 0xa57ade28, 0xdab78e26, 0x3fadbfa4,
+    0x2c3a9de4, 0x5078920d, 0x6a5fcc9b, 0x547e4662, 0xf68d13c2, 0x90d8b8e8, 0x2e39f75e, 0x82c3aff5,
+    0x9f5d80be, 0x69d0937c, 0x6fd52da9, 0xcf2512b3, 0xc8ac993b, 0x10187da7, 0xe89c636e, 0xdb3bbb7b,
+    0xcd267809, 0x6e5918f4, 0xec9ab701, 0x834f9aa8, 0xe6956e65, 0xaaffe67e, 0x21bccf08, 0xef15e8e6,
+    0xbae79bd9, 0x4a6f36ce, 0xea9f09d4, 0x29b07cd6, 0x31a4b2af, 0x2a3f2331, 0xc6a59430, 0x35a266c0,
+    0x744ebc37, 0xfc82caa6, 0xe090d0b0, 0x33a7d815, 0xf104984a, 0x41ecdaf7, 0x7fcd500e, 0x1791f62f,
+    0x764dd68d, 0x43efb04d, 0xccaa4d54, 0xe49604df, 0x9ed1b5e3, 0x4c6a881b, 0xc12c1fb8, 0x4665517f,
+    0x9d5eea04, 0x018c355d, 0xfa877473, 0xfb0b412e, 0xb3671d5a, 0x92dbd252, 0xe9105633, 0x6dd64713,
+    0x9ad7618c, 0x37a10c7a, 0x59f8148e, 0xeb133c89, 0xcea927ee, 0xb761c935, 0xe11ce5ed, 0x7a47b13c,
+    0x9cd2df59, 0x55f2733f, 0x1814ce79, 0x73c737bf, 0x53f7cdea, 0x5ffdaa5b, 0xdf3d6f14, 0x7844db86,
+    0xcaaff381, 0xb968c43e, 0x3824342c, 0xc2a3405f, 0x161dc372, 0xbce2250c, 0x283c498b, 0xff0d9541,
+    0x39a80171, 0x080cb3de, 0xd8b4e49c, 0x6456c190, 0x7bcb8461, 0xd532b670, 0x486c5c74, 0xd0b85742
+};
+
+const uint32_t AES::kTd1[256] = {
+    0x5051f4a7, 0x537e4165, 0xc31a17a4, 0x963a275e, 0xcb3bab6b, 0xf11f9d45, 0xabacfa58, 0x934be303,
+    0x552030fa, 0xf6ad766d, 0x9188cc76, 0x25f5024c, 0xfc4fe5d7, 0xd7c52acb, 0x80263544, 0x8fb562a3,
+    0x49deb15a, 0x6725ba1b, 0x9845ea0e, 0xe15dfec0, 0x02c32f75, 0x12814cf0, 0xa38d4697, 0xc66bd3f9,
+    0xe7038f5f, 0x9515929c, 0xebbf6d7a, 0xda955259, 0x2dd4be83, 0xd3587421, 0x2949e069, 0x448ec9c8,
+    0x6a75c289, 0x78f48e79, 0x6b99583e, 0xdd27b971, 0xb6bee14f, 0x17f088ad, 0x66c920ac, 0xb47dce3a,
+    0x1863df4a, 0x82e51a31, 0x60975133, 0x4562537f, 0xe0b16477, 0x84bb6bae, 0x1cfe81a0, 0x94f9082b,
+    0x58704868, 0x198f45fd, 0x8794de6c, 0xb7527bf8, 0x23ab73d3, 0xe2724b02, 0x57e31f8f, 0x2a6655ab,
+    0x07b2eb28, 0x032fb5c2, 0x9a86c57b, 0xa5d33708, 0xf2302887, 0xb223bfa5, 0xba02036a, 0x5ced1682,
+    0x2b8acf1c, 0x92a779b4, 0xf0f307f2, 0xa14e69e2, 0xcd65daf4, 0xd50605be, 0x1fd13462, 0x8ac4a6fe,
+    0x9d342e53, 0xa0a2f355, 0x32058ae1, 0x75a4f6eb, 0x390b83ec, 0xaa4060ef, 0x065e719f, 0x51bd6e10,
+    0xf93e218a, 0x3d96dd06, 0xaedd3e05, 0x464de6bd, 0xb591548d, 0x0571c45d, 0x6f0406d4, 0xff605015,
+    0x241998fb, 0x97d6bde9, 0xcc894043, 0x7767d99e, 0xbdb0e842, 0x8807898b, 0x38e7195b, 0xdb79c8ee,
+    0x47a17c0a, 0xe97c420f, 0xc9f8841e, 0x00000000, 0x83098086, 0x48322bed, 0xac1e1170, 0x4e6c5a72,
+    0xfbfd0eff, 0x560f8538, 0x1e3daed5, 0x27362d39, 0x640a0fd9, 0x21685ca6, 0xd19b5b54, 0x3a24362e,
+    0xb10c0a67, 0x0f9357e7, 0xd2b4ee96, 0x9e1b9b91, 0x4f80c0c5, 0xa261dc20, 0x695a774b, 0x161c121a,
+    0x0ae293ba, 0xe5c0a02a, 0x433c22e0, 0x1d121b17, 0x0b0e090d, 0xadf28bc7, 0xb92db6a8, 0xc8141ea9,
+    0x8557f119, 0x4caf7507, 0xbbee99dd, 0xfda37f60, 0x9ff70126, 0xbc5c72f5, 0xc544663b, 0x345bfb7e,
+    0x768b4329, 0xdccb23c6, 0x68b6edfc, 0x63b8e4f1, 0xcad731dc, 0x10426385, 0x40139722, 0x2084c611,
+    0x7d854a24, 0xf8d2bb3d, 0x11aef932, 0x6dc729a1, 0x4b1d9e2f, 0xf3dcb230, 0xec0d8652, 0xd077c1e3,
+    0x6c2bb316, 0x99a970b9, 0xfa119448, 0x2247e964, 0xc4a8fc8c, 0x1aa0f03f, 0xd8567d2c, 0xef223390,
+    0xc787494e, 0xc1d938d1, 0xfe8ccaa2, 0x3698d40b, 0xcfa6f581, 0x28a57ade, 0x26dab78e, 0xa43fadbf,
+    0xe42c3a9d, 0x0d507892, 0x9b6a5fcc, 0x62547e46, 0xc2f68d13, 0xe890d8b8, 0x5e2e39f7, 0xf582c3af,
+    0xbe9f5d80, 0x7c69d093, 0xa96fd52d, 0xb3cf2512, 0x3bc8ac99, 0xa710187d, 0x6ee89c63, 0x7bdb3bbb,
+    0x09cd2678, 0xf46e5918, 0x01ec9ab7, 0xa8834f9a, 0x65e6956e, 0x7eaaffe6, 0x0821bccf, 0xe6ef15e8,
+    0xd9bae79b, 0xce4a6f36, 0xd4ea9f09, 0xd629b07c, 0xaf31a4b2, 0x312a3f23, 0x30c6a594, 0xc035a266,
+    0x37744ebc, 0xa6fc82ca, 0xb0e090d0, 0x1533a7d8, 0x4af10498, 0xf741ecda, 0x0e7fcd50, 0x2f1791f6,
+    0x8d764dd6, 0x4d43efb0, 0x54ccaa4d, 0xdfe49604, 0xe39ed1b5, 0x1b4c6a88, 0xb8c12c1f, 0x7f466551,
+    0x049d5eea, 0x5d018c35, 0x73fa8774, 0x2efb0b41, 0x5ab3671d, 0x5292dbd2, 0x33e91056, 0x136dd647,
+    0x8c9ad761, 0x7a37a10c, 0x8e59f814, 0x89eb133c, 0xeecea927, 0x35b761c9, 0xede11ce5, 0x3c7a47b1,
+    0x599cd2df, 0x3f55f273, 0x791814ce, 0xbf73c737, 0xea53f7cd, 0x5b5ffdaa, 0x14df3d6f, 0x867844db,
+    0x81caaff3, 0x3eb968c4, 0x2c382434, 0x5fc2a340, 0x72161dc3, 0x0cbce225, 0x8b283c49, 0x41ff0d95,
+    0x7139a801, 0xde080cb3, 0x9cd8b4e4, 0x906456c1, 0x617bcb84, 0x70d532b6, 0x74486c5c, 0x42d0b857
+};
+
+const uint32_t AES::kTd2[256] = {
+    0xa75051f4, 0x65537e41, 0xa4c31a17, 0x5e963a27, 0x6bcb3bab, 0x45f11f9d, 0x58abacfa, 0x03934be3,
+    0xfa552030, 0x6df6ad76, 0x769188cc, 0x4c25f502, 0xd7fc4fe5, 0xcbd7c52a, 0x44802635, 0xa38fb562,
+    0x5a49deb1, 0x1b6725ba, 0x0e9845ea, 0xc0e15dfe, 0x7502c32f, 0xf012814c, 0x97a38d46, 0xf9c66bd3,
+    0x5fe7038f, 0x9c951592, 0x7aebbf6d, 0x59da9552, 0x832dd4be, 0x21d35874, 0x692949e0, 0xc8448ec9,
+    0x896a75c2, 0x7978f48e, 0x3e6b9958, 0x71dd27b9, 0x4fb6bee1, 0xad17f088, 0xac66c920, 0x3ab47dce,
+    0x4a1863df, 0x3182e51a, 0x33609751, 0x7f456253, 0x77e0b164, 0xae84bb6b, 0xa01cfe81, 0x2b94f908,
+    0x68587048, 0xfd198f45, 0x6c8794de, 0xf8b7527b, 0xd323ab73, 0x02e2724b, 0x8f57e31f, 0xab2a6655,
+    0x2807b2eb, 0xc2032fb5, 0x7b9a86c5, 0x08a5d337, 0x87f23028, 0xa5b223bf, 0x6aba0203, 0x825ced16,
+    0x1c2b8acf, 0xb492a779, 0xf2f0f307, 0xe2a14e69, 0xf4cd65da, 0xbed50605, 0x621fd134, 0xfe8ac4a6,
+    0x539d342e, 0x55a0a2f3, 0xe132058a, 0xeb75a4f6, 0xec390b83, 0xefaa4060, 0x9f065e71, 0x1051bd6e,
+    0x8af93e21, 0x063d96dd, 0x05aedd3e, 0xbd464de6, 0x8db59154, 0x5d0571c4, 0xd46f0406, 0x15ff6050,
+    0xfb241998, 0xe997d6bd, 0x43cc8940, 0x9e7767d9, 0x42bdb0e8, 0x8b880789, 0x5b38e719, 0xeedb79c8,
+    0x0a47a17c, 0x0fe97c42, 0x1ec9f884, 0x00000000, 0x86830980, 0xed48322b, 0x70ac1e11, 0x724e6c5a,
+    0xfffbfd0e, 0x38560f85, 0xd51e3dae, 0x3927362d, 0xd9640a0f, 0xa621685c, 0x54d19b5b, 0x2e3a2436,
+    0x67b10c0a, 0xe70f9357, 0x96d2b4ee, 0x919e1b9b, 0xc54f80c0, 0x20a261dc, 0x4b695a77, 0x1a161c12,
+    0xba0ae293, 0x2ae5c0a0, 0xe0433c22, 0x171d121b, 0x0d0b0e09, 0xc7adf28b, 0xa8b92db6, 0xa9c8141e,
+    0x198557f1, 0x074caf75, 0xddbbee99, 0x60fda37f, 0x269ff701, 0xf5bc5c72, 0x3bc54466, 0x7e345bfb,
+    0x29768b43, 0xc6dccb23, 0xfc68b6ed, 0xf163b8e4, 0xdccad731, 0x85104263, 0x22401397, 0x112084c6,
+    0x247d854a, 0x3df8d2bb, 0x3211aef9, 0xa16dc729, 0x2f4b1d9e, 0x30f3dcb2, 0x52ec0d86, 0xe3d077c1,
+    0x166c2bb3, 0xb999a970, 0x48fa1194, 0x642247e9, 0x8cc4a8fc, 0x3f1aa0f0, 0x2cd8567d, 0x90ef2233,
+    0x4ec78749, 0xd1c1d938, 0xa2fe8cca, 0x0b3698d4, 0x81cfa6f5, 0xde28a57a, 0x8e26dab7, 0xbfa43fad,
+    0x9de42c3a, 0x920d5078, 0xcc9b6a5f, 0x4662547e, 0x13c2f68d, 0xb8e890d8, 0xf75e2e39, 0xaff582c3,
+    0x80be9f5d, 0x937c69d0, 0x2da96fd5, 0x12b3cf25, 0x993bc8ac, 0x7da71018, 0x636ee89c, 0xbb7bdb3b,
+    0x7809cd26, 0x18f46e59, 0xb701ec9a, 0x9aa8834f, 0x6e65e695, 0xe67eaaff, 0xcf0821bc, 0xe8e6ef15,
+    0x9bd9bae7, 0x36ce4a6f, 0x09d4ea9f, 0x7cd629b0, 0xb2af31a4, 0x23312a3f, 0x9430c6a5, 0x66c035a2,
+    0xbc37744e, 0xcaa6fc82, 0xd0b0e090, 0xd81533a7, 0x984af104, 0xdaf741ec, 0x500e7fcd, 0xf62f1791,
+    0xd68d764d, 0xb04d43ef, 0x4d54ccaa, 0x04dfe496, 0xb5e39ed1, 0x881b4c6a, 0x1fb8c12c, 0x517f4665,
+    0xea049d5e, 0x355d018c, 0x7473fa87, 0x412efb0b, 0x1d5ab367, 0xd25292db, 0x5633e910, 0x47136dd6,
+    0x618c9ad7, 0x0c7a37a1, 0x148e59f8, 0x3c89eb13, 0x27eecea9, 0xc935b761, 0xe5ede11c, 0xb13c7a47,
+    0xdf599cd2, 0x733f55f2, 0xce791814, 0x37bf73c7, 0xcdea53f7, 0xaa5b5ffd, 0x6f14df3d, 0xdb867844,
+    0xf381caaf, 0xc43eb968, 0x342c3824, 0x405fc2a3, 0xc372161d, 0x250cbce2, 0x498b283c, 0x9541ff0d,
+    0x017139a8, 0xb3de080c, 0xe49cd8b4, 0xc1906456, 0x84617bcb, 0xb670d532, 0x5c74486c, 0x5742d0b8
+};
+
+const uint32_t AES::kTd3[256] = {
+    0xf4a75051, 0x4165537e, 0x17a4c31a, 0x275e963a, 0xab6bcb3b, 0x9d45f11f, 0xfa58abac, 0xe303934b,
+    0x30fa5520, 0x766df6ad, 0xcc769188, 0x024c25f5, 0xe5d7fc4f, 0x2acbd7c5, 0x35448026, 0x62a38fb5,
+    0xb15a49de, 0xba1b6725, 0xea0e9845, 0xfec0e15d, 0x2f7502c3, 0x4cf01281, 0x4697a38d, 0xd3f9c66b,
+    0x8f5fe703, 0x929c9515, 0x6d7aebbf, 0x5259da95, 0xbe832dd4, 0x7421d358, 0xe0692949, 0xc9c8448e,
+    0xc2896a75, 0x8e7978f4, 0x583e6b99, 0xb971dd27, 0xe14fb6be, 0x88ad17f0, 0x20ac66c9, 0xce3ab47d,
+    0xdf4a1863, 0x1a3182e5, 0x51336097, 0x537f4562, 0x6477e0b1, 0x6bae84bb, 0x81a01cfe, 0x082b94f9,
+    0x48685870, 0x45fd198f, 0xde6c8794, 0x7bf8b752, 0x73d323ab, 0x4b02e272, 0x1f8f57e3, 0x55ab2a66,
+    0xeb2807b2, 0xb5c2032f, 0xc57b9a86, 0x3708a5d3, 0x2887f230, 0xbfa5b223, 0x036aba02, 0x16825ced,
+    0xcf1c2b8a, 0x79b492a7, 0x07f2f0f3, 0x69e2a14e, 0xdaf4cd65, 0x05bed506, 0x34621fd1, 0xa6fe8ac4,
+    0x2e539d34, 0xf355a0a2, 0x8ae13205, 0xf6eb75a4, 0x83ec390b, 0x60efaa40, 0x719f065e, 0x6e1051bd,
+    0x218af93e, 0xdd063d96, 0x3e05aedd, 0xe6bd464d, 0x548db591, 0xc45d0571, 0x06d46f04, 0x5015ff60,
+    0x98fb2419, 0xbde997d6, 0x4043cc89, 0xd99e7767, 0xe842bdb0, 0x898b8807, 0x195b38e7, 0xc8eedb79,
+    0x7c0a47a1, 0x420fe97c, 0x841ec9f8, 0x00000000, 0x80868309, 0x2bed4832, 0x1170ac1e, 0x5a724e6c,
+    0x0efffbfd, 0x8538560f, 0xaed51e3d, 0x2d392736, 0x0fd9640a, 0x5ca62168, 0x5b54d19b, 0x362e3a24,
+    0x0a67b10c, 0x57e70f93, 0xee96d2b4, 0x9b919e1b, 0xc0c54f80, 0xdc20a261, 0x774b695a, 0x121a161c,
+    0x93ba0ae2, 0xa02ae5c0, 0x22e0433c, 0x1b171d12, 0x090d0b0e, 0x8bc7adf2, 0xb6a8b92d, 0x1ea9c814,
+    0xf1198557, 0x75074caf, 0x99ddbbee, 0x7f60fda3, 0x01269ff7, 0x72f5bc5c, 0x663bc544, 0xfb7e345b,
+    0x4329768b, 0x23c6dccb, 0xedfc68b6, 0xe4f163b8, 0x31dccad7, 0x63851042, 0x97224013, 0xc6112084,
+    0x4a247d85, 0xbb3df8d2, 0xf93211ae, 0x29a16dc7, 0x9e2f4b1d, 0xb230f3dc, 0x8652ec0d, 0xc1e3d077,
+    0xb3166c2b, 0x70b999a9, 0x9448fa11, 0xe9642247, 0xfc8cc4a8, 0xf03f1aa0, 0x7d2cd856, 0x3390ef22,
+    0x494ec787, 0x38d1c1d9, 0xcaa2fe8c, 0xd40b3698, 0xf581cfa6, 0x7ade28a5, 0xb78e26da, 0xadbfa43f,
+    0x3a9de42c, 0x78920d50, 0x5fcc9b6a, 0x7e466254, 0x8d13c2f6, 0xd8b8e890, 0x39f75e2e, 0xc3aff582,
+    0x5d80be9f, 0xd0937c69, 0xd52da96f, 0x2512b3cf, 0xac993bc8, 0x187da710, 0x9c636ee8, 0x3bbb7bdb,
+    0x267809cd, 0x5918f46e, 0x9ab701ec, 0x4f9aa883, 0x956e65e6, 0xffe67eaa, 0xbccf0821, 0x15e8e6ef,
+    0xe79bd9ba, 0x6f36ce4a, 0x9f09d4ea, 0xb07cd629, 0xa4b2af31, 0x3f23312a, 0xa59430c6, 0xa266c035,
+    0x4ebc3774, 0x82caa6fc, 0x90d0b0e0, 0xa7d81533, 0x04984af1, 0xecdaf741, 0xcd500e7f, 0x91f62f17,
+    0x4dd68d76, 0xefb04d43, 0xaa4d54cc, 0x9604dfe4, 0xd1b5e39e, 0x6a881b4c, 0x2c1fb8c1, 0x65517f46,
+    0x5eea049d, 0x8c355d01, 0x877473fa, 0x0b412efb, 0x671d5ab3, 0xdbd25292, 0x105633e9, 0xd647136d,
+    0xd7618c9a, 0xa10c7a37, 0xf8148e59, 0x133c89eb, 0xa927eece, 0x61c935b7, 0x1ce5ede1, 0x47b13c7a,
+    0xd2df599c, 0xf2733f55, 0x14ce7918, 0xc737bf73, 0xf7cdea53, 0xfdaa5b5f, 0x3d6f14df, 0x44db8678,
+    0xaff381ca, 0x68c43eb9, 0x24342c38, 0xa3405fc2, 0x1dc37216, 0xe2250cbc, 0x3c498b28, 0x0d9541ff,
+    0xa8017139, 0x0cb3de08, 0xb4e49cd8, 0x56c19064, 0xcb84617b, 0x32b670d5, 0x6c5c7448, 0xb85742d0
+};
+
+uint8_t AES::roundsForKey(std::size_t keySize)
 {
-    setKey(key);
+    switch (keySize) {
+    case 16:
+        return AESCipher<128>::kRounds;
+    case 24:
+        return AESCipher<192>::kRounds;
+    case 32:
+        return AESCipher<256>::kRounds;
+    default:
+        throw std::invalid_argument("Invalid key size. AES can operate on 128-bit, 192-bit and 256-bit keys");
+    }
 }
 
-AES::AES(const ByteArray& key) : m_key(key)
+///
+/// Reads 4 bytes as big-endian word, i.e, the column
+/// of state or the key schedule word as 32-bit integer
+///
+static inline uint32_t loadWord(const byte* b)
 {
-    setKey(key);
+    return (static_cast<uint32_t>(b[0]) << 24) |
+            (static_cast<uint32_t>(b[1]) << 16) |
+            (static_cast<uint32_t>(b[2]) << 8) |
+            (static_cast<uint32_t>(b[3]));
 }
 
-AES::AES(const AES& other)
+static inline void storeWord(uint32_t w, byte* b)
 {
-    if (&other != this) {
-        m_key = other.m_key;
-        m_keySchedule = other.m_keySchedule;
+    b[0] = static_cast<byte>(w >> 24);
+    b[1] = static_cast<byte>(w >> 16);
+    b[2] = static_cast<byte>(w >> 8);
+    b[3] = static_cast<byte>(w);
+}
+
+// Engine forced using AES::setEngine(), AES::Engine::Auto if none
+static std::atomic<AES::Engine> s_forcedEngine(AES::Engine::Auto);
+
+// Threads set using AES::setThreadCount(), 0 for hardware threads
+static std::atomic<std::size_t> s_threadCount(0);
+
+///
+/// Entry of key schedule cache, schedules are same as AES::KeySchedule
+///
+struct CachedKeySchedule {
+    ByteArray key;
+    std::array<uint32_t, 60> keySchedule;
+    std::array<uint32_t, 60> inverseKeySchedule;
+};
+
+// Capacity set using AES::setKeyScheduleCacheCapacity(), 0 if cache is disabled.
+// Rest of the cache is guarded by s_keyScheduleCacheMutex
+static std::atomic<std::size_t> s_keyScheduleCacheCapacity(0);
+static std::mutex s_keyScheduleCacheMutex;
+
+// most recently used first
+static std::list<CachedKeySchedule> s_keyScheduleCache;
+static std::map<ByteArray, std::list<CachedKeySchedule>::iterator> s_keyScheduleCacheIndex;
+static std::size_t s_keyScheduleCacheHits = 0;
+static std::size_t s_keyScheduleCacheMisses = 0;
+
+static bool cpuSupportsAesNi()
+{
+#if MINE_AES_NI
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
     }
+    return (ecx & bit_AES) != 0 && (ecx & bit_SSE4_1) != 0;
+#else
+    return false;
+#endif
 }
 
-AES::AES(const AES&& other) :
-    m_key(std::move(other.m_key)),
-    m_keySchedule(std::move(other.m_keySchedule))
+///
+/// VAES with 512-bit registers needs AVX-512 (F and BW) and OS has to
+/// save ZMM registers (XCR0) besides AES-NI itself
+///
+static bool cpuSupportsVaes()
 {
+#if MINE_VAES
+    unsigned int eax, ebx, ecx, edx;
+    if (!cpuSupportsAesNi() || !__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_OSXSAVE) == 0) {
+        return false;
+    }
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    const unsigned int kAvx512F = 1u << 16;
+    const unsigned int kAvx512BW = 1u << 30;
+    const unsigned int kVaes = 1u << 9;
+    if ((ebx & kAvx512F) == 0 || (ebx & kAvx512BW) == 0 || (ecx & kVaes) == 0) {
+        return false;
+    }
+    unsigned int xcr0Low, xcr0High;
+    __asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    // SSE, AVX, opmask, upper halves of ZMM0-15 and ZMM16-31
+    const unsigned int kZmmState = 0xe6;
+    return (xcr0Low & kZmmState) == kZmmState;
+#else
+    return false;
+#endif
 }
 
-AES& AES::operator=(const AES& other)
+static bool cpuSupportsCarrylessMultiply()
 {
-    if (&other != this) {
-        m_key = other.m_key;
-        m_keySchedule = other.m_keySchedule;
+#if MINE_AES_NI
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
     }
-    return *this;
+    return (ecx & bit_PCLMUL) != 0 && (ecx & bit_SSE4_1) != 0;
+#else
+    return false;
+#endif
 }
 
-void AES::setKey(const std::string& key)
+static inline uint64_t loadDoubleWord(const byte* b)
 {
-    setKey(Base16::fromString(key));
+    return (static_cast<uint64_t>(loadWord(b)) << 32) | loadWord(b + 4);
 }
 
-void AES::setKey(const ByteArray& key)
+static inline void storeDoubleWord(uint64_t w, byte* b)
 {
-    if (key.size() != 16 && key.size() != 24 && key.size() != 32) {
-        throw std::invalid_argument("Invalid key size. AES can operate on 128-bit, 192-bit and 256-bit keys");
-    }
-    m_key = key;
-    m_keySchedule = keyExpansion(&m_key);
+    storeWord(static_cast<uint32_t>(w >> 32), b);
+    storeWord(static_cast<uint32_t>(w), b + 4);
 }
 
-void AES::printBytes(const ByteArray& b)
+///
+/// Multiplies XTS tweak by primitive element alpha (x) in GF(2^128)
+/// with tweak as little-endian, reduced by x^128 + x^7 + x^2 + x + 1
+/// \ref IEEE Std 1619-2007 Sec. 5.2
+///
+static inline void xtsMultiplyAlpha(byte* tweak)
 {
-    for (std::size_t i = 1; i <= b.size(); ++i) {
-        std::cout << "0x" << (b[i - 1] < 10 ? "0" : "") << Base16::encode(b[i - 1]) << "  ";
-        if (i % 4 == 0) {
-            std::cout << std::endl;
-        }
+    byte carry = 0;
+    for (int i = 0; i < 16; ++i) {
+        const byte next = static_cast<byte>(tweak[i] >> 7);
+        tweak[i] = static_cast<byte>((tweak[i] << 1) | carry);
+        carry = next;
     }
-    std::cout << std::endl << "------" << std::endl;
+    tweak[0] ^= static_cast<byte>(0x87 & (0 - carry));
 }
 
-void AES::printState(const State* state)
+///
+/// Doubles CMAC subkey in GF(2^128) with block as big-endian,
+/// reduced by x^128 + x^7 + x^2 + x + 1
+/// \ref RFC 4493 Sec. 2.3
+///
+static inline void cmacDouble(byte* block)
 {
-    for (std::size_t i = 0; i < kNb; ++i) {
-        for (std::size_t j = 0; j < kNb; ++j) {
-            byte b = (*state)[j][i];
-            std::cout << "0x" << (b < 10 ? "0" : "") << Base16::encode(b) << "  ";
-        }
-        std::cout << std::endl;
+    byte carry = 0;
+    for (int i = 15; i >= 0; --i) {
+        const byte next = static_cast<byte>(block[i] >> 7);
+        block[i] = static_cast<byte>((block[i] << 1) | carry);
+        carry = next;
     }
-    std::cout << std::endl;
+    block[15] ^= static_cast<byte>(0x87 & (0 - carry));
 }
 
-void AES::rotateWord(Word* w) {
-    byte t = (*w)[0];
-    (*w)[0] = (*w)[1];
-    (*w)[1] = (*w)[2];
-    (*w)[2] = (*w)[3];
-    (*w)[3] = t;
-}
+///
+/// Reduction of the four bits shifted out of the right end of
+/// an element in GF(2^128) for gf128Multiply(), these are
+/// multiples of R = 11100001 || 0^120 (NIST SP 800-38D Sec. 6.3)
+///
+static const uint64_t kGHashReduction[16] = {
+    0x0000000000000000ULL, 0x1c20000000000000ULL, 0x3840000000000000ULL, 0x2460000000000000ULL,
+    0x7080000000000000ULL, 0x6ca0000000000000ULL, 0x48c0000000000000ULL, 0x54e0000000000000ULL,
+    0xe100000000000000ULL, 0xfd20000000000000ULL, 0xd940000000000000ULL, 0xc560000000000000ULL,
+    0x9180000000000000ULL, 0x8da0000000000000ULL, 0xa9c0000000000000ULL, 0xb5e0000000000000ULL
+};
 
-void AES::substituteWord(Word* w) {
-    for (uint8_t i = 0; i < 4; ++i) {
-        (*w)[i] = kSBox[(*w)[i]];
+///
+/// y = y * H in GF(2^128) four bits at a time using multiples of H
+/// (Shoup's method) starting from the last byte of y
+///
+static void gf128Multiply(byte* y, const uint64_t (*table)[2])
+{
+    uint64_t zHi = 0;
+    uint64_t zLo = 0;
+    for (int i = 15; i >= 0; --i) {
+        const byte nibbles[2] = { static_cast<byte>(y[i] & 0xf), static_cast<byte>(y[i] >> 4) };
+        for (byte nibble : nibbles) {
+            // multiply by x^4
+            const uint64_t remainder = zLo & 0xf;
+            zLo = (zHi << 60) | (zLo >> 4);
+            zHi = (zHi >> 4) ^ kGHashReduction[remainder];
+
+            zHi ^= table[nibble][0];
+            zLo ^= table[nibble][1];
+        }
     }
+    storeDoubleWord(zHi, y);
+    storeDoubleWord(zLo, y + 8);
 }
 
-AES::KeySchedule AES::keyExpansion(const Key* key)
+///
+/// y = y * H in GF(2^128) one bit at a time without branches or lookups
+/// (NIST SP 800-38D Sec. 6.3, Algorithm 1)
+///
+static void gf128MultiplyConstantTime(byte* y, const uint64_t* h)
 {
+    uint64_t zHi = 0;
+    uint64_t zLo = 0;
+    uint64_t vHi = h[0];
+    uint64_t vLo = h[1];
+    for (int i = 0; i < 128; ++i) {
+        const uint64_t mask = 0 - static_cast<uint64_t>((y[i / 8] >> (7 - (i % 8))) & 1);
+        zHi ^= vHi & mask;
+        zLo ^= vLo & mask;
+        const uint64_t reduction = 0xe100000000000000ULL & (0 - (vLo & 1));
+        vLo = (vHi << 63) | (vLo >> 1);
+        vHi = (vHi >> 1) ^ reduction;
+    }
+    storeDoubleWord(zHi, y);
+    storeDoubleWord(zLo, y + 8);
+}
 
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
+///
+/// Bitsliced engine keeps four blocks in eight 64-bit words where
+/// word i has bit i of every byte of the blocks, so SubBytes() is
+/// computed with logical operations on all 64 bytes at once and
+/// nothing is looked up by secret data (constant-time). The layout
+/// is same as BearSSL's aes_ct64 (Thomas Pornin)
+///
+/// With GCC and Clang the words are 128-bit vectors (SSE2, NEON, ...)
+/// holding two sets of four blocks, otherwise the two sets are kept in
+/// separate 64-bit words, either way eight blocks are ciphered at a time
+///
+#if defined(__GNUC__) || defined(__clang__)
+#   define MINE_BITSLICED_VECTOR 1
+typedef uint64_t BitslicedWord __attribute__((vector_size(16)));
+static const int kBitslicedSets = 1;
+#else
+#   define MINE_BITSLICED_VECTOR 0
+typedef uint64_t BitslicedWord;
+static const int kBitslicedSets = 2;
 #endif
 
-    std::size_t keySize = key->size();
-
-    if (keySize != 16 && keySize != 24 && keySize != 32) {
-        throw std::invalid_argument("Invalid AES key size");
-    }
-
-    uint8_t Nk = kKeyParams.at(keySize)[0],
-            Nr = kKeyParams.at(keySize)[1];
+// words for eight blocks
+static const int kBitslicedWords = 8 * kBitslicedSets;
 
-    KeySchedule words;//(kNb * (Nr+1));
+///
+/// Swaps bits of x and y selected by masks so that, after all three
+/// steps, word i holds bit i of each byte
+///
+static inline void bitslicedSwap(uint64_t* x, uint64_t* y, uint64_t lowMask, uint64_t highMask, int shift)
+{
+    const uint64_t a = *x;
+    const uint64_t b = *y;
+    *x = (a & lowMask) | ((b & lowMask) << shift);
+    *y = ((a & highMask) >> shift) | (b & highMask);
+}
 
-    uint8_t i = 0;
-    // copy main key as is for the first round
-    for (; i < Nk; ++i) {
-        words[i] = {{
-                        (*key)[(i * 4) + 0],
-                        (*key)[(i * 4) + 1],
-                        (*key)[(i * 4) + 2],
-                        (*key)[(i * 4) + 3],
-                    }};
+static inline void bitslicedOrtho(uint64_t* q)
+{
+    for (int i = 0; i < 8; i += 2) {
+        bitslicedSwap(&q[i], &q[i + 1], 0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 1);
     }
+    for (int i = 0; i < 8; i += 4) {
+        bitslicedSwap(&q[i], &q[i + 2], 0x3333333333333333ULL, 0xccccccccccccccccULL, 2);
+        bitslicedSwap(&q[i + 1], &q[i + 3], 0x3333333333333333ULL, 0xccccccccccccccccULL, 2);
+    }
+    for (int i = 0; i < 4; ++i) {
+        bitslicedSwap(&q[i], &q[i + 4], 0x0f0f0f0f0f0f0f0fULL, 0xf0f0f0f0f0f0f0f0ULL, 4);
+    }
+}
 
-    for (; i < kNb * (Nr + 1); ++i) {
-        Word temp = words[i - 1];
+///
+/// Spreads 16 bytes of a block (as little-endian words) in to q0 and q1
+/// so that each 16-bit lane holds a row of the state
+///
+static inline void bitslicedInterleaveIn(const byte* block, uint64_t* q0, uint64_t* q1)
+{
+    uint64_t x[4];
+    for (int i = 0; i < 4; ++i) {
+        x[i] = static_cast<uint64_t>(block[i * 4]) |
+                (static_cast<uint64_t>(block[(i * 4) + 1]) << 8) |
+                (static_cast<uint64_t>(block[(i * 4) + 2]) << 16) |
+                (static_cast<uint64_t>(block[(i * 4) + 3]) << 24);
+        x[i] |= (x[i] << 16);
+        x[i] &= 0x0000ffff0000ffffULL;
+        x[i] |= (x[i] << 8);
+        x[i] &= 0x00ff00ff00ff00ffULL;
+    }
+    *q0 = x[0] | (x[2] << 8);
+    *q1 = x[1] | (x[3] << 8);
+}
 
-        if (i % Nk == 0) {
-            rotateWord(&temp);
-            substituteWord(&temp);
-            // xor with rcon
-            temp[0] ^= kRoundConstant[(i / Nk) - 1];
-        } else if (Nk == 8 && i % Nk == 4) {
-            // See note for 256-bit keys on Sec. 5.2 on FIPS.197
-            substituteWord(&temp);
-        }
+static inline void bitslicedInterleaveOut(uint64_t q0, uint64_t q1, byte* block)
+{
+    uint64_t x[4];
+    x[0] = q0 & 0x00ff00ff00ff00ffULL;
+    x[1] = q1 & 0x00ff00ff00ff00ffULL;
+    x[2] = (q0 >> 8) & 0x00ff00ff00ff00ffULL;
+    x[3] = (q1 >> 8) & 0x00ff00ff00ff00ffULL;
+    for (int i = 0; i < 4; ++i) {
+        x[i] |= (x[i] >> 8);
+        x[i] &= 0x0000ffff0000ffffULL;
+        const uint32_t w = static_cast<uint32_t>(x[i]) | static_cast<uint32_t>(x[i] >> 16);
+        block[i * 4] = static_cast<byte>(w);
+        block[(i * 4) + 1] = static_cast<byte>(w >> 8);
+        block[(i * 4) + 2] = static_cast<byte>(w >> 16);
+        block[(i * 4) + 3] = static_cast<byte>(w >> 24);
+    }
+}
 
-        // xor previous column of new key with corresponding column of
-        // previous round key
-        Word correspondingWord = words[i - Nk];
-        byte b0 = correspondingWord[0] ^ temp[0];
-        byte b1 = correspondingWord[1] ^ temp[1];
-        byte b2 = correspondingWord[2] ^ temp[2];
-        byte b3 = correspondingWord[3] ^ temp[3];
+///
+/// Loads four blocks in to eight words
+///
+static inline void bitslicedLoad4(const byte* blocks, uint64_t* q)
+{
+    for (int i = 0; i < 4; ++i) {
+        bitslicedInterleaveIn(blocks + (i * 16), &q[i], &q[i + 4]);
+    }
+    bitslicedOrtho(q);
+}
 
-        words[i] = {{ b0, b1, b2, b3 }};
+static inline void bitslicedStore4(uint64_t* q, byte* blocks)
+{
+    bitslicedOrtho(q);
+    for (int i = 0; i < 4; ++i) {
+        bitslicedInterleaveOut(q[i], q[i + 4], blocks + (i * 16));
     }
+}
 
-#if MINE_PROFILING
-    endProfiling(started, "keyExpansion");
+///
+/// Loads eight blocks in to kBitslicedSets sets of eight words
+///
+static inline void bitslicedLoad(const byte* blocks, BitslicedWord* q)
+{
+#if MINE_BITSLICED_VECTOR
+    uint64_t first[8];
+    uint64_t second[8];
+    bitslicedLoad4(blocks, first);
+    bitslicedLoad4(blocks + 64, second);
+    for (int i = 0; i < 8; ++i) {
+        q[i] = BitslicedWord{ first[i], second[i] };
+    }
+#else
+    bitslicedLoad4(blocks, q);
+    bitslicedLoad4(blocks + 64, q + 8);
 #endif
+}
 
-    return words;
+static inline void bitslicedStore(BitslicedWord* q, byte* blocks)
+{
+#if MINE_BITSLICED_VECTOR
+    uint64_t first[8];
+    uint64_t second[8];
+    for (int i = 0; i < 8; ++i) {
+        first[i] = q[i][0];
+        second[i] = q[i][1];
+    }
+    bitslicedStore4(first, blocks);
+    bitslicedStore4(second, blocks + 64);
+#else
+    bitslicedStore4(q, blocks);
+    bitslicedStore4(q + 8, blocks + 64);
+#endif
 }
 
 ///
-/// Adding round key is simply a xor operation on
-/// corresponding key for the round
-/// which is generated during key expansion
+/// SubBytes() on eight bitsliced words using circuit of 113 gates by
+/// Boyar and Peralta, "A depth-16 circuit for the AES S-box" (2011)
 ///
-/// Let's say we have state and a key
+template <typename Word>
+static inline void bitslicedSubBytes(Word* q)
+{
+    const Word x0 = q[7];
+    const Word x1 = q[6];
+    const Word x2 = q[5];
+    const Word x3 = q[4];
+    const Word x4 = q[3];
+    const Word x5 = q[2];
+    const Word x6 = q[1];
+    const Word x7 = q[0];
+
+    // top linear transformation
+    const Word y14 = x3 ^ x5;
+    const Word y13 = x0 ^ x6;
+    const Word y9 = x0 ^ x3;
+    const Word y8 = x0 ^ x5;
+    const Word t0 = x1 ^ x2;
+    const Word y1 = t0 ^ x7;
+    const Word y4 = y1 ^ x3;
+    const Word y12 = y13 ^ y14;
+    const Word y2 = y1 ^ x0;
+    const Word y5 = y1 ^ x6;
+    const Word y3 = y5 ^ y8;
+    const Word t1 = x4 ^ y12;
+    const Word y15 = t1 ^ x5;
+    const Word y20 = t1 ^ x1;
+    const Word y6 = y15 ^ x7;
+    const Word y10 = y15 ^ t0;
+    const Word y11 = y20 ^ y9;
+    const Word y7 = x7 ^ y11;
+    const Word y17 = y10 ^ y11;
+    const Word y19 = y10 ^ y8;
+    const Word y16 = t0 ^ y11;
+    const Word y21 = y13 ^ y16;
+    const Word y18 = x0 ^ y16;
+
+    // non-linear section (inversion in GF(2^8))
+    const Word t2 = y12 & y15;
+    const Word t3 = y3 & y6;
+    const Word t4 = t3 ^ t2;
+    const Word t5 = y4 & x7;
+    const Word t6 = t5 ^ t2;
+    const Word t7 = y13 & y16;
+    const Word t8 = y5 & y1;
+    const Word t9 = t8 ^ t7;
+    const Word t10 = y2 & y7;
+    const Word t11 = t10 ^ t7;
+    const Word t12 = y9 & y11;
+    const Word t13 = y14 & y17;
+    const Word t14 = t13 ^ t12;
+    const Word t15 = y8 & y10;
+    const Word t16 = t15 ^ t12;
+    const Word t17 = t4 ^ t14;
+    const Word t18 = t6 ^ t16;
+    const Word t19 = t9 ^ t14;
+    const Word t20 = t11 ^ t16;
+    const Word t21 = t17 ^ y20;
+    const Word t22 = t18 ^ y19;
+    const Word t23 = t19 ^ y21;
+    const Word t24 = t20 ^ y18;
+
+    const Word t25 = t21 ^ t22;
+    const Word t26 = t21 & t23;
+    const Word t27 = t24 ^ t26;
+    const Word t28 = t25 & t27;
+    const Word t29 = t28 ^ t22;
+    const Word t30 = t23 ^ t24;
+    const Word t31 = t22 ^ t26;
+    const Word t32 = t31 & t30;
+    const Word t33 = t32 ^ t24;
+    const Word t34 = t23 ^ t33;
+    const Word t35 = t27 ^ t33;
+    const Word t36 = t24 & t35;
+    const Word t37 = t36 ^ t34;
+    const Word t38 = t27 ^ t36;
+    const Word t39 = t29 & t38;
+    const Word t40 = t25 ^ t39;
+
+    const Word t41 = t40 ^ t37;
+    const Word t42 = t29 ^ t33;
+    const Word t43 = t29 ^ t40;
+    const Word t44 = t33 ^ t37;
+    const Word t45 = t42 ^ t41;
+    const Word z0 = t44 & y15;
+    const Word z1 = t37 & y6;
+    const Word z2 = t33 & x7;
+    const Word z3 = t43 & y16;
+    const Word z4 = t40 & y1;
+    const Word z5 = t29 & y7;
+    const Word z6 = t42 & y11;
+    const Word z7 = t45 & y17;
+    const Word z8 = t41 & y10;
+    const Word z9 = t44 & y12;
+    const Word z10 = t37 & y3;
+    const Word z11 = t33 & y4;
+    const Word z12 = t43 & y13;
+    const Word z13 = t40 & y5;
+    const Word z14 = t29 & y2;
+    const Word z15 = t42 & y9;
+    const Word z16 = t45 & y14;
+    const Word z17 = t41 & y8;
+
+    // bottom linear transformation
+    const Word t46 = z15 ^ z16;
+    const Word t47 = z10 ^ z11;
+    const Word t48 = z5 ^ z13;
+    const Word t49 = z9 ^ z10;
+    const Word t50 = z2 ^ z12;
+    const Word t51 = z2 ^ z5;
+    const Word t52 = z7 ^ z8;
+    const Word t53 = z0 ^ z3;
+    const Word t54 = z6 ^ z7;
+    const Word t55 = z16 ^ z17;
+    const Word t56 = z12 ^ t48;
+    const Word t57 = t50 ^ t53;
+    const Word t58 = z4 ^ t46;
+    const Word t59 = z3 ^ t54;
+    const Word t60 = t46 ^ t57;
+    const Word t61 = z14 ^ t57;
+    const Word t62 = t52 ^ t58;
+    const Word t63 = t49 ^ t58;
+    const Word t64 = z4 ^ t59;
+    const Word t65 = t61 ^ t62;
+    const Word t66 = z1 ^ t63;
+    const Word s0 = t59 ^ t63;
+    const Word s6 = t56 ^ ~t62;
+    const Word s7 = t48 ^ ~t60;
+    const Word t67 = t64 ^ t65;
+    const Word s3 = t53 ^ t66;
+    const Word s4 = t51 ^ t66;
+    const Word s5 = t47 ^ t65;
+    const Word s1 = t64 ^ ~s3;
+    const Word s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
 ///
-/// [ df  c3  e2  9c ]         [ ef  d4  49  11 ]
-/// | 0f  ad  1f  ca |         | 1f  ad  ac  fa |
-/// | 0c  9d  8d  fa |    ^    | cc  9e  15  dd |
-/// [ fe  ef  cc  b2 ]         [ fe  ea  02  dc ]
+/// Inverse of the affine transformation of S-box (including the constant),
+/// as InvSubBytes(x) = A'(SubBytes(A'(x))) where A' is this function
 ///
+template <typename Word>
+static inline void bitslicedInvAffine(Word* q)
+{
+    const Word q0 = ~q[0];
+    const Word q1 = ~q[1];
+    const Word q2 = q[2];
+    const Word q3 = q[3];
+    const Word q4 = q[4];
+    const Word q5 = ~q[5];
+    const Word q6 = ~q[6];
+    const Word q7 = q[7];
+    q[7] = q1 ^ q4 ^ q6;
+    q[6] = q0 ^ q3 ^ q5;
+    q[5] = q7 ^ q2 ^ q4;
+    q[4] = q6 ^ q1 ^ q3;
+    q[3] = q5 ^ q0 ^ q2;
+    q[2] = q4 ^ q7 ^ q1;
+    q[1] = q3 ^ q6 ^ q0;
+    q[0] = q2 ^ q5 ^ q7;
+}
+
+template <typename Word>
+static inline void bitslicedInvSubBytes(Word* q)
+{
+    bitslicedInvAffine(q);
+    bitslicedSubBytes(q);
+    bitslicedInvAffine(q);
+}
+
 ///
-/// [ df^ef   c3^d4   e2^49   9c^11 ]
-/// | 0f^1f   ad^ad   1f^ac   ca^fa |
-/// | 0c^cc   9d^9e   8d^15   fa^dd |
-/// [ fe^fe   ef^ea   cc^02   b2^dc ]
+/// Each 16-bit lane is a row of the state (four columns of four blocks),
+/// rotating row r by r columns is rotating 4-bit groups in the lane
 ///
-void AES::addRoundKey(State* state, KeySchedule* keySchedule, int round)
+template <typename Word>
+static inline void bitslicedShiftRows(Word* q)
 {
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    const int iR = (round * kNb);
-    for (std::size_t i = 0; i < kNb; ++i) {
-        std::size_t iR2 = iR + i;
-        for (std::size_t j = 0; j < kNb; ++j) {
-#if MINE_PROFILING
-    auto started2 = std::chrono::steady_clock::now();
-    std::cout << ((*state)[i][j] & 0xff) << " ^= " << ((*keySchedule)[iR2][j] & 0xff);
-#endif
-            (*state)[i][j] ^= (*keySchedule)[iR2][j];
-#if MINE_PROFILING
-    std::cout << " = " << ((*state)[i][j] & 0xff) << std::endl;
-    endProfiling(started2, "add single round");
-#endif
-        }
+    for (int i = 0; i < 8; ++i) {
+        const Word x = q[i];
+        q[i] = (x & 0x000000000000ffffULL) |
+                ((x & 0x00000000fff00000ULL) >> 4) |
+                ((x & 0x00000000000f0000ULL) << 12) |
+                ((x & 0x0000ff0000000000ULL) >> 8) |
+                ((x & 0x000000ff00000000ULL) << 8) |
+                ((x & 0xf000000000000000ULL) >> 12) |
+                ((x & 0x0fff000000000000ULL) << 4);
     }
-#if MINE_PROFILING
-    endProfiling(started, "addRoundKey");
-#endif
+}
+
+template <typename Word>
+static inline void bitslicedInvShiftRows(Word* q)
+{
+    for (int i = 0; i < 8; ++i) {
+        const Word x = q[i];
+        q[i] = (x & 0x000000000000ffffULL) |
+                ((x & 0x000000000fff0000ULL) << 4) |
+                ((x & 0x00000000f0000000ULL) >> 12) |
+                ((x & 0x000000ff00000000ULL) << 8) |
+                ((x & 0x0000ff0000000000ULL) >> 8) |
+                ((x & 0x000f000000000000ULL) << 12) |
+                ((x & 0xfff0000000000000ULL) >> 4);
+    }
+}
+
+template <typename Word>
+static inline Word bitslicedRotateRow(Word x)
+{
+    return (x >> 16) | (x << 48);
+}
+
+template <typename Word>
+static inline Word bitslicedRotateTwoRows(Word x)
+{
+    return (x << 32) | (x >> 32);
 }
 
 ///
-/// Simple substition for the byte
-/// from sbox - i.e, for 0x04 we will replace with the
-/// byte at index 0x04 => 0xf2
+/// Rows are rotated to bring next row of the same column, multiplying
+/// by x (xtime) moves bit i to bit i + 1 and reduces bit 7 in to bits 0, 1, 3 and 4
 ///
-void AES::subBytes(State* state)
+template <typename Word>
+static inline void bitslicedMixColumns(Word* q)
 {
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    for (std::size_t i = 0; i < kNb; ++i) {
-        for (std::size_t j = 0; j < kNb; ++j) {
-            (*state)[i][j] = kSBox[(*state)[i][j]];
-        }
-    }
+    const Word q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    const Word q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    const Word r0 = bitslicedRotateRow(q0), r1 = bitslicedRotateRow(q1);
+    const Word r2 = bitslicedRotateRow(q2), r3 = bitslicedRotateRow(q3);
+    const Word r4 = bitslicedRotateRow(q4), r5 = bitslicedRotateRow(q5);
+    const Word r6 = bitslicedRotateRow(q6), r7 = bitslicedRotateRow(q7);
+
+    q[0] = q7 ^ r7 ^ r0 ^ bitslicedRotateTwoRows(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ bitslicedRotateTwoRows(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ bitslicedRotateTwoRows(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ bitslicedRotateTwoRows(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ bitslicedRotateTwoRows(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ bitslicedRotateTwoRows(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ bitslicedRotateTwoRows(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ bitslicedRotateTwoRows(q7 ^ r7);
+}
 
-#if MINE_PROFILING
-    endProfiling(started, "subBytes");
-#endif
+template <typename Word>
+static inline void bitslicedInvMixColumns(Word* q)
+{
+    const Word q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    const Word q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    const Word r0 = bitslicedRotateRow(q0), r1 = bitslicedRotateRow(q1);
+    const Word r2 = bitslicedRotateRow(q2), r3 = bitslicedRotateRow(q3);
+    const Word r4 = bitslicedRotateRow(q4), r5 = bitslicedRotateRow(q5);
+    const Word r6 = bitslicedRotateRow(q6), r7 = bitslicedRotateRow(q7);
+
+    q[0] = q5 ^ q6 ^ q7 ^ r0 ^ r5 ^ r7 ^ bitslicedRotateTwoRows(q0 ^ q5 ^ q6 ^ r0 ^ r5);
+    q[1] = q0 ^ q5 ^ r0 ^ r1 ^ r5 ^ r6 ^ r7 ^ bitslicedRotateTwoRows(q1 ^ q5 ^ q7 ^ r1 ^ r5 ^ r6);
+    q[2] = q0 ^ q1 ^ q6 ^ r1 ^ r2 ^ r6 ^ r7 ^ bitslicedRotateTwoRows(q0 ^ q2 ^ q6 ^ r2 ^ r6 ^ r7);
+    q[3] = q0 ^ q1 ^ q2 ^ q5 ^ q6 ^ r0 ^ r2 ^ r3 ^ r5 ^ bitslicedRotateTwoRows(q0 ^ q1 ^ q3 ^ q5 ^ q6 ^ q7 ^ r0 ^ r3 ^ r5 ^ r7);
+    q[4] = q1 ^ q2 ^ q3 ^ q5 ^ r1 ^ r3 ^ r4 ^ r5 ^ r6 ^ r7 ^ bitslicedRotateTwoRows(q1 ^ q2 ^ q4 ^ q5 ^ q7 ^ r1 ^ r4 ^ r5 ^ r6);
+    q[5] = q2 ^ q3 ^ q4 ^ q6 ^ r2 ^ r4 ^ r5 ^ r6 ^ r7 ^ bitslicedRotateTwoRows(q2 ^ q3 ^ q5 ^ q6 ^ r2 ^ r5 ^ r6 ^ r7);
+    q[6] = q3 ^ q4 ^ q5 ^ q7 ^ r3 ^ r5 ^ r6 ^ r7 ^ bitslicedRotateTwoRows(q3 ^ q4 ^ q6 ^ q7 ^ r3 ^ r6 ^ r7);
+    q[7] = q4 ^ q5 ^ q6 ^ r4 ^ r6 ^ r7 ^ bitslicedRotateTwoRows(q4 ^ q5 ^ q7 ^ r4 ^ r7);
+}
+
+template <typename Word>
+static inline void bitslicedAddRoundKey(Word* q, const Word* roundKey)
+{
+    for (int i = 0; i < 8; ++i) {
+        q[i] ^= roundKey[i];
+    }
 }
 
 ///
-/// A simple substition of bytes using kSBoxInverse
+/// Round keys (big-endian words) repeated for four blocks in bitsliced form
 ///
-void AES::invSubBytes(State* state)
+static void bitslicedRoundKeys(const uint32_t* roundKeys, uint8_t rounds, uint64_t* bitslicedKeys)
 {
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    for (std::size_t i = 0; i < kNb; ++i) {
-        for (std::size_t j = 0; j < kNb; ++j) {
-            (*state)[i][j] = kSBoxInverse[(*state)[i][j]];
+    byte blocks[64];
+    for (uint8_t round = 0; round <= rounds; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            storeWord(roundKeys[(round * 4) + i], blocks + (i * 4));
         }
+        std::copy_n(blocks, 16, blocks + 16);
+        std::copy_n(blocks, 32, blocks + 32);
+        bitslicedLoad4(blocks, bitslicedKeys + (round * 8));
     }
-#if MINE_PROFILING
-    endProfiling(started, "invSubBytes");
-#endif
 }
 
+#if MINE_BITSLICED_VECTOR
 ///
-/// Shifting rows is beautifully explained by diagram
-/// that helped in implementation as well
+/// Same round keys for both sets of the vector words
 ///
-/// Let's say we have state
+static void bitslicedRoundKeys(const uint32_t* roundKeys, uint8_t rounds, BitslicedWord* bitslicedKeys)
+{
+    uint64_t keys[15 * 8];
+    bitslicedRoundKeys(roundKeys, rounds, keys);
+    for (int i = 0; i < (rounds + 1) * 8; ++i) {
+        bitslicedKeys[i] = BitslicedWord{ keys[i], keys[i] };
+    }
+}
+#endif
+
 ///
-/// [ df  c3  e2  9c ]
-/// | 0f  ad  1f  ca |
-/// | 0c  9d  8d  fa |
-/// [ fe  ef  cc  b2 ]
+/// SubWord() without table lookup for constant-time key expansion
 ///
-/// shifting means
+static uint32_t bitslicedSubWord(uint32_t w)
+{
+    uint64_t q[8] = { w, 0, 0, 0, 0, 0, 0, 0 };
+    bitslicedOrtho(q);
+    bitslicedSubBytes(q);
+    bitslicedOrtho(q);
+    return static_cast<uint32_t>(q[0]);
+}
+
 ///
-///              [ df  c3  e2  9c ]
-///           0f | ad  1f  ca |
-///       0c  9d | 8d  fa |
-///   fe  ef  cc [ b2 ]
+/// Ciphers sets of eight words together, steps of the sets are
+/// independent so they can execute at the same time
 ///
-/// and filling the spaces with shifted rows
+template <typename Word>
+static inline void bitslicedEncrypt(Word* q, int sets, const Word* keys, uint8_t rounds)
+{
+    for (int set = 0; set < sets; ++set) {
+        bitslicedAddRoundKey(q + (set * 8), keys);
+    }
+    for (uint8_t round = 1; round <= rounds; ++round) {
+        for (int set = 0; set < sets; ++set) {
+            bitslicedSubBytes(q + (set * 8));
+            bitslicedShiftRows(q + (set * 8));
+            if (round != rounds) {
+                bitslicedMixColumns(q + (set * 8));
+            }
+            bitslicedAddRoundKey(q + (set * 8), keys + (round * 8));
+        }
+    }
+}
+
 ///
-/// [ df  c3  e2  9c ]
-/// | ad  1f  ca  0f |
-/// | 8d  fa  0c  9d |
-/// [ b2  fe  ef  cc ]
+/// Equivalent inverse cipher, expects key schedule from AES::toInverseKeySchedule()
 ///
-void AES::shiftRows(State *state)
+template <typename Word>
+static inline void bitslicedDecrypt(Word* q, int sets, const Word* keys, uint8_t rounds)
 {
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    // row 1
-    std::swap((*state)[0][1], (*state)[3][1]);
-    std::swap((*state)[0][1], (*state)[1][1]);
-    std::swap((*state)[1][1], (*state)[2][1]);
-
-    // row 2
-    std::swap((*state)[0][2], (*state)[2][2]);
-    std::swap((*state)[1][2], (*state)[3][2]);
+    for (int set = 0; set < sets; ++set) {
+        bitslicedAddRoundKey(q + (set * 8), keys);
+    }
+    for (uint8_t round = 1; round <= rounds; ++round) {
+        for (int set = 0; set < sets; ++set) {
+            bitslicedInvSubBytes(q + (set * 8));
+            bitslicedInvShiftRows(q + (set * 8));
+            if (round != rounds) {
+                bitslicedInvMixColumns(q + (set * 8));
+            }
+            bitslicedAddRoundKey(q + (set * 8), keys + (round * 8));
+        }
+    }
+}
 
-    // row 3
-    std::swap((*state)[0][3], (*state)[1][3]);
-    std::swap((*state)[2][3], (*state)[3][3]);
-    std::swap((*state)[0][3], (*state)[2][3]);
+///
+/// Eight blocks are ciphered at a time, last batch is padded with zeros
+///
+static void bitslicedEncryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* roundKeys, uint8_t rounds)
+{
+    BitslicedWord keys[15 * 8];
+    bitslicedRoundKeys(roundKeys, rounds, keys);
+    byte buffer[128];
+    for (std::size_t i = 0; i < blocks; i += 8) {
+        const std::size_t batch = std::min<std::size_t>(blocks - i, 8);
+        std::fill_n(buffer, sizeof(buffer), 0);
+        std::copy_n(input + (i * 16), batch * 16, buffer);
+        BitslicedWord q[kBitslicedWords];
+        bitslicedLoad(buffer, q);
+        bitslicedEncrypt(q, kBitslicedSets, keys, rounds);
+        bitslicedStore(q, buffer);
+        std::copy_n(buffer, batch * 16, output + (i * 16));
+    }
+}
 
-#if MINE_PROFILING
-    endProfiling(started, "shiftRows");
-#endif
+static void bitslicedDecryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* inverseRoundKeys, uint8_t rounds)
+{
+    BitslicedWord keys[15 * 8];
+    bitslicedRoundKeys(inverseRoundKeys, rounds, keys);
+    byte buffer[128];
+    for (std::size_t i = 0; i < blocks; i += 8) {
+        const std::size_t batch = std::min<std::size_t>(blocks - i, 8);
+        std::fill_n(buffer, sizeof(buffer), 0);
+        std::copy_n(input + (i * 16), batch * 16, buffer);
+        BitslicedWord q[kBitslicedWords];
+        bitslicedLoad(buffer, q);
+        bitslicedDecrypt(q, kBitslicedSets, keys, rounds);
+        bitslicedStore(q, buffer);
+        std::copy_n(buffer, batch * 16, output + (i * 16));
+    }
 }
 
 ///
-/// This is reverse of shift rows operation
+/// Chaining allows single block at a time, so it uses one set of
+/// 64-bit words (three of four blocks unused) rather than wide words
 ///
-/// Let's say we have state
+static void bitslicedEncryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const uint32_t* roundKeys, uint8_t rounds)
+{
+    uint64_t keys[15 * 8];
+    bitslicedRoundKeys(roundKeys, rounds, keys);
+    byte buffer[64] = {};
+    std::copy_n(iv, 16, buffer);
+    for (std::size_t i = 0; i < blocks; ++i) {
+        for (std::size_t j = 0; j < 16; ++j) {
+            buffer[j] ^= input[(i * 16) + j];
+        }
+        uint64_t q[8];
+        bitslicedLoad4(buffer, q);
+        bitslicedEncrypt(q, 1, keys, rounds);
+        bitslicedStore4(q, buffer);
+        std::copy_n(buffer, 16, output + (i * 16));
+    }
+    std::copy_n(buffer, 16, iv);
+}
+
 ///
-/// [ df  c3  e2  9c ]
-/// | ad  1f  ca  0f |
-/// | 8d  fa  0c  9d |
-/// [ b2  fe  ef  cc ]
+/// Up to eight chains of independent messages (lanes) take one
+/// block each per pass
 ///
-/// shifting means
+static void bitslicedEncryptCbcLanes(const byte* const* inputs, byte* const* outputs, byte* const* chains, std::size_t lanes, std::size_t blocks, const uint32_t* roundKeys, uint8_t rounds)
+{
+    BitslicedWord keys[15 * 8];
+    bitslicedRoundKeys(roundKeys, rounds, keys);
+    byte buffer[128] = {};
+    for (std::size_t j = 0; j < lanes; ++j) {
+        std::copy_n(chains[j], 16, buffer + (j * 16));
+    }
+    for (std::size_t i = 0; i < blocks; ++i) {
+        for (std::size_t j = 0; j < lanes; ++j) {
+            for (std::size_t k = 0; k < 16; ++k) {
+                buffer[(j * 16) + k] ^= inputs[j][(i * 16) + k];
+            }
+        }
+        BitslicedWord q[kBitslicedWords];
+        bitslicedLoad(buffer, q);
+        bitslicedEncrypt(q, kBitslicedSets, keys, rounds);
+        bitslicedStore(q, buffer);
+        for (std::size_t j = 0; j < lanes; ++j) {
+            std::copy_n(buffer + (j * 16), 16, outputs[j] + (i * 16));
+        }
+    }
+    for (std::size_t j = 0; j < lanes; ++j) {
+        std::copy_n(buffer + (j * 16), 16, chains[j]);
+    }
+}
+
 ///
-/// [ df  c3  e2  9c  ]
-///      | ad  1f  ca | 0f
-///          | 8d  fa | 0c  9d
-///              [ b2 | fe  ef  cc
+/// Eight blocks are deciphered at a time, buffer keeps previous cipher
+/// block followed by the batch as output can be same as input
 ///
-/// and filling the spaces with shifted rows
+static void bitslicedDecryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const uint32_t* inverseRoundKeys, uint8_t rounds)
+{
+    BitslicedWord keys[15 * 8];
+    bitslicedRoundKeys(inverseRoundKeys, rounds, keys);
+    byte cipher[144];
+    byte buffer[128];
+    std::copy_n(iv, 16, cipher);
+    for (std::size_t i = 0; i < blocks; i += 8) {
+        const std::size_t batch = std::min<std::size_t>(blocks - i, 8);
+        std::fill_n(cipher + 16, 128, 0);
+        std::copy_n(input + (i * 16), batch * 16, cipher + 16);
+        BitslicedWord q[kBitslicedWords];
+        bitslicedLoad(cipher + 16, q);
+        bitslicedDecrypt(q, kBitslicedSets, keys, rounds);
+        bitslicedStore(q, buffer);
+        for (std::size_t j = 0; j < batch * 16; ++j) {
+            output[(i * 16) + j] = buffer[j] ^ cipher[j];
+        }
+        std::copy_n(cipher + (batch * 16), 16, cipher);
+    }
+    std::copy_n(cipher, 16, iv);
+}
+
+#if MINE_AES_NI
+
 ///
-/// [ df  c3  e2  9c ]
-/// | 0f  ad  1f  ca |
-/// | 0c  9d  8d  fa |
-/// [ fe  ef  cc  b2 ]
+/// Round keys are big-endian words, this mask brings each word
+/// back to the byte order of the state for AESENC/AESDEC
 ///
-void AES::invShiftRows(State *state)
+MINE_TARGET_AES_NI
+static inline __m128i aesNiWordOrderMask()
 {
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    // row 1
-    std::swap((*state)[0][1], (*state)[1][1]);
-    std::swap((*state)[0][1], (*state)[2][1]);
-    std::swap((*state)[0][1], (*state)[3][1]);
-
-    // row 2
-    std::swap((*state)[0][2], (*state)[2][2]);
-    std::swap((*state)[1][2], (*state)[3][2]);
+    return _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+}
 
-    // row 3
-    std::swap((*state)[0][3], (*state)[3][3]);
-    std::swap((*state)[0][3], (*state)[2][3]);
-    std::swap((*state)[0][3], (*state)[1][3]);
-#if MINE_PROFILING
-    endProfiling(started, "intShiftRows");
-#endif
+MINE_TARGET_AES_NI
+static inline void aesNiLoadRoundKeys(const uint32_t* roundKeys, uint8_t rounds, __m128i* keys)
+{
+    const __m128i mask = aesNiWordOrderMask();
+    for (uint8_t round = 0; round <= rounds; ++round) {
+        keys[round] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys + round * 4)), mask);
+    }
 }
 
 ///
-/// Finds the product of {02} and the argument to
-/// xtime modulo {1b}
+/// Same as FIPS.197 Sec. 5.2 except RotWord() and SubWord() are done by AESKEYGENASSIST,
+/// the second dword of its result is RotWord(SubWord(x)) ^ rcon where we pass zero as rcon
+/// as it has to be an immediate value
 ///
-byte AES::xtime(byte x)
+MINE_TARGET_AES_NI
+static void aesNiKeyExpansion(const byte* key, uint8_t Nk, uint8_t Nr, const byte* roundConstant, uint32_t* words)
 {
-    return ((x << 1) ^ (((x >> 7) & 1) * 0x11b));
+    uint8_t i = 0;
+    for (; i < Nk; ++i) {
+        words[i] = loadWord(key + (i * 4));
+    }
+    for (; i < 4 * (Nr + 1); ++i) {
+        uint32_t temp = words[i - 1];
+        if (i % Nk == 0 || (Nk == 8 && i % Nk == 4)) {
+            int x = static_cast<int>(__builtin_bswap32(temp));
+            __m128i assisted = _mm_aeskeygenassist_si128(_mm_set_epi32(0, 0, x, x), 0);
+            if (i % Nk == 0) {
+                temp = __builtin_bswap32(static_cast<uint32_t>(_mm_extract_epi32(assisted, 1)));
+                temp ^= static_cast<uint32_t>(roundConstant[(i / Nk) - 1]) << 24;
+            } else {
+                // SubWord() only, see note for 256-bit keys on Sec. 5.2 on FIPS.197
+                temp = __builtin_bswap32(static_cast<uint32_t>(_mm_extract_epi32(assisted, 0)));
+            }
+        }
+        words[i] = words[i - Nk] ^ temp;
+    }
 }
 
 ///
-/// Multiplies numbers in the GF(2^8) field
+/// Runs eight independent blocks through the rounds at the same
+/// time, AESENC has latency of several cycles but can start every
+/// cycle so this keeps the unit busy. It must be inlined so the
+/// blocks stay in registers
 ///
-byte AES::multiply(byte x, byte y)
+MINE_TARGET_AES_NI
+static inline __attribute__((always_inline)) void aesNiEncrypt8(__m128i* b, const __m128i* keys, uint8_t rounds)
 {
-    return (((y & 0x01) * x) ^
-            ((y >> 1 & 0x01) * xtime(x)) ^
-            ((y >> 2 & 0x01) * xtime(xtime(x))) ^
-            ((y >> 3 & 0x01) * xtime(xtime(xtime(x)))) ^
-            ((y >> 4 & 0x01) * xtime(xtime(xtime(xtime(x))))));
+    b[0] = _mm_xor_si128(b[0], keys[0]);
+    b[1] = _mm_xor_si128(b[1], keys[0]);
+    b[2] = _mm_xor_si128(b[2], keys[0]);
+    b[3] = _mm_xor_si128(b[3], keys[0]);
+    b[4] = _mm_xor_si128(b[4], keys[0]);
+    b[5] = _mm_xor_si128(b[5], keys[0]);
+    b[6] = _mm_xor_si128(b[6], keys[0]);
+    b[7] = _mm_xor_si128(b[7], keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        b[0] = _mm_aesenc_si128(b[0], keys[round]);
+        b[1] = _mm_aesenc_si128(b[1], keys[round]);
+        b[2] = _mm_aesenc_si128(b[2], keys[round]);
+        b[3] = _mm_aesenc_si128(b[3], keys[round]);
+        b[4] = _mm_aesenc_si128(b[4], keys[round]);
+        b[5] = _mm_aesenc_si128(b[5], keys[round]);
+        b[6] = _mm_aesenc_si128(b[6], keys[round]);
+        b[7] = _mm_aesenc_si128(b[7], keys[round]);
+    }
+    b[0] = _mm_aesenclast_si128(b[0], keys[rounds]);
+    b[1] = _mm_aesenclast_si128(b[1], keys[rounds]);
+    b[2] = _mm_aesenclast_si128(b[2], keys[rounds]);
+    b[3] = _mm_aesenclast_si128(b[3], keys[rounds]);
+    b[4] = _mm_aesenclast_si128(b[4], keys[rounds]);
+    b[5] = _mm_aesenclast_si128(b[5], keys[rounds]);
+    b[6] = _mm_aesenclast_si128(b[6], keys[rounds]);
+    b[7] = _mm_aesenclast_si128(b[7], keys[rounds]);
 }
 
 ///
-/// multiplies in GF(2^8) field selected column from state
-/// with constant matrix defined by publication
-///
-/// [ 02  03  01  01 ]
-/// | 01  02  03  01 |
-/// | 01  01  02  03 |
-/// [ 03  01  01  02 ]
+/// Same as aesNiEncrypt8() for inverse cipher
 ///
-void AES::mixColumns(State* state)
+MINE_TARGET_AES_NI
+static inline __attribute__((always_inline)) void aesNiDecrypt8(__m128i* b, const __m128i* keys, uint8_t rounds)
 {
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    for (int col = 0; col < 4; ++col) {
-        Word column = (*state)[col];
-        // let's take example from publication, col: [212, 191, 93, 48]
-        // t == 6
-        byte t = column[0] ^ column[1] ^ column[2] ^ column[3];
-        // see Sec. 4.2.1 and Sec. 5.1.3 for more details
-        (*state)[col][0] ^= xtime(column[0] ^ column[1]) ^ t;
-        (*state)[col][1] ^= xtime(column[1] ^ column[2]) ^ t;
-        (*state)[col][2] ^= xtime(column[2] ^ column[3]) ^ t;
-        (*state)[col][3] ^= xtime(column[3] ^ column[0]) ^ t;
+    b[0] = _mm_xor_si128(b[0], keys[0]);
+    b[1] = _mm_xor_si128(b[1], keys[0]);
+    b[2] = _mm_xor_si128(b[2], keys[0]);
+    b[3] = _mm_xor_si128(b[3], keys[0]);
+    b[4] = _mm_xor_si128(b[4], keys[0]);
+    b[5] = _mm_xor_si128(b[5], keys[0]);
+    b[6] = _mm_xor_si128(b[6], keys[0]);
+    b[7] = _mm_xor_si128(b[7], keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        b[0] = _mm_aesdec_si128(b[0], keys[round]);
+        b[1] = _mm_aesdec_si128(b[1], keys[round]);
+        b[2] = _mm_aesdec_si128(b[2], keys[round]);
+        b[3] = _mm_aesdec_si128(b[3], keys[round]);
+        b[4] = _mm_aesdec_si128(b[4], keys[round]);
+        b[5] = _mm_aesdec_si128(b[5], keys[round]);
+        b[6] = _mm_aesdec_si128(b[6], keys[round]);
+        b[7] = _mm_aesdec_si128(b[7], keys[round]);
+    }
+    b[0] = _mm_aesdeclast_si128(b[0], keys[rounds]);
+    b[1] = _mm_aesdeclast_si128(b[1], keys[rounds]);
+    b[2] = _mm_aesdeclast_si128(b[2], keys[rounds]);
+    b[3] = _mm_aesdeclast_si128(b[3], keys[rounds]);
+    b[4] = _mm_aesdeclast_si128(b[4], keys[rounds]);
+    b[5] = _mm_aesdeclast_si128(b[5], keys[rounds]);
+    b[6] = _mm_aesdeclast_si128(b[6], keys[rounds]);
+    b[7] = _mm_aesdeclast_si128(b[7], keys[rounds]);
+}
+
+MINE_TARGET_AES_NI
+static inline __m128i aesNiEncrypt(__m128i block, const __m128i* keys, uint8_t rounds)
+{
+    block = _mm_xor_si128(block, keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        block = _mm_aesenc_si128(block, keys[round]);
+    }
+    return _mm_aesenclast_si128(block, keys[rounds]);
+}
+
+MINE_TARGET_AES_NI
+static inline __m128i aesNiDecrypt(__m128i block, const __m128i* keys, uint8_t rounds)
+{
+    block = _mm_xor_si128(block, keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        block = _mm_aesdec_si128(block, keys[round]);
+    }
+    return _mm_aesdeclast_si128(block, keys[rounds]);
+}
+
+MINE_TARGET_AES_NI
+static void aesNiEncryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* roundKeys, uint8_t rounds)
+{
+    __m128i keys[15];
+    aesNiLoadRoundKeys(roundKeys, rounds, keys);
+    const __m128i* in = reinterpret_cast<const __m128i*>(input);
+    __m128i* out = reinterpret_cast<__m128i*>(output);
+    std::size_t i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        __m128i b[8];
+        for (int j = 0; j < 8; ++j) {
+            b[j] = _mm_loadu_si128(in + i + j);
+        }
+        aesNiEncrypt8(b, keys, rounds);
+        for (int j = 0; j < 8; ++j) {
+            _mm_storeu_si128(out + i + j, b[j]);
+        }
+    }
+    for (; i < blocks; ++i) {
+        _mm_storeu_si128(out + i, aesNiEncrypt(_mm_loadu_si128(in + i), keys, rounds));
     }
-#if MINE_PROFILING
-    endProfiling(started, "mixColumns");
-#endif
 }
 
 ///
-/// Inverse multiplication with inverse matrix defined on Sec. 5.3.3
+/// AESDEC implements equivalent inverse cipher so this expects
+/// key schedule from AES::toInverseKeySchedule()
 ///
-/// [ 0e  0b  0d  09 ]
-/// | 09  0e  0b  0d |
-/// | 0d  09  0e  0b |
-/// [ 0b  0d  09  0e ]
+MINE_TARGET_AES_NI
+static void aesNiDecryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* inverseRoundKeys, uint8_t rounds)
+{
+    __m128i keys[15];
+    aesNiLoadRoundKeys(inverseRoundKeys, rounds, keys);
+    const __m128i* in = reinterpret_cast<const __m128i*>(input);
+    __m128i* out = reinterpret_cast<__m128i*>(output);
+    std::size_t i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        __m128i b[8];
+        for (int j = 0; j < 8; ++j) {
+            b[j] = _mm_loadu_si128(in + i + j);
+        }
+        aesNiDecrypt8(b, keys, rounds);
+        for (int j = 0; j < 8; ++j) {
+            _mm_storeu_si128(out + i + j, b[j]);
+        }
+    }
+    for (; i < blocks; ++i) {
+        _mm_storeu_si128(out + i, aesNiDecrypt(_mm_loadu_si128(in + i), keys, rounds));
+    }
+}
+
 ///
-void AES::invMixColumns(State* state)
+/// Counter blocks are made in registers by replacing last 32-bit word
+/// of counter block, caller makes sure this word does not wrap around
+/// within the blocks
+///
+MINE_TARGET_AES_NI
+static void aesNiCtrBlocks(const byte* input, byte* output, std::size_t blocks, const byte* counterBlock, const uint32_t* roundKeys, uint8_t rounds)
 {
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    for (int col = 0; col < 4; ++col) {
-        Word column = (*state)[col];
-        // see Sec. 4.2.1 and Sec. 5.3.3 for more details
-        (*state)[col][0] = multiply(column[0], 0x0e) ^ multiply(column[1], 0x0b) ^ multiply(column[2], 0x0d) ^ multiply(column[3], 0x09);
-        (*state)[col][1] = multiply(column[0], 0x09) ^ multiply(column[1], 0x0e) ^ multiply(column[2], 0x0b) ^ multiply(column[3], 0x0d);
-        (*state)[col][2] = multiply(column[0], 0x0d) ^ multiply(column[1], 0x09) ^ multiply(column[2], 0x0e) ^ multiply(column[3], 0x0b);
-        (*state)[col][3] = multiply(column[0], 0x0b) ^ multiply(column[1], 0x0d) ^ multiply(column[2], 0x09) ^ multiply(column[3], 0x0e);
+    __m128i keys[15];
+    aesNiLoadRoundKeys(roundKeys, rounds, keys);
+    const __m128i* in = reinterpret_cast<const __m128i*>(input);
+    __m128i* out = reinterpret_cast<__m128i*>(output);
+    const __m128i base = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counterBlock));
+    const uint32_t counter = loadWord(counterBlock + 12);
+    std::size_t i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        __m128i b[8];
+        for (int j = 0; j < 8; ++j) {
+            b[j] = _mm_insert_epi32(base, static_cast<int>(__builtin_bswap32(static_cast<uint32_t>(counter + i + j))), 3);
+        }
+        aesNiEncrypt8(b, keys, rounds);
+        for (int j = 0; j < 8; ++j) {
+            _mm_storeu_si128(out + i + j, _mm_xor_si128(_mm_loadu_si128(in + i + j), b[j]));
+        }
+    }
+    for (; i < blocks; ++i) {
+        const __m128i block = _mm_insert_epi32(base, static_cast<int>(__builtin_bswap32(static_cast<uint32_t>(counter + i))), 3);
+        _mm_storeu_si128(out + i, _mm_xor_si128(_mm_loadu_si128(in + i), aesNiEncrypt(block, keys, rounds)));
     }
-#if MINE_PROFILING
-    endProfiling(started, "invMixColumns");
-#endif
 }
 
-void AES::initState(State* state, const ByteArray::const_iterator& begin)
+MINE_TARGET_AES_NI
+static void aesNiEncryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const uint32_t* roundKeys, uint8_t rounds)
 {
-    // Pad the input if needed
-    // 29/08 removed this check because it's not needed as
-    // this function is only called from private interface
-    // this removal helped made input pass by ref
-    /*if (input.size() < kBlockSize) {
-        std::fill_n(input.end(), kBlockSize - input.size(), 0);
-    }*/
+    __m128i keys[15];
+    aesNiLoadRoundKeys(roundKeys, rounds, keys);
+    __m128i chain = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+    for (std::size_t i = 0; i < blocks; ++i) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * 16));
+        chain = aesNiEncrypt(_mm_xor_si128(block, chain), keys, rounds);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 16), chain);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), chain);
+}
 
-    // assign it to state for processing
-    for (std::size_t i = 0; i < kNb; ++i) {
-        for (std::size_t j = 0; j < kNb; ++j) {
-            (*state)[i][j] = begin[(kNb * i) + j];
+///
+/// Chains of independent messages (lanes) are interleaved so eight
+/// blocks are in flight even though each chain is serial. Lanes
+/// beyond count repeat lane 0, i.e, same blocks are written twice
+///
+MINE_TARGET_AES_NI
+static void aesNiEncryptCbcLanes(const byte* const* inputs, byte* const* outputs, byte* const* chains, std::size_t lanes, std::size_t blocks, const uint32_t* roundKeys, uint8_t rounds)
+{
+    __m128i keys[15];
+    aesNiLoadRoundKeys(roundKeys, rounds, keys);
+    const __m128i* in[8];
+    __m128i* out[8];
+    __m128i chain[8];
+    for (std::size_t j = 0; j < 8; ++j) {
+        const std::size_t lane = j < lanes ? j : 0;
+        in[j] = reinterpret_cast<const __m128i*>(inputs[lane]);
+        out[j] = reinterpret_cast<__m128i*>(outputs[lane]);
+        chain[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chains[lane]));
+    }
+    for (std::size_t i = 0; i < blocks; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            chain[j] = _mm_xor_si128(chain[j], _mm_loadu_si128(in[j] + i));
+        }
+        aesNiEncrypt8(chain, keys, rounds);
+        for (int j = 0; j < 8; ++j) {
+            _mm_storeu_si128(out[j] + i, chain[j]);
         }
     }
+    for (std::size_t j = 0; j < lanes; ++j) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(chains[j]), chain[j]);
+    }
 }
 
-ByteArray AES::stateToByteArray(const State *state)
+///
+/// Same as aesNiEncryptCbcLanes() with own round keys for each lane,
+/// round keys of all lanes do not fit in registers so AESENC takes
+/// them from memory
+///
+MINE_TARGET_AES_NI
+static void aesNiEncryptCbcKeyedLanes(const byte* const* inputs, byte* const* outputs, byte* const* chains, std::size_t lanes, std::size_t blocks, const uint32_t* const* roundKeys, uint8_t rounds)
 {
+    __m128i keys[8][15];
+    const __m128i* in[8];
+    __m128i* out[8];
+    __m128i chain[8];
+    for (std::size_t j = 0; j < 8; ++j) {
+        const std::size_t lane = j < lanes ? j : 0;
+        aesNiLoadRoundKeys(roundKeys[lane], rounds, keys[j]);
+        in[j] = reinterpret_cast<const __m128i*>(inputs[lane]);
+        out[j] = reinterpret_cast<__m128i*>(outputs[lane]);
+        chain[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chains[lane]));
+    }
+    for (std::size_t i = 0; i < blocks; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            chain[j] = _mm_xor_si128(_mm_xor_si128(chain[j], _mm_loadu_si128(in[j] + i)), keys[j][0]);
+        }
+        for (uint8_t round = 1; round < rounds; ++round) {
+            chain[0] = _mm_aesenc_si128(chain[0], keys[0][round]);
+            chain[1] = _mm_aesenc_si128(chain[1], keys[1][round]);
+            chain[2] = _mm_aesenc_si128(chain[2], keys[2][round]);
+            chain[3] = _mm_aesenc_si128(chain[3], keys[3][round]);
+            chain[4] = _mm_aesenc_si128(chain[4], keys[4][round]);
+            chain[5] = _mm_aesenc_si128(chain[5], keys[5][round]);
+            chain[6] = _mm_aesenc_si128(chain[6], keys[6][round]);
+            chain[7] = _mm_aesenc_si128(chain[7], keys[7][round]);
+        }
+        for (int j = 0; j < 8; ++j) {
+            chain[j] = _mm_aesenclast_si128(chain[j], keys[j][rounds]);
+            _mm_storeu_si128(out[j] + i, chain[j]);
+        }
+    }
+    for (std::size_t j = 0; j < lanes; ++j) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(chains[j]), chain[j]);
+    }
+}
 
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    ByteArray result(kBlockSize);
-    int k = 0;
-    for (std::size_t i = 0; i < kNb; ++i) {
-        for (std::size_t j = 0; j < kNb; ++j) {
-            result[k++] = (*state)[i][j];
+///
+/// Two independent blocks through the rounds at the same time, see
+/// aesNiEncrypt8()
+///
+MINE_TARGET_AES_NI
+static inline __attribute__((always_inline)) void aesNiEncrypt2(__m128i* b, const __m128i* keys, uint8_t rounds)
+{
+    b[0] = _mm_xor_si128(b[0], keys[0]);
+    b[1] = _mm_xor_si128(b[1], keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        b[0] = _mm_aesenc_si128(b[0], keys[round]);
+        b[1] = _mm_aesenc_si128(b[1], keys[round]);
+    }
+    b[0] = _mm_aesenclast_si128(b[0], keys[rounds]);
+    b[1] = _mm_aesenclast_si128(b[1], keys[rounds]);
+}
+
+///
+/// CBC-MAC of a block and key stream of the next block do not depend on
+/// each other so both are in flight at the same time, CTR-Mode costs
+/// (almost) nothing on top of the serial CBC-MAC chain. Key stream runs
+/// one block ahead because deciphered block is needed before it's
+/// authenticated. Counter blocks are made in registers by replacing last
+/// 64-bit of counter block, CCM counter never wraps around (it's checked
+/// against input length) so carry never reaches nonce
+///
+MINE_TARGET_AES_NI
+static void aesNiCcmBlocks(const byte* input, byte* output, std::size_t blocks, byte* mac, byte* counterBlock, bool decrypting, const uint32_t* roundKeys, uint8_t rounds)
+{
+    __m128i keys[15];
+    aesNiLoadRoundKeys(roundKeys, rounds, keys);
+    const __m128i* in = reinterpret_cast<const __m128i*>(input);
+    __m128i* out = reinterpret_cast<__m128i*>(output);
+    const __m128i base = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counterBlock));
+    const uint64_t counter = loadDoubleWord(counterBlock + 8);
+    __m128i chain = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mac));
+    __m128i keyStream = aesNiEncrypt(base, keys, rounds);
+    for (std::size_t i = 0; i < blocks; ++i) {
+        const uint64_t next = counter + i + 1;
+        const __m128i block = _mm_loadu_si128(in + i);
+        const __m128i result = _mm_xor_si128(block, keyStream);
+        _mm_storeu_si128(out + i, result);
+        __m128i b[2];
+        b[0] = _mm_xor_si128(chain, decrypting ? result : block);
+        b[1] = _mm_insert_epi32(base, static_cast<int>(__builtin_bswap32(static_cast<uint32_t>(next >> 32))), 2);
+        b[1] = _mm_insert_epi32(b[1], static_cast<int>(__builtin_bswap32(static_cast<uint32_t>(next))), 3);
+        aesNiEncrypt2(b, keys, rounds);
+        chain = b[0];
+        keyStream = b[1];
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mac), chain);
+    storeDoubleWord(counter + blocks, counterBlock + 8);
+}
+
+///
+/// Plain text block only depends on two cipher blocks so eight
+/// blocks are deciphered at a time, all the cipher blocks are loaded
+/// before storing so output can be same as input
+///
+MINE_TARGET_AES_NI
+static void aesNiDecryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const uint32_t* inverseRoundKeys, uint8_t rounds)
+{
+    __m128i keys[15];
+    aesNiLoadRoundKeys(inverseRoundKeys, rounds, keys);
+    __m128i chain = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+    std::size_t i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(input + i * 16);
+        __m128i* out = reinterpret_cast<__m128i*>(output + i * 16);
+        __m128i cipher[8];
+        __m128i b[8];
+        for (int j = 0; j < 8; ++j) {
+            cipher[j] = _mm_loadu_si128(in + j);
+            b[j] = cipher[j];
         }
+        aesNiDecrypt8(b, keys, rounds);
+        _mm_storeu_si128(out, _mm_xor_si128(b[0], chain));
+        for (int j = 1; j < 8; ++j) {
+            _mm_storeu_si128(out + j, _mm_xor_si128(b[j], cipher[j - 1]));
+        }
+        chain = cipher[7];
+    }
+    for (; i < blocks; ++i) {
+        __m128i cipher = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * 16));
+        __m128i block = aesNiDecrypt(cipher, keys, rounds);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 16), _mm_xor_si128(block, chain));
+        chain = cipher;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), chain);
+}
+
+///
+/// GHASH works on bit-reflected values so blocks are byte reversed
+/// for carry-less multiplication as described by Intel in
+/// "Carry-Less Multiplication Instruction and its Usage for
+/// Computing the GCM Mode" (Gueron & Kounavis)
+///
+MINE_TARGET_PCLMUL
+static inline __m128i pclmulByteReverseMask()
+{
+    return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+///
+/// 256-bit carry-less product a * b (Karatsuba) is xor'ed in to lo and hi
+///
+MINE_TARGET_PCLMUL
+static inline void pclmulMultiply(__m128i a, __m128i b, __m128i* lo, __m128i* hi)
+{
+    __m128i low = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i high = _mm_clmulepi64_si128(a, b, 0x11);
+    __m128i middle = _mm_xor_si128(_mm_clmulepi64_si128(_mm_xor_si128(a, _mm_srli_si128(a, 8)),
+                                                        _mm_xor_si128(b, _mm_srli_si128(b, 8)), 0x00),
+                                   _mm_xor_si128(low, high));
+    *lo = _mm_xor_si128(*lo, _mm_xor_si128(low, _mm_slli_si128(middle, 8)));
+    *hi = _mm_xor_si128(*hi, _mm_xor_si128(high, _mm_srli_si128(middle, 8)));
+}
+
+///
+/// Shifts 256-bit product left by one bit (bit-reflection) and
+/// reduces it modulo x^128 + x^7 + x^2 + x + 1
+///
+MINE_TARGET_PCLMUL
+static inline __m128i pclmulReduce(__m128i lo, __m128i hi)
+{
+    __m128i carryLo = _mm_srli_epi32(lo, 31);
+    __m128i carryHi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i carryOut = _mm_srli_si128(carryLo, 12);
+    carryHi = _mm_slli_si128(carryHi, 4);
+    carryLo = _mm_slli_si128(carryLo, 4);
+    lo = _mm_or_si128(lo, carryLo);
+    hi = _mm_or_si128(_mm_or_si128(hi, carryHi), carryOut);
+
+    __m128i a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    __m128i b = _mm_srli_si128(a, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(a, 12));
+    __m128i c = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    c = _mm_xor_si128(c, b);
+    lo = _mm_xor_si128(lo, c);
+    return _mm_xor_si128(hi, lo);
+}
+
+MINE_TARGET_PCLMUL
+static void pclmulGHashPowers(const byte* h, byte* powers)
+{
+    const __m128i mask = pclmulByteReverseMask();
+    __m128i hashKey = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h)), mask);
+    __m128i power = hashKey;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(powers), power);
+    for (int i = 1; i < 4; ++i) {
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        pclmulMultiply(power, hashKey, &lo, &hi);
+        power = pclmulReduce(lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(powers + (i * 16)), power);
+    }
+}
+
+///
+/// Four blocks are hashed with single reduction using
+/// (((Y + X1) * H^4) + (X2 * H^3) + (X3 * H^2) + (X4 * H))
+///
+MINE_TARGET_PCLMUL
+static void pclmulGHash(byte* y, const byte* powers, const byte* data, std::size_t blocks)
+{
+    const __m128i mask = pclmulByteReverseMask();
+    const __m128i h1 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers));
+    const __m128i h2 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers + 16));
+    const __m128i h3 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers + 32));
+    const __m128i h4 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers + 48));
+    __m128i hash = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y)), mask);
+    std::size_t i = 0;
+    for (; i + 4 <= blocks; i += 4) {
+        const __m128i* x = reinterpret_cast<const __m128i*>(data + (i * 16));
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        pclmulMultiply(_mm_xor_si128(hash, _mm_shuffle_epi8(_mm_loadu_si128(x), mask)), h4, &lo, &hi);
+        pclmulMultiply(_mm_shuffle_epi8(_mm_loadu_si128(x + 1), mask), h3, &lo, &hi);
+        pclmulMultiply(_mm_shuffle_epi8(_mm_loadu_si128(x + 2), mask), h2, &lo, &hi);
+        pclmulMultiply(_mm_shuffle_epi8(_mm_loadu_si128(x + 3), mask), h1, &lo, &hi);
+        hash = pclmulReduce(lo, hi);
+    }
+    for (; i < blocks; ++i) {
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + (i * 16))), mask);
+        pclmulMultiply(_mm_xor_si128(hash, x), h1, &lo, &hi);
+        hash = pclmulReduce(lo, hi);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(y), _mm_shuffle_epi8(hash, mask));
+}
+
+#endif // MINE_AES_NI
+
+#if MINE_VAES
+
+//
+// VAES engine, AES-NI rounds on 512-bit registers of four blocks. Only the
+// modes with independent blocks (ECB, CTR and CBC decryption) use it, rest is
+// same as AES-NI engine
+//
+
+///
+/// Same block in all four places. Zero-masking forms of the intrinsics are used here
+/// and in vaesShiftIn() as plain forms trip -Wuninitialized on some GCC versions
+///
+MINE_TARGET_VAES
+static inline __m512i vaesBroadcast(__m128i block)
+{
+    return _mm512_maskz_broadcast_i32x4(0xffff, block);
+}
+
+///
+/// Blocks shifted up by one place with last block of previous coming in first place
+///
+MINE_TARGET_VAES
+static inline __m512i vaesShiftIn(__m512i blocks, __m512i previous)
+{
+    return _mm512_maskz_alignr_epi64(0xff, blocks, previous, 6);
+}
+
+MINE_TARGET_VAES
+static inline void vaesLoadRoundKeys(const uint32_t* roundKeys, uint8_t rounds, __m512i* keys)
+{
+    __m128i narrowKeys[15];
+    aesNiLoadRoundKeys(roundKeys, rounds, narrowKeys);
+    for (uint8_t round = 0; round <= rounds; ++round) {
+        keys[round] = vaesBroadcast(narrowKeys[round]);
+    }
+}
+
+///
+/// Mask of first blocks (less than four) of a register, for
+/// loading and storing the last blocks of input
+///
+static inline __mmask8 vaesBlocksMask(std::size_t blocks)
+{
+    return static_cast<__mmask8>((1u << (2 * blocks)) - 1);
+}
+
+///
+/// Same as aesNiEncrypt8() on eight registers, i.e, 32 blocks
+///
+MINE_TARGET_VAES
+static inline __attribute__((always_inline)) void vaesEncrypt8(__m512i* b, const __m512i* keys, uint8_t rounds)
+{
+    b[0] = _mm512_xor_si512(b[0], keys[0]);
+    b[1] = _mm512_xor_si512(b[1], keys[0]);
+    b[2] = _mm512_xor_si512(b[2], keys[0]);
+    b[3] = _mm512_xor_si512(b[3], keys[0]);
+    b[4] = _mm512_xor_si512(b[4], keys[0]);
+    b[5] = _mm512_xor_si512(b[5], keys[0]);
+    b[6] = _mm512_xor_si512(b[6], keys[0]);
+    b[7] = _mm512_xor_si512(b[7], keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        b[0] = _mm512_aesenc_epi128(b[0], keys[round]);
+        b[1] = _mm512_aesenc_epi128(b[1], keys[round]);
+        b[2] = _mm512_aesenc_epi128(b[2], keys[round]);
+        b[3] = _mm512_aesenc_epi128(b[3], keys[round]);
+        b[4] = _mm512_aesenc_epi128(b[4], keys[round]);
+        b[5] = _mm512_aesenc_epi128(b[5], keys[round]);
+        b[6] = _mm512_aesenc_epi128(b[6], keys[round]);
+        b[7] = _mm512_aesenc_epi128(b[7], keys[round]);
+    }
+    b[0] = _mm512_aesenclast_epi128(b[0], keys[rounds]);
+    b[1] = _mm512_aesenclast_epi128(b[1], keys[rounds]);
+    b[2] = _mm512_aesenclast_epi128(b[2], keys[rounds]);
+    b[3] = _mm512_aesenclast_epi128(b[3], keys[rounds]);
+    b[4] = _mm512_aesenclast_epi128(b[4], keys[rounds]);
+    b[5] = _mm512_aesenclast_epi128(b[5], keys[rounds]);
+    b[6] = _mm512_aesenclast_epi128(b[6], keys[rounds]);
+    b[7] = _mm512_aesenclast_epi128(b[7], keys[rounds]);
+}
+
+MINE_TARGET_VAES
+static inline __attribute__((always_inline)) void vaesDecrypt8(__m512i* b, const __m512i* keys, uint8_t rounds)
+{
+    b[0] = _mm512_xor_si512(b[0], keys[0]);
+    b[1] = _mm512_xor_si512(b[1], keys[0]);
+    b[2] = _mm512_xor_si512(b[2], keys[0]);
+    b[3] = _mm512_xor_si512(b[3], keys[0]);
+    b[4] = _mm512_xor_si512(b[4], keys[0]);
+    b[5] = _mm512_xor_si512(b[5], keys[0]);
+    b[6] = _mm512_xor_si512(b[6], keys[0]);
+    b[7] = _mm512_xor_si512(b[7], keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        b[0] = _mm512_aesdec_epi128(b[0], keys[round]);
+        b[1] = _mm512_aesdec_epi128(b[1], keys[round]);
+        b[2] = _mm512_aesdec_epi128(b[2], keys[round]);
+        b[3] = _mm512_aesdec_epi128(b[3], keys[round]);
+        b[4] = _mm512_aesdec_epi128(b[4], keys[round]);
+        b[5] = _mm512_aesdec_epi128(b[5], keys[round]);
+        b[6] = _mm512_aesdec_epi128(b[6], keys[round]);
+        b[7] = _mm512_aesdec_epi128(b[7], keys[round]);
+    }
+    b[0] = _mm512_aesdeclast_epi128(b[0], keys[rounds]);
+    b[1] = _mm512_aesdeclast_epi128(b[1], keys[rounds]);
+    b[2] = _mm512_aesdeclast_epi128(b[2], keys[rounds]);
+    b[3] = _mm512_aesdeclast_epi128(b[3], keys[rounds]);
+    b[4] = _mm512_aesdeclast_epi128(b[4], keys[rounds]);
+    b[5] = _mm512_aesdeclast_epi128(b[5], keys[rounds]);
+    b[6] = _mm512_aesdeclast_epi128(b[6], keys[rounds]);
+    b[7] = _mm512_aesdeclast_epi128(b[7], keys[rounds]);
+}
+
+MINE_TARGET_VAES
+static inline __m512i vaesEncrypt(__m512i block, const __m512i* keys, uint8_t rounds)
+{
+    block = _mm512_xor_si512(block, keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        block = _mm512_aesenc_epi128(block, keys[round]);
+    }
+    return _mm512_aesenclast_epi128(block, keys[rounds]);
+}
+
+MINE_TARGET_VAES
+static inline __m512i vaesDecrypt(__m512i block, const __m512i* keys, uint8_t rounds)
+{
+    block = _mm512_xor_si512(block, keys[0]);
+    for (uint8_t round = 1; round < rounds; ++round) {
+        block = _mm512_aesdec_epi128(block, keys[round]);
+    }
+    return _mm512_aesdeclast_epi128(block, keys[rounds]);
+}
+
+MINE_TARGET_VAES
+static void vaesEncryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* roundKeys, uint8_t rounds)
+{
+    __m512i keys[15];
+    vaesLoadRoundKeys(roundKeys, rounds, keys);
+    std::size_t i = 0;
+    for (; i + 32 <= blocks; i += 32) {
+        __m512i b[8];
+        for (int j = 0; j < 8; ++j) {
+            b[j] = _mm512_loadu_si512(input + ((i + (4 * j)) * 16));
+        }
+        vaesEncrypt8(b, keys, rounds);
+        for (int j = 0; j < 8; ++j) {
+            _mm512_storeu_si512(output + ((i + (4 * j)) * 16), b[j]);
+        }
+    }
+    for (; i < blocks; i += 4) {
+        const __mmask8 mask = vaesBlocksMask(std::min<std::size_t>(blocks - i, 4));
+        const __m512i block = _mm512_maskz_loadu_epi64(mask, input + (i * 16));
+        _mm512_mask_storeu_epi64(output + (i * 16), mask, vaesEncrypt(block, keys, rounds));
+    }
+}
+
+MINE_TARGET_VAES
+static void vaesDecryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* inverseRoundKeys, uint8_t rounds)
+{
+    __m512i keys[15];
+    vaesLoadRoundKeys(inverseRoundKeys, rounds, keys);
+    std::size_t i = 0;
+    for (; i + 32 <= blocks; i += 32) {
+        __m512i b[8];
+        for (int j = 0; j < 8; ++j) {
+            b[j] = _mm512_loadu_si512(input + ((i + (4 * j)) * 16));
+        }
+        vaesDecrypt8(b, keys, rounds);
+        for (int j = 0; j < 8; ++j) {
+            _mm512_storeu_si512(output + ((i + (4 * j)) * 16), b[j]);
+        }
+    }
+    for (; i < blocks; i += 4) {
+        const __mmask8 mask = vaesBlocksMask(std::min<std::size_t>(blocks - i, 4));
+        const __m512i block = _mm512_maskz_loadu_epi64(mask, input + (i * 16));
+        _mm512_mask_storeu_epi64(output + (i * 16), mask, vaesDecrypt(block, keys, rounds));
+    }
+}
+
+///
+/// Same as aesNiCtrBlocks(), counters are kept as native 32-bit integers in
+/// last word of each block and byte swapped in to the counter blocks
+///
+MINE_TARGET_VAES
+static void vaesCtrBlocks(const byte* input, byte* output, std::size_t blocks, const byte* counterBlock, const uint32_t* roundKeys, uint8_t rounds)
+{
+    __m512i keys[15];
+    vaesLoadRoundKeys(roundKeys, rounds, keys);
+    const __m512i base = vaesBroadcast(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counterBlock)));
+    const __m512i byteSwap = vaesBroadcast(_mm_set_epi8(12, 13, 14, 15, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    const __m512i four = _mm512_set_epi32(4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0);
+    const __mmask16 lastWords = 0x8888;
+    const int counter = static_cast<int>(loadWord(counterBlock + 12));
+    __m512i counters = _mm512_add_epi32(_mm512_set_epi32(3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0),
+                                        _mm512_maskz_set1_epi32(lastWords, counter));
+    std::size_t i = 0;
+    for (; i + 32 <= blocks; i += 32) {
+        __m512i b[8];
+        for (int j = 0; j < 8; ++j) {
+            b[j] = _mm512_mask_blend_epi32(lastWords, base, _mm512_shuffle_epi8(counters, byteSwap));
+            counters = _mm512_add_epi32(counters, four);
+        }
+        vaesEncrypt8(b, keys, rounds);
+        for (int j = 0; j < 8; ++j) {
+            byte* out = output + ((i + (4 * j)) * 16);
+            _mm512_storeu_si512(out, _mm512_xor_si512(b[j], _mm512_loadu_si512(input + ((i + (4 * j)) * 16))));
+        }
+    }
+    for (; i < blocks; i += 4) {
+        const __mmask8 mask = vaesBlocksMask(std::min<std::size_t>(blocks - i, 4));
+        __m512i block = _mm512_mask_blend_epi32(lastWords, base, _mm512_shuffle_epi8(counters, byteSwap));
+        counters = _mm512_add_epi32(counters, four);
+        block = _mm512_xor_si512(vaesEncrypt(block, keys, rounds), _mm512_maskz_loadu_epi64(mask, input + (i * 16)));
+        _mm512_mask_storeu_epi64(output + (i * 16), mask, block);
+    }
+}
+
+///
+/// Previous cipher blocks of a register are its own blocks shifted
+/// up by one block with last block of previous register coming in,
+/// all the cipher blocks are loaded before storing so output can be
+/// same as input
+///
+MINE_TARGET_VAES
+static void vaesDecryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const uint32_t* inverseRoundKeys, uint8_t rounds)
+{
+    if (blocks == 0) {
+        return;
+    }
+    __m512i keys[15];
+    vaesLoadRoundKeys(inverseRoundKeys, rounds, keys);
+    const __m128i lastCipher = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + ((blocks - 1) * 16)));
+    // only last block of it is used
+    __m512i previous = vaesBroadcast(_mm_loadu_si128(reinterpret_cast<const __m128i*>(iv)));
+    std::size_t i = 0;
+    for (; i + 32 <= blocks; i += 32) {
+        __m512i cipher[8];
+        __m512i b[8];
+        for (int j = 0; j < 8; ++j) {
+            cipher[j] = _mm512_loadu_si512(input + ((i + (4 * j)) * 16));
+            b[j] = cipher[j];
+        }
+        vaesDecrypt8(b, keys, rounds);
+        _mm512_storeu_si512(output + (i * 16), _mm512_xor_si512(b[0], vaesShiftIn(cipher[0], previous)));
+        for (int j = 1; j < 8; ++j) {
+            _mm512_storeu_si512(output + ((i + (4 * j)) * 16), _mm512_xor_si512(b[j], vaesShiftIn(cipher[j], cipher[j - 1])));
+        }
+        previous = cipher[7];
+    }
+    for (; i < blocks; i += 4) {
+        const __mmask8 mask = vaesBlocksMask(std::min<std::size_t>(blocks - i, 4));
+        const __m512i cipher = _mm512_maskz_loadu_epi64(mask, input + (i * 16));
+        const __m512i block = _mm512_xor_si512(vaesDecrypt(cipher, keys, rounds), vaesShiftIn(cipher, previous));
+        _mm512_mask_storeu_epi64(output + (i * 16), mask, block);
+        previous = cipher;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), lastCipher);
+}
+
+#endif // MINE_VAES
+
+AES::AES(const std::string& key)
+{
+    setKey(key);
+}
+
+AES::AES(const ByteArray& key) : m_key(key)
+{
+    setKey(key);
+}
+
+AES::AES(const AES& other)
+{
+    if (&other != this) {
+        m_key = other.m_key;
+        m_rounds = other.m_rounds;
+        m_keySchedule = other.m_keySchedule;
+        m_inverseKeySchedule = other.m_inverseKeySchedule;
+        m_secondKey = other.m_secondKey;
+        m_secondKeySchedule = other.m_secondKeySchedule;
+        std::copy_n(other.m_cmacSubkeys, sizeof(m_cmacSubkeys), m_cmacSubkeys);
+    }
+}
+
+AES::AES(const AES&& other) :
+    m_key(std::move(other.m_key)),
+    m_rounds(other.m_rounds),
+    m_keySchedule(std::move(other.m_keySchedule)),
+    m_inverseKeySchedule(std::move(other.m_inverseKeySchedule)),
+    m_secondKey(std::move(other.m_secondKey)),
+    m_secondKeySchedule(std::move(other.m_secondKeySchedule))
+{
+    std::copy_n(other.m_cmacSubkeys, sizeof(m_cmacSubkeys), m_cmacSubkeys);
+}
+
+AES& AES::operator=(const AES& other)
+{
+    if (&other != this) {
+        m_key = other.m_key;
+        m_rounds = other.m_rounds;
+        m_keySchedule = other.m_keySchedule;
+        m_inverseKeySchedule = other.m_inverseKeySchedule;
+        m_secondKey = other.m_secondKey;
+        m_secondKeySchedule = other.m_secondKeySchedule;
+        std::copy_n(other.m_cmacSubkeys, sizeof(m_cmacSubkeys), m_cmacSubkeys);
+    }
+    return *this;
+}
+
+void AES::setKey(const std::string& key)
+{
+    setKey(Base16::fromString(key));
+}
+
+void AES::setKey(const ByteArray& key)
+{
+    if (key.size() != 16 && key.size() != 24 && key.size() != 32) {
+        throw std::invalid_argument("Invalid key size. AES can operate on 128-bit, 192-bit and 256-bit keys");
+    }
+    m_key = key;
+    m_rounds = roundsForKey(m_key.size());
+    expandKey(&m_key, &m_keySchedule, &m_inverseKeySchedule);
+    cmacSubkeys(&m_keySchedule, m_rounds, m_cmacSubkeys);
+}
+
+void AES::setSecondKey(const Key& secondKey)
+{
+    KeySchedule inverseKeySchedule;
+    expandKey(&secondKey, &m_secondKeySchedule, &inverseKeySchedule);
+    m_secondKey = secondKey;
+}
+
+const AES::KeySchedule* AES::secondKeySchedule(const Key* secondKey, KeySchedule* other) const
+{
+    if (*secondKey == m_secondKey) {
+        return &m_secondKeySchedule;
+    }
+    KeySchedule inverseKeySchedule;
+    expandKey(secondKey, other, &inverseKeySchedule);
+    return other;
+}
+
+void AES::expandKey(const Key* key, KeySchedule* keySchedule, KeySchedule* inverseKeySchedule)
+{
+    if (s_keyScheduleCacheCapacity.load(std::memory_order_relaxed) == 0) {
+        *keySchedule = keyExpansion(key);
+        if (inverseKeySchedule != nullptr) {
+            toInverseKeySchedule(keySchedule, roundsForKey(key->size()), inverseKeySchedule);
+        }
+        return;
+    }
+
+    // cache keeps both schedules
+    KeySchedule unusedInverseKeySchedule;
+    if (inverseKeySchedule == nullptr) {
+        inverseKeySchedule = &unusedInverseKeySchedule;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_keyScheduleCacheMutex);
+        auto found = s_keyScheduleCacheIndex.find(*key);
+        if (found != s_keyScheduleCacheIndex.end()) {
+            ++s_keyScheduleCacheHits;
+            s_keyScheduleCache.splice(s_keyScheduleCache.begin(), s_keyScheduleCache, found->second);
+            *keySchedule = found->second->keySchedule;
+            *inverseKeySchedule = found->second->inverseKeySchedule;
+            return;
+        }
+        ++s_keyScheduleCacheMisses;
+    }
+
+    // expand without holding the lock so other keys are not blocked
+    *keySchedule = keyExpansion(key);
+    toInverseKeySchedule(keySchedule, roundsForKey(key->size()), inverseKeySchedule);
+
+    std::lock_guard<std::mutex> lock(s_keyScheduleCacheMutex);
+    const std::size_t capacity = s_keyScheduleCacheCapacity.load(std::memory_order_relaxed);
+    if (capacity == 0 || s_keyScheduleCacheIndex.count(*key) != 0) {
+        // disabled or added by another thread in the meantime
+        return;
+    }
+    s_keyScheduleCache.push_front(CachedKeySchedule { *key, *keySchedule, *inverseKeySchedule });
+    s_keyScheduleCacheIndex[*key] = s_keyScheduleCache.begin();
+    while (s_keyScheduleCache.size() > capacity) {
+        s_keyScheduleCacheIndex.erase(s_keyScheduleCache.back().key);
+        s_keyScheduleCache.pop_back();
+    }
+}
+
+void AES::printBytes(const ByteArray& b)
+{
+    for (std::size_t i = 1; i <= b.size(); ++i) {
+        std::cout << "0x" << (b[i - 1] < 10 ? "0" : "") << Base16::encode(b[i - 1]) << "  ";
+        if (i % 4 == 0) {
+            std::cout << std::endl;
+        }
+    }
+    std::cout << std::endl << "------" << std::endl;
+}
+
+void AES::printState(const State* state)
+{
+    for (std::size_t i = 0; i < kNb; ++i) {
+        for (std::size_t j = 0; j < kNb; ++j) {
+            byte b = (*state)[j][i];
+            std::cout << "0x" << (b < 10 ? "0" : "") << Base16::encode(b) << "  ";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void AES::rotateWord(uint32_t* w) {
+    *w = (*w << 8) | (*w >> 24);
+}
+
+void AES::substituteWord(uint32_t* w) {
+    *w = (static_cast<uint32_t>(kSBox[*w >> 24]) << 24) |
+            (static_cast<uint32_t>(kSBox[(*w >> 16) & 0xff]) << 16) |
+            (static_cast<uint32_t>(kSBox[(*w >> 8) & 0xff]) << 8) |
+            (static_cast<uint32_t>(kSBox[*w & 0xff]));
+}
+
+AES::KeySchedule AES::keyExpansion(const Key* key)
+{
+
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+
+    std::size_t keySize = key->size();
+
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    uint8_t Nk = static_cast<uint8_t>(keySize / 4),
+            Nr = roundsForKey(keySize);
+
+    KeySchedule words = {};
+
+#if MINE_AES_NI
+    if (aesNiEngine()) {
+        aesNiKeyExpansion(key->data(), Nk, Nr, kRoundConstant, words.data());
+        return words;
+    }
+#endif
+
+    // no table lookups by key with constant-time engine
+    const bool constantTime = engine() == Engine::Bitsliced;
+
+    uint8_t i = 0;
+    // copy main key as is for the first round
+    for (; i < Nk; ++i) {
+        words[i] = loadWord(key->data() + (i * 4));
+    }
+
+    for (; i < kNb * (Nr + 1); ++i) {
+        uint32_t temp = words[i - 1];
+
+        if (i % Nk == 0) {
+            rotateWord(&temp);
+            if (constantTime) {
+                temp = bitslicedSubWord(temp);
+            } else {
+                substituteWord(&temp);
+            }
+            // xor with rcon
+            temp ^= static_cast<uint32_t>(kRoundConstant[(i / Nk) - 1]) << 24;
+        } else if (Nk == 8 && i % Nk == 4) {
+            // See note for 256-bit keys on Sec. 5.2 on FIPS.197
+            if (constantTime) {
+                temp = bitslicedSubWord(temp);
+            } else {
+                substituteWord(&temp);
+            }
+        }
+
+        // xor previous column of new key with corresponding column of
+        // previous round key
+        words[i] = words[i - Nk] ^ temp;
+    }
+
+#if MINE_PROFILING
+    endProfiling(started, "keyExpansion");
+#endif
+
+    return words;
+}
+
+///
+/// Adding round key is simply a xor operation on
+/// corresponding key for the round
+/// which is generated during key expansion
+///
+/// Let's say we have state and a key
+///
+/// [ df  c3  e2  9c ]         [ ef  d4  49  11 ]
+/// | 0f  ad  1f  ca |         | 1f  ad  ac  fa |
+/// | 0c  9d  8d  fa |    ^    | cc  9e  15  dd |
+/// [ fe  ef  cc  b2 ]         [ fe  ea  02  dc ]
+///
+///
+/// [ df^ef   c3^d4   e2^49   9c^11 ]
+/// | 0f^1f   ad^ad   1f^ac   ca^fa |
+/// | 0c^cc   9d^9e   8d^15   fa^dd |
+/// [ fe^fe   ef^ea   cc^02   b2^dc ]
+///
+void AES::addRoundKey(State* state, const KeySchedule* keySchedule, int round)
+{
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    const int iR = (round * kNb);
+    for (std::size_t i = 0; i < kNb; ++i) {
+        std::size_t iR2 = iR + i;
+        for (std::size_t j = 0; j < kNb; ++j) {
+#if MINE_PROFILING
+    auto started2 = std::chrono::steady_clock::now();
+    std::cout << ((*state)[i][j] & 0xff) << " ^= " << (((*keySchedule)[iR2] >> (24 - (j * 8))) & 0xff);
+#endif
+            (*state)[i][j] ^= static_cast<byte>((*keySchedule)[iR2] >> (24 - (j * 8)));
+#if MINE_PROFILING
+    std::cout << " = " << ((*state)[i][j] & 0xff) << std::endl;
+    endProfiling(started2, "add single round");
+#endif
+        }
+    }
+#if MINE_PROFILING
+    endProfiling(started, "addRoundKey");
+#endif
+}
+
+///
+/// Simple substition for the byte
+/// from sbox - i.e, for 0x04 we will replace with the
+/// byte at index 0x04 => 0xf2
+///
+void AES::subBytes(State* state)
+{
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    for (std::size_t i = 0; i < kNb; ++i) {
+        for (std::size_t j = 0; j < kNb; ++j) {
+            (*state)[i][j] = kSBox[(*state)[i][j]];
+        }
+    }
+
+#if MINE_PROFILING
+    endProfiling(started, "subBytes");
+#endif
+}
+
+///
+/// A simple substition of bytes using kSBoxInverse
+///
+void AES::invSubBytes(State* state)
+{
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    for (std::size_t i = 0; i < kNb; ++i) {
+        for (std::size_t j = 0; j < kNb; ++j) {
+            (*state)[i][j] = kSBoxInverse[(*state)[i][j]];
+        }
+    }
+#if MINE_PROFILING
+    endProfiling(started, "invSubBytes");
+#endif
+}
+
+///
+/// Shifting rows is beautifully explained by diagram
+/// that helped in implementation as well
+///
+/// Let's say we have state
+///
+/// [ df  c3  e2  9c ]
+/// | 0f  ad  1f  ca |
+/// | 0c  9d  8d  fa |
+/// [ fe  ef  cc  b2 ]
+///
+/// shifting means
+///
+///              [ df  c3  e2  9c ]
+///           0f | ad  1f  ca |
+///       0c  9d | 8d  fa |
+///   fe  ef  cc [ b2 ]
+///
+/// and filling the spaces with shifted rows
+///
+/// [ df  c3  e2  9c ]
+/// | ad  1f  ca  0f |
+/// | 8d  fa  0c  9d |
+/// [ b2  fe  ef  cc ]
+///
+void AES::shiftRows(State *state)
+{
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    // row 1
+    std::swap((*state)[0][1], (*state)[3][1]);
+    std::swap((*state)[0][1], (*state)[1][1]);
+    std::swap((*state)[1][1], (*state)[2][1]);
+
+    // row 2
+    std::swap((*state)[0][2], (*state)[2][2]);
+    std::swap((*state)[1][2], (*state)[3][2]);
+
+    // row 3
+    std::swap((*state)[0][3], (*state)[1][3]);
+    std::swap((*state)[2][3], (*state)[3][3]);
+    std::swap((*state)[0][3], (*state)[2][3]);
+
+#if MINE_PROFILING
+    endProfiling(started, "shiftRows");
+#endif
+}
+
+///
+/// This is reverse of shift rows operation
+///
+/// Let's say we have state
+///
+/// [ df  c3  e2  9c ]
+/// | ad  1f  ca  0f |
+/// | 8d  fa  0c  9d |
+/// [ b2  fe  ef  cc ]
+///
+/// shifting means
+///
+/// [ df  c3  e2  9c  ]
+///      | ad  1f  ca | 0f
+///          | 8d  fa | 0c  9d
+///              [ b2 | fe  ef  cc
+///
+/// and filling the spaces with shifted rows
+///
+/// [ df  c3  e2  9c ]
+/// | 0f  ad  1f  ca |
+/// | 0c  9d  8d  fa |
+/// [ fe  ef  cc  b2 ]
+///
+void AES::invShiftRows(State *state)
+{
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    // row 1
+    std::swap((*state)[0][1], (*state)[1][1]);
+    std::swap((*state)[0][1], (*state)[2][1]);
+    std::swap((*state)[0][1], (*state)[3][1]);
+
+    // row 2
+    std::swap((*state)[0][2], (*state)[2][2]);
+    std::swap((*state)[1][2], (*state)[3][2]);
+
+    // row 3
+    std::swap((*state)[0][3], (*state)[3][3]);
+    std::swap((*state)[0][3], (*state)[2][3]);
+    std::swap((*state)[0][3], (*state)[1][3]);
+#if MINE_PROFILING
+    endProfiling(started, "intShiftRows");
+#endif
+}
+
+///
+/// Finds the product of {02} and the argument to
+/// xtime modulo {1b}
+///
+byte AES::xtime(byte x)
+{
+    return ((x << 1) ^ (((x >> 7) & 1) * 0x11b));
+}
+
+///
+/// Multiplies numbers in the GF(2^8) field
+///
+byte AES::multiply(byte x, byte y)
+{
+    return (((y & 0x01) * x) ^
+            ((y >> 1 & 0x01) * xtime(x)) ^
+            ((y >> 2 & 0x01) * xtime(xtime(x))) ^
+            ((y >> 3 & 0x01) * xtime(xtime(xtime(x)))) ^
+            ((y >> 4 & 0x01) * xtime(xtime(xtime(xtime(x))))));
+}
+
+///
+/// multiplies in GF(2^8) field selected column from state
+/// with constant matrix defined by publication
+///
+/// [ 02  03  01  01 ]
+/// | 01  02  03  01 |
+/// | 01  01  02  03 |
+/// [ 03  01  01  02 ]
+///
+void AES::mixColumns(State* state)
+{
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    for (int col = 0; col < 4; ++col) {
+        Word column = (*state)[col];
+        // let's take example from publication, col: [212, 191, 93, 48]
+        // t == 6
+        byte t = column[0] ^ column[1] ^ column[2] ^ column[3];
+        // see Sec. 4.2.1 and Sec. 5.1.3 for more details
+        (*state)[col][0] ^= xtime(column[0] ^ column[1]) ^ t;
+        (*state)[col][1] ^= xtime(column[1] ^ column[2]) ^ t;
+        (*state)[col][2] ^= xtime(column[2] ^ column[3]) ^ t;
+        (*state)[col][3] ^= xtime(column[3] ^ column[0]) ^ t;
+    }
+#if MINE_PROFILING
+    endProfiling(started, "mixColumns");
+#endif
+}
+
+///
+/// Inverse multiplication with inverse matrix defined on Sec. 5.3.3
+///
+/// [ 0e  0b  0d  09 ]
+/// | 09  0e  0b  0d |
+/// | 0d  09  0e  0b |
+/// [ 0b  0d  09  0e ]
+///
+void AES::invMixColumns(State* state)
+{
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    for (int col = 0; col < 4; ++col) {
+        Word column = (*state)[col];
+        // see Sec. 4.2.1 and Sec. 5.3.3 for more details
+        (*state)[col][0] = multiply(column[0], 0x0e) ^ multiply(column[1], 0x0b) ^ multiply(column[2], 0x0d) ^ multiply(column[3], 0x09);
+        (*state)[col][1] = multiply(column[0], 0x09) ^ multiply(column[1], 0x0e) ^ multiply(column[2], 0x0b) ^ multiply(column[3], 0x0d);
+        (*state)[col][2] = multiply(column[0], 0x0d) ^ multiply(column[1], 0x09) ^ multiply(column[2], 0x0e) ^ multiply(column[3], 0x0b);
+        (*state)[col][3] = multiply(column[0], 0x0b) ^ multiply(column[1], 0x0d) ^ multiply(column[2], 0x09) ^ multiply(column[3], 0x0e);
+    }
+#if MINE_PROFILING
+    endProfiling(started, "invMixColumns");
+#endif
+}
+
+void AES::initState(State* state, const ByteArray::const_iterator& begin)
+{
+    // Pad the input if needed
+    // 29/08 removed this check because it's not needed as
+    // this function is only called from private interface
+    // this removal helped made input pass by ref
+    /*if (input.size() < kBlockSize) {
+        std::fill_n(input.end(), kBlockSize - input.size(), 0);
+    }*/
+
+    // assign it to state for processing
+    for (std::size_t i = 0; i < kNb; ++i) {
+        for (std::size_t j = 0; j < kNb; ++j) {
+            (*state)[i][j] = begin[(kNb * i) + j];
+        }
+    }
+}
+
+ByteArray AES::stateToByteArray(const State *state)
+{
+
+#if MINE_PROFILING
+    auto started = std::chrono::steady_clock::now();
+#endif
+    ByteArray result(kBlockSize);
+    int k = 0;
+    for (std::size_t i = 0; i < kNb; ++i) {
+        for (std::size_t j = 0; j < kNb; ++j) {
+            result[k++] = (*state)[i][j];
+        }
+    }
+#if MINE_PROFILING
+    endProfiling(started, "stateToByteArray");
+#endif
+
+    return result;
+}
+
+void AES::xorBlock(byte* block, const byte* with)
+{
+    for (std::size_t i = 0; i < kBlockSize; ++i) {
+        block[i] ^= with[i];
+    }
+}
+
+void AES::padBlock(const byte* input, std::size_t length, byte* block, bool pkcs5Padding)
+{
+    std::copy_n(input, length, block);
+    // PKCS#5 padding
+    std::fill(block + length, block + kBlockSize, pkcs5Padding ? static_cast<byte>(kBlockSize - length) : 0);
+}
+
+void AES::toInverseKeySchedule(const KeySchedule* keySchedule, uint8_t rounds, KeySchedule* inverseKeySchedule)
+{
+    inverseKeySchedule->fill(0);
+    // reverse the order of round keys
+    for (std::size_t round = 0; round <= rounds; ++round) {
+        for (std::size_t i = 0; i < kNb; ++i) {
+            (*inverseKeySchedule)[round * kNb + i] = (*keySchedule)[(rounds - round) * kNb + i];
+        }
+    }
+    // apply InvMixColumns() to all but first and last round key,
+    // this is done with arithmetic (no lookups by key) on all four
+    // bytes of the word at once
+    for (std::size_t i = kNb; i < kNb * rounds; ++i) {
+        const uint32_t w = (*inverseKeySchedule)[i];
+        const uint32_t w2 = ((w & 0x7f7f7f7f) << 1) ^ (((w >> 7) & 0x01010101) * 0x1b);
+        const uint32_t w4 = ((w2 & 0x7f7f7f7f) << 1) ^ (((w2 >> 7) & 0x01010101) * 0x1b);
+        const uint32_t w8 = ((w4 & 0x7f7f7f7f) << 1) ^ (((w4 >> 7) & 0x01010101) * 0x1b);
+        const uint32_t w9 = w8 ^ w;
+        const uint32_t w11 = w8 ^ w2 ^ w;
+        const uint32_t w13 = w8 ^ w4 ^ w;
+        const uint32_t w14 = w8 ^ w4 ^ w2;
+        // row r of the column is 0e * a[r] ^ 0b * a[r + 1] ^ 0d * a[r + 2] ^ 09 * a[r + 3]
+        (*inverseKeySchedule)[i] = w14 ^
+                ((w11 << 8) | (w11 >> 24)) ^
+                ((w13 << 16) | (w13 >> 16)) ^
+                ((w9 << 24) | (w9 >> 8));
+    }
+}
+
+template <unsigned int KeyBits>
+const uint8_t AESCipher<KeyBits>::kKeyWords;
+
+template <unsigned int KeyBits>
+const uint8_t AESCipher<KeyBits>::kRounds;
+
+template <unsigned int KeyBits>
+const uint8_t AESCipher<KeyBits>::kScheduleWords;
+
+///
+/// Each output column of a round is four table lookups, one for each
+/// row, where row r is taken from column (c + r) mod 4 of the input
+/// state (that is ShiftRows()) and kTe tables do SubBytes() and
+/// MixColumns() for the byte.
+///
+/// Next round is instantiated until the overload for kRounds (does nothing)
+/// is picked so the compiler sees all the rounds as straight code
+///
+template <unsigned int KeyBits>
+template <int Round>
+MINE_ALWAYS_INLINE void AESCipher<KeyBits>::encryptRounds(uint32_t* s, const uint32_t* roundKeys, std::integral_constant<int, Round>)
+{
+    const uint32_t* rk = roundKeys + (Round * AES::kNb);
+    const uint32_t t0 = AES::kTe0[s[0] >> 24] ^ AES::kTe1[(s[1] >> 16) & 0xff] ^ AES::kTe2[(s[2] >> 8) & 0xff] ^ AES::kTe3[s[3] & 0xff] ^ rk[0];
+    const uint32_t t1 = AES::kTe0[s[1] >> 24] ^ AES::kTe1[(s[2] >> 16) & 0xff] ^ AES::kTe2[(s[3] >> 8) & 0xff] ^ AES::kTe3[s[0] & 0xff] ^ rk[1];
+    const uint32_t t2 = AES::kTe0[s[2] >> 24] ^ AES::kTe1[(s[3] >> 16) & 0xff] ^ AES::kTe2[(s[0] >> 8) & 0xff] ^ AES::kTe3[s[1] & 0xff] ^ rk[2];
+    const uint32_t t3 = AES::kTe0[s[3] >> 24] ^ AES::kTe1[(s[0] >> 16) & 0xff] ^ AES::kTe2[(s[1] >> 8) & 0xff] ^ AES::kTe3[s[2] & 0xff] ^ rk[3];
+    s[0] = t0;
+    s[1] = t1;
+    s[2] = t2;
+    s[3] = t3;
+    encryptRounds(s, roundKeys, std::integral_constant<int, Round + 1>());
+}
+
+///
+/// Same as encryptRounds() except the row r is taken from
+/// column (c - r) mod 4 (that is InvShiftRows())
+///
+template <unsigned int KeyBits>
+template <int Round>
+MINE_ALWAYS_INLINE void AESCipher<KeyBits>::decryptRounds(uint32_t* s, const uint32_t* inverseRoundKeys, std::integral_constant<int, Round>)
+{
+    const uint32_t* rk = inverseRoundKeys + (Round * AES::kNb);
+    const uint32_t t0 = AES::kTd0[s[0] >> 24] ^ AES::kTd1[(s[3] >> 16) & 0xff] ^ AES::kTd2[(s[2] >> 8) & 0xff] ^ AES::kTd3[s[1] & 0xff] ^ rk[0];
+    const uint32_t t1 = AES::kTd0[s[1] >> 24] ^ AES::kTd1[(s[0] >> 16) & 0xff] ^ AES::kTd2[(s[3] >> 8) & 0xff] ^ AES::kTd3[s[2] & 0xff] ^ rk[1];
+    const uint32_t t2 = AES::kTd0[s[2] >> 24] ^ AES::kTd1[(s[1] >> 16) & 0xff] ^ AES::kTd2[(s[0] >> 8) & 0xff] ^ AES::kTd3[s[3] & 0xff] ^ rk[2];
+    const uint32_t t3 = AES::kTd0[s[3] >> 24] ^ AES::kTd1[(s[2] >> 16) & 0xff] ^ AES::kTd2[(s[1] >> 8) & 0xff] ^ AES::kTd3[s[0] & 0xff] ^ rk[3];
+    s[0] = t0;
+    s[1] = t1;
+    s[2] = t2;
+    s[3] = t3;
+    decryptRounds(s, inverseRoundKeys, std::integral_constant<int, Round + 1>());
+}
+
+template <unsigned int KeyBits>
+void AESCipher<KeyBits>::encryptBlock(const byte* input, byte* output, const uint32_t* roundKeys)
+{
+    // initial round
+    uint32_t s[AES::kNb] = {
+        loadWord(input) ^ roundKeys[0],
+        loadWord(input + 4) ^ roundKeys[1],
+        loadWord(input + 8) ^ roundKeys[2],
+        loadWord(input + 12) ^ roundKeys[3]
+    };
+
+    // intermediate rounds
+    encryptRounds(s, roundKeys, std::integral_constant<int, 1>());
+
+    // final round (no MixColumns())
+    const uint32_t* rk = roundKeys + (kRounds * AES::kNb);
+    const byte* sBox = AES::kSBox;
+    const uint32_t t0 = (static_cast<uint32_t>(sBox[s[0] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBox[(s[1] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBox[(s[2] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBox[s[3] & 0xff])) ^ rk[0];
+    const uint32_t t1 = (static_cast<uint32_t>(sBox[s[1] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBox[(s[2] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBox[(s[3] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBox[s[0] & 0xff])) ^ rk[1];
+    const uint32_t t2 = (static_cast<uint32_t>(sBox[s[2] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBox[(s[3] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBox[(s[0] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBox[s[1] & 0xff])) ^ rk[2];
+    const uint32_t t3 = (static_cast<uint32_t>(sBox[s[3] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBox[(s[0] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBox[(s[1] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBox[s[2] & 0xff])) ^ rk[3];
+
+    storeWord(t0, output);
+    storeWord(t1, output + 4);
+    storeWord(t2, output + 8);
+    storeWord(t3, output + 12);
+}
+
+template <unsigned int KeyBits>
+void AESCipher<KeyBits>::decryptBlock(const byte* input, byte* output, const uint32_t* inverseRoundKeys)
+{
+    // initial round
+    uint32_t s[AES::kNb] = {
+        loadWord(input) ^ inverseRoundKeys[0],
+        loadWord(input + 4) ^ inverseRoundKeys[1],
+        loadWord(input + 8) ^ inverseRoundKeys[2],
+        loadWord(input + 12) ^ inverseRoundKeys[3]
+    };
+
+    // intermediate rounds
+    decryptRounds(s, inverseRoundKeys, std::integral_constant<int, 1>());
+
+    // final round (no InvMixColumns())
+    const uint32_t* rk = inverseRoundKeys + (kRounds * AES::kNb);
+    const byte* sBoxInverse = AES::kSBoxInverse;
+    const uint32_t t0 = (static_cast<uint32_t>(sBoxInverse[s[0] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[3] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[2] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBoxInverse[s[1] & 0xff])) ^ rk[0];
+    const uint32_t t1 = (static_cast<uint32_t>(sBoxInverse[s[1] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[0] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[3] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBoxInverse[s[2] & 0xff])) ^ rk[1];
+    const uint32_t t2 = (static_cast<uint32_t>(sBoxInverse[s[2] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[1] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[0] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBoxInverse[s[3] & 0xff])) ^ rk[2];
+    const uint32_t t3 = (static_cast<uint32_t>(sBoxInverse[s[3] >> 24]) << 24) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[2] >> 16) & 0xff]) << 16) ^
+            (static_cast<uint32_t>(sBoxInverse[(s[1] >> 8) & 0xff]) << 8) ^
+            (static_cast<uint32_t>(sBoxInverse[s[0] & 0xff])) ^ rk[3];
+
+    storeWord(t0, output);
+    storeWord(t1, output + 4);
+    storeWord(t2, output + 8);
+    storeWord(t3, output + 12);
+}
+
+template <unsigned int KeyBits>
+void AESCipher<KeyBits>::encryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* roundKeys)
+{
+    for (std::size_t i = 0; i < blocks; ++i) {
+        encryptBlock(input + (i * AES::kBlockSize), output + (i * AES::kBlockSize), roundKeys);
+    }
+}
+
+template <unsigned int KeyBits>
+void AESCipher<KeyBits>::decryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* inverseRoundKeys)
+{
+    for (std::size_t i = 0; i < blocks; ++i) {
+        decryptBlock(input + (i * AES::kBlockSize), output + (i * AES::kBlockSize), inverseRoundKeys);
+    }
+}
+
+template <unsigned int KeyBits>
+void AESCipher<KeyBits>::encryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const uint32_t* roundKeys)
+{
+    for (std::size_t i = 0; i < blocks; ++i) {
+        byte* block = output + (i * AES::kBlockSize);
+        std::copy_n(input + (i * AES::kBlockSize), AES::kBlockSize, block);
+        AES::xorBlock(block, iv);
+        encryptBlock(block, block, roundKeys);
+        std::copy_n(block, AES::kBlockSize, iv);
+    }
+}
+
+template class mine::AESCipher<128>;
+template class mine::AESCipher<192>;
+template class mine::AESCipher<256>;
+
+///
+/// Round count of the key picks AESCipher instance
+///
+void AES::encryptBlock(const byte* input, byte* output, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    switch (rounds) {
+    case AESCipher<128>::kRounds:
+        AESCipher<128>::encryptBlock(input, output, keySchedule->data());
+        break;
+    case AESCipher<192>::kRounds:
+        AESCipher<192>::encryptBlock(input, output, keySchedule->data());
+        break;
+    default:
+        AESCipher<256>::encryptBlock(input, output, keySchedule->data());
+    }
+}
+
+void AES::decryptBlock(const byte* input, byte* output, const KeySchedule* inverseKeySchedule, uint8_t rounds)
+{
+    switch (rounds) {
+    case AESCipher<128>::kRounds:
+        AESCipher<128>::decryptBlock(input, output, inverseKeySchedule->data());
+        break;
+    case AESCipher<192>::kRounds:
+        AESCipher<192>::decryptBlock(input, output, inverseKeySchedule->data());
+        break;
+    default:
+        AESCipher<256>::decryptBlock(input, output, inverseKeySchedule->data());
+    }
+}
+
+void AES::encryptBlocks(const byte* input, byte* output, std::size_t blocks, const KeySchedule* keySchedule, uint8_t rounds)
+{
+#if MINE_VAES
+    if (engine() == Engine::Vaes) {
+        vaesEncryptBlocks(input, output, blocks, keySchedule->data(), rounds);
+        return;
+    }
+#endif
+#if MINE_AES_NI
+    if (engine() == Engine::AesNi) {
+        aesNiEncryptBlocks(input, output, blocks, keySchedule->data(), rounds);
+        return;
+    }
+#endif
+    if (engine() == Engine::Bitsliced) {
+        bitslicedEncryptBlocks(input, output, blocks, keySchedule->data(), rounds);
+        return;
+    }
+    switch (rounds) {
+    case AESCipher<128>::kRounds:
+        AESCipher<128>::encryptBlocks(input, output, blocks, keySchedule->data());
+        break;
+    case AESCipher<192>::kRounds:
+        AESCipher<192>::encryptBlocks(input, output, blocks, keySchedule->data());
+        break;
+    default:
+        AESCipher<256>::encryptBlocks(input, output, blocks, keySchedule->data());
+    }
+}
+
+void AES::decryptBlocks(const byte* input, byte* output, std::size_t blocks, const KeySchedule* inverseKeySchedule, uint8_t rounds)
+{
+#if MINE_VAES
+    if (engine() == Engine::Vaes) {
+        vaesDecryptBlocks(input, output, blocks, inverseKeySchedule->data(), rounds);
+        return;
+    }
+#endif
+#if MINE_AES_NI
+    if (engine() == Engine::AesNi) {
+        aesNiDecryptBlocks(input, output, blocks, inverseKeySchedule->data(), rounds);
+        return;
+    }
+#endif
+    if (engine() == Engine::Bitsliced) {
+        bitslicedDecryptBlocks(input, output, blocks, inverseKeySchedule->data(), rounds);
+        return;
+    }
+    switch (rounds) {
+    case AESCipher<128>::kRounds:
+        AESCipher<128>::decryptBlocks(input, output, blocks, inverseKeySchedule->data());
+        break;
+    case AESCipher<192>::kRounds:
+        AESCipher<192>::decryptBlocks(input, output, blocks, inverseKeySchedule->data());
+        break;
+    default:
+        AESCipher<256>::decryptBlocks(input, output, blocks, inverseKeySchedule->data());
+    }
+}
+
+void AES::encryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const KeySchedule* keySchedule, uint8_t rounds)
+{
+#if MINE_AES_NI
+    if (aesNiEngine()) {
+        aesNiEncryptCbcBlocks(input, output, blocks, iv, keySchedule->data(), rounds);
+        return;
+    }
+#endif
+    if (engine() == Engine::Bitsliced) {
+        bitslicedEncryptCbcBlocks(input, output, blocks, iv, keySchedule->data(), rounds);
+        return;
+    }
+    switch (rounds) {
+    case AESCipher<128>::kRounds:
+        AESCipher<128>::encryptCbcBlocks(input, output, blocks, iv, keySchedule->data());
+        break;
+    case AESCipher<192>::kRounds:
+        AESCipher<192>::encryptCbcBlocks(input, output, blocks, iv, keySchedule->data());
+        break;
+    default:
+        AESCipher<256>::encryptCbcBlocks(input, output, blocks, iv, keySchedule->data());
+    }
+}
+
+void AES::encryptCbcLanes(const byte* const* inputs, byte* const* outputs, byte* const* chains, std::size_t lanes, std::size_t blocks, const KeySchedule* keySchedule, uint8_t rounds)
+{
+#if MINE_AES_NI
+    if (aesNiEngine()) {
+        aesNiEncryptCbcLanes(inputs, outputs, chains, lanes, blocks, keySchedule->data(), rounds);
+        return;
+    }
+#endif
+    if (engine() == Engine::Bitsliced) {
+        bitslicedEncryptCbcLanes(inputs, outputs, chains, lanes, blocks, keySchedule->data(), rounds);
+        return;
+    }
+    // table lookups of different lanes do not depend on each other anyway
+    for (std::size_t j = 0; j < lanes; ++j) {
+        encryptCbcBlocks(inputs[j], outputs[j], blocks, chains[j], keySchedule, rounds);
+    }
+}
+
+void AES::encryptCbcKeyedLanes(const byte* const* inputs, byte* const* outputs, byte* const* chains, std::size_t lanes, std::size_t blocks, const KeySchedule* const* keySchedules, uint8_t rounds)
+{
+#if MINE_AES_NI
+    if (aesNiEngine()) {
+        const uint32_t* roundKeys[8];
+        for (std::size_t j = 0; j < lanes; ++j) {
+            roundKeys[j] = keySchedules[j]->data();
+        }
+        aesNiEncryptCbcKeyedLanes(inputs, outputs, chains, lanes, blocks, roundKeys, rounds);
+        return;
+    }
+#endif
+    // bitsliced engine ciphers all the blocks of a batch with one key
+    for (std::size_t j = 0; j < lanes; ++j) {
+        encryptCbcBlocks(inputs[j], outputs[j], blocks, chains[j], keySchedules[j], rounds);
+    }
+}
+
+///
+/// Deciphering does not depend on previous block so blocks are
+/// deciphered in batches and then xor'ed with previous cipher block
+///
+void AES::decryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const KeySchedule* inverseKeySchedule, uint8_t rounds)
+{
+#if MINE_VAES
+    if (engine() == Engine::Vaes) {
+        vaesDecryptCbcBlocks(input, output, blocks, iv, inverseKeySchedule->data(), rounds);
+        return;
+    }
+#endif
+#if MINE_AES_NI
+    if (engine() == Engine::AesNi) {
+        aesNiDecryptCbcBlocks(input, output, blocks, iv, inverseKeySchedule->data(), rounds);
+        return;
+    }
+#endif
+    if (engine() == Engine::Bitsliced) {
+        bitslicedDecryptCbcBlocks(input, output, blocks, iv, inverseKeySchedule->data(), rounds);
+        return;
+    }
+    const std::size_t kBatchBlocks = 8;
+    // previous cipher block followed by the batch, as output can be same as input
+    byte cipher[(kBatchBlocks + 1) * kBlockSize];
+    std::copy_n(iv, kBlockSize, cipher);
+    while (blocks > 0) {
+        const std::size_t batch = std::min(blocks, kBatchBlocks);
+        std::copy_n(input, batch * kBlockSize, cipher + kBlockSize);
+        decryptBlocks(input, output, batch, inverseKeySchedule, rounds);
+        for (std::size_t i = 0; i < batch; ++i) {
+            xorBlock(output + (i * kBlockSize), cipher + (i * kBlockSize));
+        }
+        std::copy_n(cipher + (batch * kBlockSize), kBlockSize, cipher);
+        input += batch * kBlockSize;
+        output += batch * kBlockSize;
+        blocks -= batch;
+    }
+    std::copy_n(cipher, kBlockSize, iv);
+}
+
+void AES::incrementCounter(byte* counterBlock, std::size_t counterSize, uint64_t value)
+{
+    uint64_t carry = value;
+    for (std::size_t i = kBlockSize; i > kBlockSize - counterSize && carry != 0; --i) {
+        unsigned int sum = counterBlock[i - 1] + static_cast<unsigned int>(carry & 0xff);
+        counterBlock[i - 1] = static_cast<byte>(sum);
+        carry = (carry >> 8) + (sum >> 8);
+    }
+}
+
+///
+/// Counter blocks are ciphered in batches so engine gets
+/// multiple independent blocks at a time (and bitsliced engine
+/// prepares its round keys once for the batch)
+///
+void AES::ctrBlocks(const byte* input, byte* output, std::size_t blocks, byte* counterBlock, std::size_t counterSize, const KeySchedule* keySchedule, uint8_t rounds)
+{
+#if MINE_AES_NI
+    if (aesNiEngine() && counterSize >= 4) {
+        // blocks until last 32-bit word of counter wraps around,
+        // the rest (if any) is handled below
+        const std::size_t unwrapped = static_cast<std::size_t>(std::min<uint64_t>(blocks, 0x100000000ULL - loadWord(counterBlock + 12)));
+#   if MINE_VAES
+        if (engine() == Engine::Vaes) {
+            vaesCtrBlocks(input, output, unwrapped, counterBlock, keySchedule->data(), rounds);
+        } else {
+            aesNiCtrBlocks(input, output, unwrapped, counterBlock, keySchedule->data(), rounds);
+        }
+#   else
+        aesNiCtrBlocks(input, output, unwrapped, counterBlock, keySchedule->data(), rounds);
+#   endif
+        incrementCounter(counterBlock, counterSize, unwrapped);
+        input += unwrapped * kBlockSize;
+        output += unwrapped * kBlockSize;
+        blocks -= unwrapped;
+    }
+#endif
+    const std::size_t kBatchBlocks = 64;
+    byte keyStream[kBatchBlocks * kBlockSize];
+    while (blocks > 0) {
+        const std::size_t batch = std::min(blocks, kBatchBlocks);
+        for (std::size_t i = 0; i < batch; ++i) {
+            std::copy_n(counterBlock, kBlockSize, keyStream + (i * kBlockSize));
+            incrementCounter(counterBlock, counterSize, 1);
+        }
+        encryptBlocks(keyStream, keyStream, batch, keySchedule, rounds);
+        for (std::size_t i = 0; i < batch * kBlockSize; ++i) {
+            output[i] = input[i] ^ keyStream[i];
+        }
+        input += batch * kBlockSize;
+        output += batch * kBlockSize;
+        blocks -= batch;
+    }
+}
+
+///
+/// With full block segments, key stream of next block is E(P ^ key stream of
+/// this block) which is CBC-Mode encryption of plain text chained to the key
+/// stream, so engine ciphers batches of blocks in its CBC path. Smaller
+/// segments shift cipher text in to the register one segment at a time
+///
+void AES::cfbEncrypt(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t segmentSize, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    byte shiftRegister[kBlockSize];
+    std::copy_n(iv, kBlockSize, shiftRegister);
+
+    if (segmentSize != kBlockSize) {
+        byte keyStream[kBlockSize];
+        while (length > 0) {
+            const std::size_t segment = std::min(length, segmentSize);
+            encryptBlocks(shiftRegister, keyStream, 1, keySchedule, rounds);
+            for (std::size_t i = 0; i < segment; ++i) {
+                output[i] = input[i] ^ keyStream[i];
+            }
+            std::copy(shiftRegister + segmentSize, shiftRegister + kBlockSize, shiftRegister);
+            std::copy_n(output, segment, shiftRegister + kBlockSize - segmentSize);
+            input += segment;
+            output += segment;
+            length -= segment;
+        }
+        return;
+    }
+
+    const std::size_t kBatchBlocks = 64;
+    // key stream of current block followed by key stream of the batch
+    byte keyStream[(kBatchBlocks + 1) * kBlockSize];
+    encryptBlocks(shiftRegister, shiftRegister, 1, keySchedule, rounds);
+    while (length > 0) {
+        const std::size_t batchLength = std::min(length, kBatchBlocks * kBlockSize);
+        const std::size_t blocks = (batchLength + kBlockSize - 1) / kBlockSize;
+        // key stream after last block is only needed if there is more input
+        const std::size_t nextBlocks = batchLength < length ? blocks : blocks - 1;
+        std::copy_n(shiftRegister, kBlockSize, keyStream);
+        if (nextBlocks > 0) {
+            encryptCbcBlocks(input, keyStream + kBlockSize, nextBlocks, shiftRegister, keySchedule, rounds);
+        }
+        for (std::size_t i = 0; i < batchLength; ++i) {
+            output[i] = input[i] ^ keyStream[i];
+        }
+        input += batchLength;
+        output += batchLength;
+        length -= batchLength;
+    }
+}
+
+///
+/// Shift register for each segment is the 128-bit of (IV || cipher text)
+/// right before it, so segments are independent and they are ciphered
+/// in batches
+///
+void AES::cfbDecrypt(const byte* input, std::size_t length, byte* output, const byte* history, std::size_t segmentSize, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    const std::size_t kBatchSegments = 64;
+    // last 128-bit of previous cipher text followed by the batch, as output can be same as input
+    byte cipher[(kBatchSegments + 1) * kBlockSize];
+    byte keyStream[kBatchSegments * kBlockSize];
+    std::copy_n(history, kBlockSize, cipher);
+    while (length > 0) {
+        const std::size_t batchLength = std::min(length, kBatchSegments * segmentSize);
+        const std::size_t segments = (batchLength + segmentSize - 1) / segmentSize;
+        std::copy_n(input, batchLength, cipher + kBlockSize);
+        if (segmentSize == kBlockSize) {
+            encryptBlocks(cipher, keyStream, segments, keySchedule, rounds);
+        } else {
+            for (std::size_t i = 0; i < segments; ++i) {
+                std::copy_n(cipher + (i * segmentSize), kBlockSize, keyStream + (i * kBlockSize));
+            }
+            encryptBlocks(keyStream, keyStream, segments, keySchedule, rounds);
+        }
+        for (std::size_t i = 0; i < segments; ++i) {
+            const std::size_t offset = i * segmentSize;
+            const std::size_t segment = std::min(segmentSize, batchLength - offset);
+            for (std::size_t j = 0; j < segment; ++j) {
+                output[offset + j] = cipher[kBlockSize + offset + j] ^ keyStream[(i * kBlockSize) + j];
+            }
+        }
+        std::copy_n(cipher + batchLength, kBlockSize, cipher);
+        output += batchLength;
+        input += batchLength;
+        length -= batchLength;
+    }
+}
+
+///
+/// Multiples of H for each 4-bit value i are xor of H * x^j for each
+/// bit j set in i, where bit 3 of i is x^0 as GCM bits are reflected
+///
+void AES::initGHashKey(const byte* h, GHashKey* ghashKey)
+{
+    uint64_t (*table)[2] = ghashKey->table;
+    table[0][0] = 0;
+    table[0][1] = 0;
+    table[8][0] = loadDoubleWord(h);
+    table[8][1] = loadDoubleWord(h + 8);
+    for (std::size_t i = 4; i > 0; i >>= 1) {
+        // multiply by x
+        const uint64_t reduction = (table[i * 2][1] & 1) ? 0xe100000000000000ULL : 0;
+        table[i][1] = (table[i * 2][0] << 63) | (table[i * 2][1] >> 1);
+        table[i][0] = (table[i * 2][0] >> 1) ^ reduction;
+    }
+    for (std::size_t i = 2; i < 16; i <<= 1) {
+        for (std::size_t j = 1; j < i; ++j) {
+            table[i + j][0] = table[i][0] ^ table[j][0];
+            table[i + j][1] = table[i][1] ^ table[j][1];
+        }
+    }
+
+    static const bool kCarrylessMultiply = cpuSupportsCarrylessMultiply();
+    ghashKey->carryless = kCarrylessMultiply && aesNiEngine();
+    ghashKey->constantTime = engine() == Engine::Bitsliced;
+#if MINE_AES_NI
+    if (ghashKey->carryless) {
+        pclmulGHashPowers(h, ghashKey->powers);
+    }
+#endif
+}
+
+void AES::ghash(byte* y, const GHashKey* ghashKey, const byte* data, std::size_t length)
+{
+    const std::size_t blocks = length / kBlockSize;
+#if MINE_AES_NI
+    if (ghashKey->carryless) {
+        pclmulGHash(y, ghashKey->powers, data, blocks);
+    } else
+#endif
+    {
+        for (std::size_t i = 0; i < blocks; ++i) {
+            xorBlock(y, data + (i * kBlockSize));
+            if (ghashKey->constantTime) {
+                gf128MultiplyConstantTime(y, ghashKey->table[8]);
+            } else {
+                gf128Multiply(y, ghashKey->table);
+            }
+        }
+    }
+
+    const std::size_t remaining = length % kBlockSize;
+    if (remaining != 0) {
+        byte lastBlock[kBlockSize];
+        padBlock(data + (blocks * kBlockSize), remaining, lastBlock, false);
+        ghash(y, ghashKey, lastBlock, kBlockSize);
+    }
+}
+
+void AES::gcm(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t ivSize, const byte* aad, std::size_t aadSize, byte* tag, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    // H = CIPH(0^128)
+    byte h[kBlockSize] = {};
+    encryptBlocks(h, h, 1, keySchedule, rounds);
+    GHashKey ghashKey;
+    initGHashKey(h, &ghashKey);
+
+    byte lengths[kBlockSize];
+
+    // pre-counter block J0
+    byte counter[kBlockSize] = {};
+    if (ivSize == 12) {
+        std::copy_n(iv, ivSize, counter);
+        counter[kBlockSize - 1] = 1;
+    } else {
+        ghash(counter, &ghashKey, iv, ivSize);
+        storeDoubleWord(0, lengths);
+        storeDoubleWord(static_cast<uint64_t>(ivSize) * 8, lengths + 8);
+        ghash(counter, &ghashKey, lengths, kBlockSize);
+    }
+
+    // tag is xor'ed with CIPH(J0)
+    encryptBlocks(counter, tag, 1, keySchedule, rounds);
+    incrementCounter(counter, 4, 1);
+
+    byte y[kBlockSize] = {};
+    ghash(y, &ghashKey, aad, aadSize);
+
+    // cipher text is hashed in chunks right before or after GCTR
+    const std::size_t kChunkSize = 64 * kBlockSize;
+    for (std::size_t offset = 0; offset < length; offset += kChunkSize) {
+        const std::size_t size = std::min(length - offset, kChunkSize);
+        const std::size_t fullBlocksSize = size - (size % kBlockSize);
+        if (decrypting) {
+            ghash(y, &ghashKey, input + offset, size);
+        }
+        ctrBlocks(input + offset, output + offset, fullBlocksSize / kBlockSize, counter, 4, keySchedule, rounds);
+        if (fullBlocksSize != size) {
+            byte keyStream[kBlockSize];
+            encryptBlocks(counter, keyStream, 1, keySchedule, rounds);
+            for (std::size_t i = fullBlocksSize; i < size; ++i) {
+                output[offset + i] = input[offset + i] ^ keyStream[i - fullBlocksSize];
+            }
+        }
+        if (!decrypting) {
+            ghash(y, &ghashKey, output + offset, size);
+        }
+    }
+
+    storeDoubleWord(static_cast<uint64_t>(aadSize) * 8, lengths);
+    storeDoubleWord(static_cast<uint64_t>(length) * 8, lengths + 8);
+    ghash(y, &ghashKey, lengths, kBlockSize);
+
+    xorBlock(tag, y);
+}
+
+///
+/// Each step ciphers MAC chain block and next counter block together,
+/// key stream runs one block ahead so deciphered block is known before
+/// it's authenticated
+///
+void AES::ccmBlocks(const byte* input, byte* output, std::size_t blocks, byte* mac, byte* counterBlock, std::size_t counterSize, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    if (blocks == 0) {
+        return;
+    }
+#if MINE_AES_NI
+    if (aesNiEngine()) {
+        aesNiCcmBlocks(input, output, blocks, mac, counterBlock, decrypting, keySchedule->data(), rounds);
+        return;
+    }
+#endif
+    // [0] is MAC chain and [1] is key stream
+    byte batch[2 * kBlockSize];
+    encryptBlocks(counterBlock, batch + kBlockSize, 1, keySchedule, rounds);
+    for (std::size_t i = 0; i < blocks; ++i) {
+        const byte* block = input + (i * kBlockSize);
+        byte* result = output + (i * kBlockSize);
+        for (std::size_t j = 0; j < kBlockSize; ++j) {
+            const byte plain = decrypting ? block[j] ^ batch[kBlockSize + j] : block[j];
+            result[j] = block[j] ^ batch[kBlockSize + j];
+            batch[j] = mac[j] ^ plain;
+        }
+        incrementCounter(counterBlock, counterSize, 1);
+        std::copy_n(counterBlock, kBlockSize, batch + kBlockSize);
+        encryptBlocks(batch, batch, 2, keySchedule, rounds);
+        std::copy_n(batch, kBlockSize, mac);
+    }
+}
+
+void AES::ccm(const byte* input, std::size_t length, byte* output, const byte* nonce, std::size_t nonceSize, const byte* aad, std::size_t aadSize, byte* tag, std::size_t tagSize, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    // size of length field in B0 and size of counter in counter blocks
+    const std::size_t q = kBlockSize - 1 - nonceSize;
+
+    // B0 = flags || N || Q
+    byte mac[kBlockSize];
+    mac[0] = static_cast<byte>((aadSize > 0 ? 0x40 : 0) | (((tagSize - 2) / 2) << 3) | (q - 1));
+    std::copy_n(nonce, nonceSize, mac + 1);
+    uint64_t remainingLength = length;
+    for (std::size_t i = kBlockSize - 1; i > nonceSize; --i) {
+        mac[i] = static_cast<byte>(remainingLength & 0xff);
+        remainingLength >>= 8;
+    }
+    encryptBlocks(mac, mac, 1, keySchedule, rounds);
+
+    if (aadSize > 0) {
+        // encoded length of associated data followed by associated data, padded with zeros
+        byte block[kBlockSize] = {};
+        std::size_t used;
+        if (aadSize < 0xff00) {
+            block[0] = static_cast<byte>(aadSize >> 8);
+            block[1] = static_cast<byte>(aadSize);
+            used = 2;
+        } else if (static_cast<uint64_t>(aadSize) <= 0xffffffffULL) {
+            block[0] = 0xff;
+            block[1] = 0xfe;
+            storeWord(static_cast<uint32_t>(aadSize), block + 2);
+            used = 6;
+        } else {
+            block[0] = 0xff;
+            block[1] = 0xff;
+            storeDoubleWord(static_cast<uint64_t>(aadSize), block + 2);
+            used = 10;
+        }
+        const std::size_t first = std::min(aadSize, kBlockSize - used);
+        std::copy_n(aad, first, block + used);
+        xorBlock(mac, block);
+        encryptBlocks(mac, mac, 1, keySchedule, rounds);
+
+        const std::size_t rest = aadSize - first;
+        cmacBlocks(aad + first, rest / kBlockSize, mac, keySchedule, rounds);
+        const std::size_t remaining = rest % kBlockSize;
+        if (remaining != 0) {
+            byte lastBlock[kBlockSize] = {};
+            std::copy_n(aad + first + (rest - remaining), remaining, lastBlock);
+            xorBlock(mac, lastBlock);
+            encryptBlocks(mac, mac, 1, keySchedule, rounds);
+        }
+    }
+
+    // Ctr0 = flags || N || 0, its key stream S0 is for the tag
+    byte counter[kBlockSize] = {};
+    counter[0] = static_cast<byte>(q - 1);
+    std::copy_n(nonce, nonceSize, counter + 1);
+    byte s0[kBlockSize];
+    encryptBlocks(counter, s0, 1, keySchedule, rounds);
+    incrementCounter(counter, q, 1);
+
+    const std::size_t blocks = length / kBlockSize;
+    ccmBlocks(input, output, blocks, mac, counter, q, decrypting, keySchedule, rounds);
+
+    const std::size_t remaining = length % kBlockSize;
+    if (remaining != 0) {
+        const std::size_t offset = blocks * kBlockSize;
+        byte keyStream[kBlockSize];
+        encryptBlocks(counter, keyStream, 1, keySchedule, rounds);
+        byte lastBlock[kBlockSize] = {};
+        for (std::size_t i = 0; i < remaining; ++i) {
+            const byte result = input[offset + i] ^ keyStream[i];
+            lastBlock[i] = decrypting ? result : input[offset + i];
+            output[offset + i] = result;
+        }
+        xorBlock(mac, lastBlock);
+        encryptBlocks(mac, mac, 1, keySchedule, rounds);
+    }
+
+    std::copy_n(mac, kBlockSize, tag);
+    xorBlock(tag, s0);
+}
+
+///
+/// Tweaks for a batch of blocks are computed first so the
+/// blocks are ciphered together by the engine
+///
+void AES::xtsSector(const byte* input, std::size_t length, byte* output, byte* tweak, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    const std::size_t remaining = length % kBlockSize;
+    std::size_t blocks = length / kBlockSize;
+    if (remaining != 0) {
+        // last full block is ciphered with partial block below
+        --blocks;
+    }
+
+    const std::size_t kBatchBlocks = 64;
+    byte tweaks[kBatchBlocks * kBlockSize];
+    while (blocks > 0) {
+        const std::size_t batch = std::min(blocks, kBatchBlocks);
+        for (std::size_t i = 0; i < batch; ++i) {
+            std::copy_n(tweak, kBlockSize, tweaks + (i * kBlockSize));
+            xtsMultiplyAlpha(tweak);
+        }
+        for (std::size_t i = 0; i < batch * kBlockSize; ++i) {
+            output[i] = input[i] ^ tweaks[i];
+        }
+        if (decrypting) {
+            decryptBlocks(output, output, batch, keySchedule, rounds);
+        } else {
+            encryptBlocks(output, output, batch, keySchedule, rounds);
+        }
+        for (std::size_t i = 0; i < batch * kBlockSize; ++i) {
+            output[i] ^= tweaks[i];
+        }
+        input += batch * kBlockSize;
+        output += batch * kBlockSize;
+        blocks -= batch;
+    }
+
+    if (remaining == 0) {
+        return;
+    }
+
+    // ciphertext stealing (IEEE Std 1619-2007 Sec. 5.3.2 and 5.4.2), decryption
+    // uses the tweaks of last two blocks in reverse order
+    byte nextTweak[kBlockSize];
+    std::copy_n(tweak, kBlockSize, nextTweak);
+    xtsMultiplyAlpha(nextTweak);
+    const byte* firstTweak = decrypting ? nextTweak : tweak;
+    const byte* secondTweak = decrypting ? tweak : nextTweak;
+
+    byte block[kBlockSize];
+    std::copy_n(input, kBlockSize, block);
+    xorBlock(block, firstTweak);
+    if (decrypting) {
+        decryptBlocks(block, block, 1, keySchedule, rounds);
+    } else {
+        encryptBlocks(block, block, 1, keySchedule, rounds);
+    }
+    xorBlock(block, firstTweak);
+
+    // partial block takes the head of the block and lends its tail
+    byte lastBlock[kBlockSize];
+    std::copy_n(input + kBlockSize, remaining, lastBlock);
+    std::copy(block + remaining, block + kBlockSize, lastBlock + remaining);
+    std::copy_n(block, remaining, output + kBlockSize);
+
+    xorBlock(lastBlock, secondTweak);
+    if (decrypting) {
+        decryptBlocks(lastBlock, output, 1, keySchedule, rounds);
+    } else {
+        encryptBlocks(lastBlock, output, 1, keySchedule, rounds);
+    }
+    xorBlock(output, secondTweak);
+}
+
+void AES::xts(const byte* input, std::size_t length, byte* output, const Key* tweakKey, uint64_t sector, std::size_t sectorSize, bool decrypting) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (tweakKey->size() != m_key.size()) {
+        throw std::invalid_argument("Invalid XTS tweak key, it should be same size as key");
+    }
+
+    if (*tweakKey == m_key) {
+        throw std::invalid_argument("Invalid XTS tweak key, it should be different from key");
+    }
+
+    if (sectorSize < kBlockSize) {
+        throw std::invalid_argument("Invalid sector size, it should be at least 16 bytes");
+    }
+
+    if (length % sectorSize != 0 && length % sectorSize < kBlockSize) {
+        throw std::invalid_argument("Last sector is too short, it should be at least 16 bytes");
+    }
+
+    // tweak key set by encryptXts() / decryptXts() is already expanded
+    alignas(16) KeySchedule otherTweakKeySchedule;
+    const KeySchedule* tweakKeySchedule = secondKeySchedule(tweakKey, &otherTweakKeySchedule);
+
+    const uint8_t kTotalRounds = m_rounds;
+    const KeySchedule* keySchedule = decrypting ? &m_inverseKeySchedule : &m_keySchedule;
+
+    // sectors are independent, chunks are whole sectors of about chunkBlocks()
+    const std::size_t sectors = (length + sectorSize - 1) / sectorSize;
+    const std::size_t blocks = length / kBlockSize;
+    const std::size_t chunk = chunkBlocks(blocks);
+    const std::size_t chunkSectors = chunk == blocks ? sectors : std::max<std::size_t>(1, (chunk * kBlockSize) / sectorSize);
+
+    parallelBlocks(sectors, chunkSectors, [&](std::size_t firstSector, std::size_t count) {
+        for (std::size_t i = firstSector; i < firstSector + count; ++i) {
+            // 128-bit little-endian sector number is ciphered with tweak key
+            const uint64_t number = sector + i;
+            byte tweak[kBlockSize] = {};
+            for (std::size_t j = 0; j < 8; ++j) {
+                tweak[j] = static_cast<byte>(number >> (j * 8));
+            }
+            tweak[8] = number < sector ? 1 : 0;
+            encryptBlocks(tweak, tweak, 1, tweakKeySchedule, kTotalRounds);
+
+            const std::size_t offset = i * sectorSize;
+            xtsSector(input + offset, std::min(sectorSize, length - offset), output + offset, tweak, decrypting, keySchedule, kTotalRounds);
+        }
+    });
+}
+
+std::size_t AES::s2vLeadingBlocks(std::size_t length)
+{
+    // last 16 bytes are xor'ed with S2V value, they can start in the middle of a block
+    return length < kBlockSize ? 0 : (length - kBlockSize) / kBlockSize;
+}
+
+void AES::s2vFinal(const byte* input, std::size_t length, byte* chain, byte* d, const byte* subkeys, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    if (length < kBlockSize) {
+        // T = dbl(D) xor pad(Sn)
+        cmacDouble(d);
+        byte block[kBlockSize] = {};
+        std::copy_n(input, length, block);
+        block[length] = 0x80;
+        xorBlock(block, d);
+        cmacFinal(block, kBlockSize, chain, subkeys, keySchedule, rounds);
+        return;
+    }
+
+    // T = Sn xorend D, the rest is 16 to 31 bytes
+    const std::size_t size = kBlockSize + ((length - kBlockSize) % kBlockSize);
+    byte rest[2 * kBlockSize];
+    std::copy_n(input + (length - size), size, rest);
+    xorBlock(rest + (size - kBlockSize), d);
+    if (size == kBlockSize) {
+        cmacFinal(rest, kBlockSize, chain, subkeys, keySchedule, rounds);
+    } else {
+        cmacBlocks(rest, 1, chain, keySchedule, rounds);
+        cmacFinal(rest + kBlockSize, size - kBlockSize, chain, subkeys, keySchedule, rounds);
+    }
+}
+
+void AES::sivCtr(const byte* input, std::size_t length, byte* output, const byte* v, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    // Q = V bitand 1^64 || 0^1 || 1^31 || 0^1 || 1^31
+    byte counter[kBlockSize];
+    std::copy_n(v, kBlockSize, counter);
+    counter[8] &= 0x7f;
+    counter[12] &= 0x7f;
+
+    const std::size_t blocks = length / kBlockSize;
+    ctrBlocks(input, output, blocks, counter, kBlockSize, keySchedule, rounds);
+    const std::size_t remaining = length % kBlockSize;
+    if (remaining != 0) {
+        const std::size_t offset = blocks * kBlockSize;
+        byte keyStream[kBlockSize];
+        encryptBlocks(counter, keyStream, 1, keySchedule, rounds);
+        for (std::size_t i = 0; i < remaining; ++i) {
+            output[offset + i] = input[offset + i] ^ keyStream[i];
+        }
+    }
+}
+
+void AES::s2v(const byte* input, std::size_t length, const byte* const* aad, const std::size_t* aadSizes, std::size_t aadCount, byte* v) const
+{
+    const uint8_t kTotalRounds = m_rounds;
+
+    // D = CMAC(K, <zero>)
+    const byte zero[kBlockSize] = {};
+    byte d[kBlockSize] = {};
+    cmacFinal(zero, kBlockSize, d, m_cmacSubkeys, &m_keySchedule, kTotalRounds);
+
+    // D = dbl(D) xor CMAC(K, Si)
+    for (std::size_t i = 0; i < aadCount; ++i) {
+        const std::size_t blocks = aadSizes[i] == 0 ? 0 : (aadSizes[i] - 1) / kBlockSize;
+        byte chain[kBlockSize] = {};
+        cmacBlocks(aad[i], blocks, chain, &m_keySchedule, kTotalRounds);
+        cmacFinal(aad[i] + (blocks * kBlockSize), aadSizes[i] - (blocks * kBlockSize), chain, m_cmacSubkeys, &m_keySchedule, kTotalRounds);
+        cmacDouble(d);
+        xorBlock(d, chain);
+    }
+
+    std::fill_n(v, kBlockSize, 0);
+    cmacBlocks(input, s2vLeadingBlocks(length), v, &m_keySchedule, kTotalRounds);
+    s2vFinal(input, length, v, d, m_cmacSubkeys, &m_keySchedule, kTotalRounds);
+}
+
+///
+/// Input in a lane of AES::sivBatch(), leading blocks of plain text
+/// are authenticated in the lane
+///
+struct SivBatchLane {
+    const AES::Message* message;
+    const byte* input;
+    std::size_t length;
+    std::size_t blocks;
+    byte chain[16];
+};
+
+///
+/// Without associated data D = CMAC(K, <zero>) is same for every input so
+/// it's computed once, leading blocks of all the inputs are authenticated
+/// in lanes like encrCbcBatch() and the rest is finished one by one
+///
+bool AES::sivBatch(const Message* messages, std::size_t count, const Key* ctrKey, bool decrypting, bool* authentic) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (ctrKey->size() != m_key.size()) {
+        throw std::invalid_argument("Invalid SIV CTR key, it should be same size as key");
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (decrypting && messages[i].length < kBlockSize) {
+            throw std::invalid_argument("Input is too short for SIV-Mode, it should be at least 16 bytes");
+        }
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+    alignas(16) KeySchedule otherCtrKeySchedule;
+    const KeySchedule* ctrKeySchedule = secondKeySchedule(ctrKey, &otherCtrKeySchedule);
+
+    const byte zero[kBlockSize] = {};
+    byte d[kBlockSize] = {};
+    cmacFinal(zero, kBlockSize, d, m_cmacSubkeys, &m_keySchedule, kTotalRounds);
+
+    // plain text is needed for S2V
+    if (decrypting) {
+        for (std::size_t i = 0; i < count; ++i) {
+            sivCtr(messages[i].input + kBlockSize, messages[i].length - kBlockSize, messages[i].output, messages[i].input, ctrKeySchedule, kTotalRounds);
+        }
+    }
+
+    bool allAuthentic = true;
+    const std::size_t kLanes = 8;
+    const std::size_t kBatchBlocks = 64;
+    byte scratch[kLanes * kBatchBlocks * kBlockSize];
+
+    // active lanes are kept at the front
+    SivBatchLane lanes[kLanes];
+    std::size_t active = 0;
+    std::size_t next = 0;
+    while (true) {
+        while (active < kLanes && next < count) {
+            const Message& message = messages[next++];
+            SivBatchLane& lane = lanes[active++];
+            lane.message = &message;
+            lane.input = decrypting ? message.output : message.input;
+            lane.length = decrypting ? message.length - kBlockSize : message.length;
+            lane.blocks = s2vLeadingBlocks(lane.length);
+            std::fill_n(lane.chain, kBlockSize, 0);
+        }
+        if (active == 0) {
+            break;
+        }
+
+        // run all the lanes until shortest one is done (or for a batch)
+        const byte* inputs[kLanes];
+        byte* outputs[kLanes];
+        byte* chains[kLanes];
+        std::size_t blocks = kBatchBlocks;
+        for (std::size_t j = 0; j < active; ++j) {
+            inputs[j] = lanes[j].input;
+            outputs[j] = scratch + (j * kBatchBlocks * kBlockSize);
+            chains[j] = lanes[j].chain;
+            blocks = std::min(blocks, lanes[j].blocks);
+        }
+        if (blocks != 0) {
+            encryptCbcLanes(inputs, outputs, chains, active, blocks, &m_keySchedule, kTotalRounds);
+        }
+
+        for (std::size_t j = 0; j < active;) {
+            SivBatchLane& lane = lanes[j];
+            lane.blocks -= blocks;
+            if (lane.blocks != 0) {
+                lane.input += blocks * kBlockSize;
+                ++j;
+                continue;
+            }
+
+            // leading blocks done, finish S2V
+            const Message& message = *lane.message;
+            const byte* plain = decrypting ? message.output : message.input;
+            const std::size_t plainLength = lane.length;
+            byte laneD[kBlockSize];
+            std::copy_n(d, kBlockSize, laneD);
+            s2vFinal(plain, plainLength, lane.chain, laneD, m_cmacSubkeys, &m_keySchedule, kTotalRounds);
+            if (decrypting) {
+                const bool equal = tagsEqual(lane.chain, message.input, kBlockSize);
+                authentic[&message - messages] = equal;
+                if (!equal) {
+                    std::fill_n(message.output, plainLength, 0);
+                    allAuthentic = false;
+                }
+            } else {
+                std::copy_n(lane.chain, kBlockSize, message.output);
+                sivCtr(message.input, message.length, message.output + kBlockSize, lane.chain, ctrKeySchedule, kTotalRounds);
+            }
+
+            // last active lane takes its place
+            lane = lanes[--active];
+        }
+    }
+    return allAuthentic;
+}
+
+void AES::cmacSubkeys(const KeySchedule* keySchedule, uint8_t rounds, byte* subkeys)
+{
+    std::fill_n(subkeys, kBlockSize, 0);
+    encryptBlocks(subkeys, subkeys, 1, keySchedule, rounds);
+    cmacDouble(subkeys);
+    std::copy_n(subkeys, kBlockSize, subkeys + kBlockSize);
+    cmacDouble(subkeys + kBlockSize);
+}
+
+///
+/// CBC-MAC is CBC-Mode encryption where only the last cipher block is
+/// kept, blocks are ciphered in batches in engine's CBC path
+///
+void AES::cmacBlocks(const byte* input, std::size_t blocks, byte* chain, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    const std::size_t kBatchBlocks = 64;
+    byte cipher[kBatchBlocks * kBlockSize];
+    while (blocks > 0) {
+        const std::size_t batch = std::min(blocks, kBatchBlocks);
+        encryptCbcBlocks(input, cipher, batch, chain, keySchedule, rounds);
+        input += batch * kBlockSize;
+        blocks -= batch;
+    }
+}
+
+void AES::cmacFinal(const byte* lastBlock, std::size_t lastSize, byte* chain, const byte* subkeys, const KeySchedule* keySchedule, uint8_t rounds)
+{
+    byte block[kBlockSize] = {};
+    std::copy_n(lastBlock, lastSize, block);
+    if (lastSize == kBlockSize) {
+        xorBlock(block, subkeys);
+    } else {
+        block[lastSize] = 0x80;
+        xorBlock(block, subkeys + kBlockSize);
+    }
+    encryptCbcBlocks(block, block, 1, chain, keySchedule, rounds);
+}
+
+std::size_t AES::chunkBlocks(std::size_t blocks)
+{
+    const std::size_t threads = std::min(threadCount(), blocks / kMinBlocksPerThread);
+    if (threads <= 1) {
+        return blocks;
+    }
+    return (blocks + threads - 1) / threads;
+}
+
+void AES::parallelBlocks(std::size_t blocks, std::size_t chunk, const std::function<void(std::size_t, std::size_t)>& func)
+{
+    if (chunk >= blocks) {
+        func(0, blocks);
+        return;
+    }
+    const std::size_t threads = (blocks + chunk - 1) / chunk;
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t first = chunk; first < blocks; first += chunk) {
+        const std::size_t count = std::min(chunk, blocks - first);
+        try {
+            workers.emplace_back(func, first, count);
+        } catch (const std::system_error&) {
+            // could not start thread, do it ourselves
+            func(first, count);
+        }
+    }
+    func(0, chunk);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+ByteArray AES::encryptSingleBlock(const ByteArray::const_iterator& range, const Key* key, KeySchedule* keySchedule)
+{
+
+    if (key == nullptr || keySchedule == nullptr) {
+        throw std::invalid_argument("AES raw encryption requires key");
+    }
+
+    const uint8_t kTotalRounds = roundsForKey(key->size());
+
+    ByteArray result(kBlockSize);
+    encryptBlock(&*range, result.data(), keySchedule, kTotalRounds);
+    return result;
+}
+
+ByteArray AES::decryptSingleBlock(const ByteArray::const_iterator& range, const Key* key, KeySchedule* keySchedule)
+{
+
+    if (key == nullptr || keySchedule == nullptr) {
+        throw std::invalid_argument("AES raw decryption requires key");
+    }
+
+    const uint8_t kTotalRounds = roundsForKey(key->size());
+
+    KeySchedule inverseKeySchedule;
+    toInverseKeySchedule(keySchedule, kTotalRounds, &inverseKeySchedule);
+
+    ByteArray result(kBlockSize);
+    decryptBlock(&*range, result.data(), &inverseKeySchedule, kTotalRounds);
+    return result;
+}
+
+ByteArray AES::resolveInputMode(const std::string& input, MineCommon::Encoding inputMode, std::size_t extra)
+{
+    ByteArray result;
+    if (inputMode == MineCommon::Encoding::Raw) {
+        result.reserve(input.size() + extra);
+        result.assign(input.begin(), input.end());
+    } else if (inputMode == MineCommon::Encoding::Base16) {
+        result.reserve((input.size() / 2) + extra);
+        Base16::fromString(input, &result);
+    } else {
+        // base64, line breaks (if any) make input longer than needed
+        result.reserve(((input.size() / 4) * 3) + extra);
+        Base64::decode(input.begin(), input.end(), std::back_inserter(result));
+    }
+    return result;
+}
+
+std::string AES::resolveOutputMode(const byte* input, std::size_t length, MineCommon::Encoding outputMode)
+{
+    std::string result;
+    if (outputMode == MineCommon::Encoding::Raw) {
+        result.assign(input, input + length);
+    } else if (outputMode == MineCommon::Encoding::Base16) {
+        result.reserve(2 * length);
+        Base16::encode(input, input + length, std::back_inserter(result));
+    } else {
+        // base64
+        result.reserve(Base64::expectedLength(length));
+        Base64::encode(input, input + length, std::back_inserter(result));
+    }
+    return result;
+}
+
+bool AES::tagsEqual(const byte* a, const byte* b, std::size_t size)
+{
+    byte difference = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        difference |= a[i] ^ b[i];
+    }
+    return difference == 0;
+}
+
+std::size_t AES::getPaddingIndex(const byte* block)
+{
+    char lastChar = block[kBlockSize - 1];
+    int c = lastChar & 0xff;
+    if (c > 0 && c <= kBlockSize) {
+        bool validPadding = true;
+        for (int chkIdx = kBlockSize - c; chkIdx < kBlockSize; ++chkIdx) {
+            if ((block[chkIdx] & 0xff) != c) {
+                // with openssl we found padding
+                validPadding = false;
+                break;
+            }
+        }
+        if (validPadding) {
+            return kBlockSize - c;
+        } else {
+            throw std::runtime_error("Incorrect padding");
+        }
+    }
+    return kBlockSize;
+}
+
+// public
+
+std::size_t AES::wrappedKeySize(std::size_t length, bool padding)
+{
+    if (padding) {
+        return (((length + 7) / 8) * 8) + 8;
+    }
+    return length + 8;
+}
+
+std::size_t AES::encryptedSize(std::size_t length, bool pkcs5Padding)
+{
+    if (pkcs5Padding) {
+        return ((length / kBlockSize) + 1) * kBlockSize;
+    }
+    return ((length + kBlockSize - 1) / kBlockSize) * kBlockSize;
+}
+
+ByteArray AES::encrypt(const ByteArray& input, const Key* key, bool pkcs5Padding)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return encr(input, pkcs5Padding);
+}
+
+ByteArray AES::decrypt(const ByteArray& input, const Key* key)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return decr(input);
+}
+
+ByteArray AES::encrypt(const ByteArray& input, const Key* key, ByteArray& iv, bool pkcs5Padding)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return encr(input, iv, pkcs5Padding);
+}
+
+ByteArray AES::decrypt(const ByteArray& input, const Key* key, ByteArray& iv)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return decr(input, iv);
+}
+
+ByteArray AES::encryptCtr(const ByteArray& input, const Key* key, const ByteArray& counterBlock, std::size_t counterSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return encrCtr(input, counterBlock, counterSize);
+}
+
+ByteArray AES::decryptCtr(const ByteArray& input, const Key* key, const ByteArray& counterBlock, std::size_t counterSize)
+{
+    return encryptCtr(input, key, counterBlock, counterSize);
+}
+
+ByteArray AES::encryptCfb(const ByteArray& input, const Key* key, const ByteArray& iv, std::size_t segmentSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return encrCfb(input, iv, segmentSize);
+}
+
+ByteArray AES::decryptCfb(const ByteArray& input, const Key* key, const ByteArray& iv, std::size_t segmentSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return decrCfb(input, iv, segmentSize);
+}
+
+ByteArray AES::encryptOfb(const ByteArray& input, const Key* key, const ByteArray& iv)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return encrOfb(input, iv);
+}
+
+ByteArray AES::decryptOfb(const ByteArray& input, const Key* key, const ByteArray& iv)
+{
+    return encryptOfb(input, key, iv);
+}
+
+ByteArray AES::encryptGcm(const ByteArray& input, const Key* key, ByteArray& iv, const ByteArray& aad, ByteArray& tag, std::size_t tagSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return encrGcm(input, iv, aad, tag, tagSize);
+}
+
+ByteArray AES::decryptGcm(const ByteArray& input, const Key* key, const ByteArray& iv, const ByteArray& aad, const ByteArray& tag)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return decrGcm(input, iv, aad, tag);
+}
+
+ByteArray AES::encryptCcm(const ByteArray& input, const Key* key, ByteArray& nonce, const ByteArray& aad, ByteArray& tag, std::size_t tagSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return encrCcm(input, nonce, aad, tag, tagSize);
+}
+
+ByteArray AES::decryptCcm(const ByteArray& input, const Key* key, const ByteArray& nonce, const ByteArray& aad, const ByteArray& tag)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return decrCcm(input, nonce, aad, tag);
+}
+
+ByteArray AES::encryptXts(const ByteArray& input, const Key* key, uint64_t sector, std::size_t sectorSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation, two AES-128 or two AES-256 keys
+    if (keySize != 32 && keySize != 64) {
+        throw std::invalid_argument("Invalid XTS key size, it should be 256-bit or 512-bit");
+    }
+
+    Key dataKey(key->begin(), key->begin() + (keySize / 2));
+    Key tweakKey(key->begin() + (keySize / 2), key->end());
+    if (dataKey != m_key) {
+        setKey(dataKey);
+    }
+    if (tweakKey != m_secondKey) {
+        setSecondKey(tweakKey);
+    }
+
+    ByteArray result(input.size());
+    encrXts(input.data(), input.size(), result.data(), &tweakKey, sector, sectorSize);
+    return result;
+}
+
+ByteArray AES::decryptXts(const ByteArray& input, const Key* key, uint64_t sector, std::size_t sectorSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation, two AES-128 or two AES-256 keys
+    if (keySize != 32 && keySize != 64) {
+        throw std::invalid_argument("Invalid XTS key size, it should be 256-bit or 512-bit");
+    }
+
+    Key dataKey(key->begin(), key->begin() + (keySize / 2));
+    Key tweakKey(key->begin() + (keySize / 2), key->end());
+    if (dataKey != m_key) {
+        setKey(dataKey);
+    }
+    if (tweakKey != m_secondKey) {
+        setSecondKey(tweakKey);
+    }
+
+    ByteArray result(input.size());
+    decrXts(input.data(), input.size(), result.data(), &tweakKey, sector, sectorSize);
+    return result;
+}
+
+ByteArray AES::encryptSiv(const ByteArray& input, const Key* key, const std::vector<ByteArray>& aad)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation, two AES keys
+    if (keySize != 32 && keySize != 48 && keySize != 64) {
+        throw std::invalid_argument("Invalid SIV key size, it should be 256-bit, 384-bit or 512-bit");
+    }
+
+    Key macKey(key->begin(), key->begin() + (keySize / 2));
+    Key ctrKey(key->begin() + (keySize / 2), key->end());
+    if (macKey != m_key) {
+        setKey(macKey);
+    }
+    if (ctrKey != m_secondKey) {
+        setSecondKey(ctrKey);
+    }
+
+    std::vector<const byte*> aadData;
+    std::vector<std::size_t> aadSizes;
+    for (const ByteArray& item : aad) {
+        aadData.push_back(item.data());
+        aadSizes.push_back(item.size());
+    }
+
+    ByteArray result(input.size() + kBlockSize);
+    encrSiv(input.data(), input.size(), result.data(), &ctrKey, aadData.data(), aadSizes.data(), aad.size());
+    return result;
+}
+
+ByteArray AES::decryptSiv(const ByteArray& input, const Key* key, const std::vector<ByteArray>& aad)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation, two AES keys
+    if (keySize != 32 && keySize != 48 && keySize != 64) {
+        throw std::invalid_argument("Invalid SIV key size, it should be 256-bit, 384-bit or 512-bit");
+    }
+
+    if (input.size() < kBlockSize) {
+        throw std::invalid_argument("Input is too short for SIV-Mode, it should be at least 16 bytes");
+    }
+
+    Key macKey(key->begin(), key->begin() + (keySize / 2));
+    Key ctrKey(key->begin() + (keySize / 2), key->end());
+    if (macKey != m_key) {
+        setKey(macKey);
+    }
+    if (ctrKey != m_secondKey) {
+        setSecondKey(ctrKey);
+    }
+
+    std::vector<const byte*> aadData;
+    std::vector<std::size_t> aadSizes;
+    for (const ByteArray& item : aad) {
+        aadData.push_back(item.data());
+        aadSizes.push_back(item.size());
+    }
+
+    ByteArray result(input.size() - kBlockSize);
+    decrSiv(input.data(), input.size(), result.data(), &ctrKey, aadData.data(), aadSizes.data(), aad.size());
+    return result;
+}
+
+ByteArray AES::cmac(const ByteArray& input, const Key* key, std::size_t tagSize)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    ByteArray tag(tagSize);
+    cmac(input.data(), input.size(), tag.data(), tagSize);
+    return tag;
+}
+
+bool AES::verifyCmac(const ByteArray& input, const Key* key, const ByteArray& tag)
+{
+
+    std::size_t keySize = key->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*key != m_key) {
+        setKey(*key);
+    }
+
+    return verifyCmac(input.data(), input.size(), tag.data(), tag.size());
+}
+
+ByteArray AES::wrapKey(const ByteArray& input, const Key* kek, bool padding)
+{
+
+    std::size_t keySize = kek->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*kek != m_key) {
+        setKey(*kek);
+    }
+
+    ByteArray result(wrappedKeySize(input.size(), padding));
+    wrapKey(input.data(), input.size(), result.data(), padding);
+    return result;
+}
+
+ByteArray AES::unwrapKey(const ByteArray& input, const Key* kek, bool padding)
+{
+
+    std::size_t keySize = kek->size();
+
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (*kek != m_key) {
+        setKey(*kek);
+    }
+
+    ByteArray result(input.size() < 8 ? 0 : input.size() - 8);
+    result.resize(unwrapKey(input.data(), input.size(), result.data(), padding));
+    return result;
+}
+
+std::string AES::encrypt(const std::string& input, const std::string& key, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding)
+{
+    Key keyArr = Base16::fromString(key);
+
+    // key size validation
+    if (keyArr.size() != 16 && keyArr.size() != 24 && keyArr.size() != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (keyArr != m_key) {
+        setKey(keyArr);
+    }
+    return encr(input, inputEncoding, outputEncoding, pkcs5Padding);
+}
+
+std::string AES::encrypt(const std::string& input, const std::string& key, std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding)
+{
+    Key keyArr = Base16::fromString(key);
+
+    // key size validation
+    if (keyArr.size() != 16 && keyArr.size() != 24 && keyArr.size() != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (keyArr != m_key) {
+        setKey(keyArr);
+    }
+    return encr(input, iv, inputEncoding, outputEncoding, pkcs5Padding);
+}
+
+std::string AES::decrypt(const std::string& input, const std::string& key, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding)
+{
+    Key keyArr = Base16::fromString(key);
+
+    // key size validation
+    if (keyArr.size() != 16 && keyArr.size() != 24 && keyArr.size() != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (keyArr != m_key) {
+        setKey(keyArr);
+    }
+    return decr(input, inputEncoding, outputEncoding);
+}
+
+std::string AES::decrypt(const std::string& input, const std::string& key, const std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding)
+{
+    Key keyArr = Base16::fromString(key);
+
+    // key size validation
+    if (keyArr.size() != 16 && keyArr.size() != 24 && keyArr.size() != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
+
+    if (keyArr != m_key) {
+        setKey(keyArr);
+    }
+    return decr(input, iv, inputEncoding, outputEncoding);
+}
+
+AES::Engine AES::engine()
+{
+    static const Engine kDetectedEngine = cpuSupportsVaes() ? Engine::Vaes : (cpuSupportsAesNi() ? Engine::AesNi : Engine::Bitsliced);
+    Engine forced = s_forcedEngine.load(std::memory_order_relaxed);
+    return forced == Engine::Auto ? kDetectedEngine : forced;
+}
+
+bool AES::aesNiEngine()
+{
+    const Engine current = engine();
+    return current == Engine::AesNi || current == Engine::Vaes;
+}
+
+void AES::setEngine(Engine engine)
+{
+    if (!isEngineSupported(engine)) {
+        throw std::invalid_argument("AES engine is not supported by this CPU");
+    }
+    s_forcedEngine.store(engine, std::memory_order_relaxed);
+}
+
+bool AES::isEngineSupported(Engine engine)
+{
+    switch (engine) {
+    case Engine::Auto:
+    case Engine::Portable:
+    case Engine::Bitsliced:
+        return true;
+    case Engine::AesNi:
+        return cpuSupportsAesNi();
+    case Engine::Vaes:
+        return cpuSupportsVaes();
+    }
+    return false;
+}
+
+std::size_t AES::threadCount()
+{
+    std::size_t count = s_threadCount.load(std::memory_order_relaxed);
+    if (count == 0) {
+        count = std::thread::hardware_concurrency();
+    }
+    return count == 0 ? 1 : count;
+}
+
+void AES::setThreadCount(std::size_t count)
+{
+    s_threadCount.store(count, std::memory_order_relaxed);
+}
+
+std::size_t AES::keyScheduleCacheCapacity()
+{
+    return s_keyScheduleCacheCapacity.load(std::memory_order_relaxed);
+}
+
+void AES::setKeyScheduleCacheCapacity(std::size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(s_keyScheduleCacheMutex);
+    s_keyScheduleCacheCapacity.store(capacity, std::memory_order_relaxed);
+    while (s_keyScheduleCache.size() > capacity) {
+        s_keyScheduleCacheIndex.erase(s_keyScheduleCache.back().key);
+        s_keyScheduleCache.pop_back();
+    }
+}
+
+std::size_t AES::keyScheduleCacheHits()
+{
+    std::lock_guard<std::mutex> lock(s_keyScheduleCacheMutex);
+    return s_keyScheduleCacheHits;
+}
+
+std::size_t AES::keyScheduleCacheMisses()
+{
+    std::lock_guard<std::mutex> lock(s_keyScheduleCacheMutex);
+    return s_keyScheduleCacheMisses;
+}
+
+void AES::clearKeyScheduleCache()
+{
+    std::lock_guard<std::mutex> lock(s_keyScheduleCacheMutex);
+    s_keyScheduleCache.clear();
+    s_keyScheduleCacheIndex.clear();
+    s_keyScheduleCacheHits = 0;
+    s_keyScheduleCacheMisses = 0;
+}
+
+std::string AES::generateRandomKey(const std::size_t len)
+{
+    if (len != 128 && len != 192 && len != 256) {
+        throw std::invalid_argument("Please choose valid key length of 128, 192 or 256 bits");
+    }
+    ByteArray bytes = MineCommon::generateRandomBytes(len / 8);
+    return Base16::encode(bytes.begin(), bytes.end());
+}
+
+
+// encryption / decryption with previously provided key
+
+std::string AES::encr(const std::string& input, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    // input is ciphered in place, input that is multiple of
+    // block size gets a full block of padding
+    ByteArray buffer = resolveInputMode(input, inputEncoding, kBlockSize);
+    const std::size_t length = buffer.size();
+    buffer.resize(encryptedSize(length, pkcs5Padding));
+    encr(buffer.data(), length, buffer.data(), pkcs5Padding);
+    return resolveOutputMode(buffer.data(), buffer.size(), outputEncoding);
+}
+
+std::string AES::encr(const std::string& input, std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    ByteArray ivec = Base16::fromString(iv);
+    if (!ivec.empty() && ivec.size() != kBlockSize) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
+    } else if (ivec.empty()) {
+        // generate IV
+        ivec = MineCommon::generateRandomBytes(kBlockSize);
+        iv = Base16::encode(ivec.begin(), ivec.end());
+    }
+
+    // input is ciphered in place, input that is multiple of
+    // block size gets a full block of padding
+    ByteArray buffer = resolveInputMode(input, inputEncoding, kBlockSize);
+    const std::size_t length = buffer.size();
+    buffer.resize(encryptedSize(length, pkcs5Padding));
+    encr(buffer.data(), length, buffer.data(), ivec.data(), pkcs5Padding);
+    return resolveOutputMode(buffer.data(), buffer.size(), outputEncoding);
+}
+
+std::string AES::decr(const std::string& input, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    // deciphered in place
+    ByteArray buffer = resolveInputMode(input, inputEncoding);
+    return resolveOutputMode(buffer.data(), decr(buffer.data(), buffer.size(), buffer.data()), outputEncoding);
+}
+
+std::string AES::decr(const std::string& input, const std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    ByteArray ivec = Base16::fromString(iv);
+    if (ivec.size() != kBlockSize) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
+    }
+
+    // deciphered in place
+    ByteArray buffer = resolveInputMode(input, inputEncoding);
+    return resolveOutputMode(buffer.data(), decr(buffer.data(), buffer.size(), buffer.data(), ivec.data()), outputEncoding);
+}
+
+ByteArray AES::encr(const ByteArray& input, bool pkcs5Padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    // padding is only added to incomplete block for byte arrays
+    pkcs5Padding = pkcs5Padding && input.size() % kBlockSize != 0;
+
+    ByteArray result(encryptedSize(input.size(), pkcs5Padding));
+    encr(input.data(), input.size(), result.data(), pkcs5Padding);
+    return result;
+}
+
+ByteArray AES::decr(const ByteArray& input) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    ByteArray result(input.size());
+    result.resize(decr(input.data(), input.size(), result.data()));
+    return result;
+}
+
+ByteArray AES::encr(const ByteArray& input, ByteArray& iv, bool pkcs5Padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (!iv.empty() && iv.size() != 16) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
+    } else if (iv.empty()) {
+        // generate IV
+        iv = MineCommon::generateRandomBytes(16);
+    }
+
+    // padding is only added to incomplete block for byte arrays
+    pkcs5Padding = pkcs5Padding && input.size() % kBlockSize != 0;
+
+    ByteArray result(encryptedSize(input.size(), pkcs5Padding));
+    encr(input.data(), input.size(), result.data(), iv.data(), pkcs5Padding);
+    return result;
+}
+
+ByteArray AES::decr(const ByteArray& input, ByteArray& iv) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (iv.size() != kBlockSize) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
+    }
+
+    ByteArray result(input.size());
+    result.resize(decr(input.data(), input.size(), result.data(), iv.data()));
+    return result;
+}
+
+std::size_t AES::encr(const byte* input, std::size_t length, byte* output, bool pkcs5Padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+    const std::size_t fullBlocksSize = length - (length % kBlockSize);
+
+    encryptBlocks(input, output, fullBlocksSize / kBlockSize, &m_keySchedule, kTotalRounds);
+
+    if (fullBlocksSize == length && !pkcs5Padding) {
+        return length;
+    }
+
+    byte lastBlock[kBlockSize];
+    padBlock(input + fullBlocksSize, length - fullBlocksSize, lastBlock, pkcs5Padding);
+    encryptBlocks(lastBlock, output + fullBlocksSize, 1, &m_keySchedule, kTotalRounds);
+    return fullBlocksSize + kBlockSize;
+}
+
+std::size_t AES::encr(const byte* input, std::size_t length, byte* output, const byte* iv, bool pkcs5Padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+    const std::size_t fullBlocksSize = length - (length % kBlockSize);
+
+    byte chain[kBlockSize];
+    std::copy_n(iv, kBlockSize, chain);
+
+    encryptCbcBlocks(input, output, fullBlocksSize / kBlockSize, chain, &m_keySchedule, kTotalRounds);
+
+    if (fullBlocksSize == length && !pkcs5Padding) {
+        return length;
+    }
+
+    byte lastBlock[kBlockSize];
+    padBlock(input + fullBlocksSize, length - fullBlocksSize, lastBlock, pkcs5Padding);
+    encryptCbcBlocks(lastBlock, output + fullBlocksSize, 1, chain, &m_keySchedule, kTotalRounds);
+    return fullBlocksSize + kBlockSize;
+}
+
+///
+/// Message in a lane of encrCbcBatch(), padded last block (if any)
+/// follows full blocks
+///
+struct CbcBatchLane {
+    std::size_t message;
+    const byte* input;
+    byte* output;
+    std::size_t blocks;
+    std::size_t remaining;
+    bool lastBlockPending;
+    bool onLastBlock;
+    byte chain[16];
+    byte lastBlock[16];
+};
+
+void AES::encrCbcBatch(const Message* messages, std::size_t count, bool pkcs5Padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    cbcBatch(messages, count, pkcs5Padding, &m_keySchedule, nullptr, m_rounds);
+}
+
+///
+/// Messages are sorted by key size and then by key (same handle compares
+/// without looking at the bytes) so each group of same key is contiguous
+/// and its key is expanded once. Keys of same size have same rounds so
+/// all the messages of a key size go through the lanes together
+///
+void AES::encrCbcKeyedBatch(const KeyedMessage* messages, std::size_t count, bool pkcs5Padding)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::size_t keySize = messages[i].key->size();
+        if (keySize != 16 && keySize != 24 && keySize != 32) {
+            throw std::invalid_argument("Invalid AES key size");
+        }
+    }
+
+    auto sameKey = [&](std::size_t a, std::size_t b) {
+        return messages[a].key == messages[b].key || *messages[a].key == *messages[b].key;
+    };
+    std::vector<std::size_t> order(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        const Key* keyA = messages[a].key;
+        const Key* keyB = messages[b].key;
+        if (keyA->size() != keyB->size()) {
+            return keyA->size() < keyB->size();
+        }
+        return keyA != keyB && *keyA < *keyB;
+    });
+
+    std::size_t distinctKeys = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        distinctKeys += i == 0 || !sameKey(order[i - 1], order[i]);
+    }
+    std::vector<KeySchedule> keySchedules(distinctKeys);
+
+    std::vector<Message> group;
+    std::vector<const KeySchedule*> groupKeySchedules;
+    group.reserve(count);
+    groupKeySchedules.reserve(count);
+    std::size_t keyIndex = 0;
+    for (std::size_t first = 0; first < count;) {
+        const std::size_t keySize = messages[order[first]].key->size();
+        group.clear();
+        groupKeySchedules.clear();
+        std::size_t last = first;
+        for (; last < count && messages[order[last]].key->size() == keySize; ++last) {
+            const KeyedMessage& message = messages[order[last]];
+            if (last == first || !sameKey(order[last - 1], order[last])) {
+                expandKey(message.key, &keySchedules[keyIndex++], nullptr);
+            }
+            group.push_back({ message.input, message.length, message.output, message.iv });
+            groupKeySchedules.push_back(&keySchedules[keyIndex - 1]);
+        }
+        cbcBatch(group.data(), group.size(), pkcs5Padding, nullptr, groupKeySchedules.data(), roundsForKey(keySize));
+        first = last;
+    }
+}
+
+void AES::cbcBatch(const Message* messages, std::size_t count, bool pkcs5Padding, const KeySchedule* keySchedule, const KeySchedule* const* keySchedules, uint8_t rounds)
+{
+    const std::size_t kLanes = 8;
+
+    // active lanes are kept at the front
+    CbcBatchLane lanes[kLanes];
+    std::size_t active = 0;
+    std::size_t next = 0;
+    while (true) {
+        while (active < kLanes && next < count) {
+            CbcBatchLane& lane = lanes[active];
+            lane.message = next;
+            const Message& message = messages[next++];
+            lane.input = message.input;
+            lane.output = message.output;
+            lane.blocks = message.length / kBlockSize;
+            lane.remaining = message.length % kBlockSize;
+            lane.lastBlockPending = pkcs5Padding || lane.remaining != 0;
+            lane.onLastBlock = false;
+            std::copy_n(message.iv, kBlockSize, lane.chain);
+            if (lane.blocks != 0 || lane.lastBlockPending) {
+                ++active;
+            }
+        }
+        if (active == 0) {
+            break;
+        }
+
+        // run all the lanes until shortest one is done
+        const byte* inputs[kLanes];
+        byte* outputs[kLanes];
+        byte* chains[kLanes];
+        const KeySchedule* laneKeySchedules[kLanes];
+        bool sameKeySchedule = true;
+        std::size_t blocks = 0;
+        for (std::size_t j = 0; j < active; ++j) {
+            CbcBatchLane& lane = lanes[j];
+            laneKeySchedules[j] = keySchedules == nullptr ? keySchedule : keySchedules[lane.message];
+            sameKeySchedule = sameKeySchedule && laneKeySchedules[j] == laneKeySchedules[0];
+            if (lane.blocks == 0) {
+                padBlock(lane.input, lane.remaining, lane.lastBlock, pkcs5Padding);
+                lane.blocks = 1;
+                lane.lastBlockPending = false;
+                lane.onLastBlock = true;
+            }
+            inputs[j] = lane.onLastBlock ? lane.lastBlock : lane.input;
+            outputs[j] = lane.output;
+            chains[j] = lane.chain;
+            blocks = j == 0 ? lane.blocks : std::min(blocks, lane.blocks);
+        }
+        if (sameKeySchedule) {
+            encryptCbcLanes(inputs, outputs, chains, active, blocks, laneKeySchedules[0], rounds);
+        } else {
+            encryptCbcKeyedLanes(inputs, outputs, chains, active, blocks, laneKeySchedules, rounds);
+        }
+
+        for (std::size_t j = 0; j < active;) {
+            CbcBatchLane& lane = lanes[j];
+            lane.input += lane.onLastBlock ? 0 : blocks * kBlockSize;
+            lane.output += blocks * kBlockSize;
+            lane.blocks -= blocks;
+            if (lane.blocks == 0 && !lane.lastBlockPending) {
+                // done, last active lane takes its place
+                lane = lanes[--active];
+                continue;
+            }
+            ++j;
+        }
+    }
+}
+
+std::size_t AES::decr(const byte* input, std::size_t length, byte* output) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (length % kBlockSize != 0) {
+        throw std::invalid_argument("Ciphertext length is not a multiple of block size");
+    }
+
+    if (length == 0) {
+        return 0;
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    decryptBlocks(input, output, length / kBlockSize, &m_inverseKeySchedule, kTotalRounds);
+
+    return length - kBlockSize + getPaddingIndex(output + length - kBlockSize);
+}
+
+std::size_t AES::decr(const byte* input, std::size_t length, byte* output, const byte* iv) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (length % kBlockSize != 0) {
+        throw std::invalid_argument("Ciphertext length is not a multiple of block size");
+    }
+
+    if (length == 0) {
+        return 0;
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    const std::size_t blocks = length / kBlockSize;
+    const std::size_t chunk = chunkBlocks(blocks);
+
+    if (chunk == blocks) {
+        byte chain[kBlockSize];
+        std::copy_n(iv, kBlockSize, chain);
+        decryptCbcBlocks(input, output, blocks, chain, &m_inverseKeySchedule, kTotalRounds);
+    } else {
+        // each chunk is chained to last cipher block of previous chunk,
+        // take them before any thread overwrites them (output can be same as input)
+        std::vector<byte> chains(((blocks + chunk - 1) / chunk) * kBlockSize);
+        std::copy_n(iv, kBlockSize, chains.begin());
+        for (std::size_t first = chunk; first < blocks; first += chunk) {
+            std::copy_n(input + ((first - 1) * kBlockSize), kBlockSize, chains.begin() + ((first / chunk) * kBlockSize));
+        }
+
+        parallelBlocks(blocks, chunk, [&](std::size_t firstBlock, std::size_t count) {
+            decryptCbcBlocks(input + (firstBlock * kBlockSize), output + (firstBlock * kBlockSize), count, chains.data() + ((firstBlock / chunk) * kBlockSize), &m_inverseKeySchedule, kTotalRounds);
+        });
+    }
+
+    // only last block has padding
+    return length - kBlockSize + getPaddingIndex(output + length - kBlockSize);
+}
+
+ByteArray AES::encrCtr(const ByteArray& input, const ByteArray& counterBlock, std::size_t counterSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (counterBlock.size() != kBlockSize) {
+        throw std::invalid_argument("Invalid counter block, it should be same as block size");
+    }
+
+    ByteArray result(input.size());
+    encrCtr(input.data(), input.size(), result.data(), counterBlock.data(), counterSize);
+    return result;
+}
+
+ByteArray AES::decrCtr(const ByteArray& input, const ByteArray& counterBlock, std::size_t counterSize) const
+{
+    return encrCtr(input, counterBlock, counterSize);
+}
+
+void AES::encrCtr(const byte* input, std::size_t length, byte* output, const byte* counterBlock, std::size_t counterSize, uint64_t blockOffset) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (counterSize == 0 || counterSize > kBlockSize) {
+        throw std::invalid_argument("Invalid counter size, it should be 1 to 16 bytes");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+    const KeySchedule* keySchedule = &m_keySchedule;
+    const std::size_t fullBlocks = length / kBlockSize;
+
+    // each chunk only needs its first counter block so chunks are independent
+    parallelBlocks(fullBlocks, chunkBlocks(fullBlocks), [&](std::size_t firstBlock, std::size_t blocks) {
+        byte counter[kBlockSize];
+        std::copy_n(counterBlock, kBlockSize, counter);
+        incrementCounter(counter, counterSize, blockOffset + firstBlock);
+        ctrBlocks(input + (firstBlock * kBlockSize), output + (firstBlock * kBlockSize), blocks, counter, counterSize, keySchedule, kTotalRounds);
+    });
+
+    const std::size_t remaining = length % kBlockSize;
+    if (remaining != 0) {
+        byte keyStream[kBlockSize];
+        std::copy_n(counterBlock, kBlockSize, keyStream);
+        incrementCounter(keyStream, counterSize, blockOffset + fullBlocks);
+        encryptBlocks(keyStream, keyStream, 1, keySchedule, kTotalRounds);
+        for (std::size_t i = 0; i < remaining; ++i) {
+            output[(fullBlocks * kBlockSize) + i] = input[(fullBlocks * kBlockSize) + i] ^ keyStream[i];
+        }
+    }
+}
+
+void AES::decrCtr(const byte* input, std::size_t length, byte* output, const byte* counterBlock, std::size_t counterSize, uint64_t blockOffset) const
+{
+    encrCtr(input, length, output, counterBlock, counterSize, blockOffset);
+}
+
+ByteArray AES::encrCfb(const ByteArray& input, const ByteArray& iv, std::size_t segmentSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (iv.size() != kBlockSize) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
+    }
+
+    ByteArray result(input.size());
+    encrCfb(input.data(), input.size(), result.data(), iv.data(), segmentSize);
+    return result;
+}
+
+ByteArray AES::decrCfb(const ByteArray& input, const ByteArray& iv, std::size_t segmentSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (iv.size() != kBlockSize) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
+    }
+
+    ByteArray result(input.size());
+    decrCfb(input.data(), input.size(), result.data(), iv.data(), segmentSize);
+    return result;
+}
+
+void AES::encrCfb(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t segmentSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (segmentSize == 0 || segmentSize > kBlockSize) {
+        throw std::invalid_argument("Invalid segment size, it should be 1 to 16 bytes");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    cfbEncrypt(input, length, output, iv, segmentSize, &m_keySchedule, kTotalRounds);
+}
+
+void AES::decrCfb(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t segmentSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (segmentSize == 0 || segmentSize > kBlockSize) {
+        throw std::invalid_argument("Invalid segment size, it should be 1 to 16 bytes");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    const std::size_t segments = (length + segmentSize - 1) / segmentSize;
+    const std::size_t chunk = chunkBlocks(segments);
+
+    if (chunk >= segments) {
+        cfbDecrypt(input, length, output, iv, segmentSize, &m_keySchedule, kTotalRounds);
+        return;
+    }
+
+    // each chunk needs last 128-bit of cipher text before it,
+    // take them before any thread overwrites them (output can be same as input)
+    std::vector<byte> histories(((segments + chunk - 1) / chunk) * kBlockSize);
+    std::copy_n(iv, kBlockSize, histories.begin());
+    for (std::size_t first = chunk; first < segments; first += chunk) {
+        std::copy_n(input + (first * segmentSize) - kBlockSize, kBlockSize, histories.begin() + ((first / chunk) * kBlockSize));
+    }
+
+    parallelBlocks(segments, chunk, [&](std::size_t firstSegment, std::size_t count) {
+        const std::size_t offset = firstSegment * segmentSize;
+        cfbDecrypt(input + offset, std::min(count * segmentSize, length - offset), output + offset, histories.data() + ((firstSegment / chunk) * kBlockSize), segmentSize, &m_keySchedule, kTotalRounds);
+    });
+}
+
+ByteArray AES::encrOfb(const ByteArray& input, const ByteArray& iv) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (iv.size() != kBlockSize) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
+    }
+
+    ByteArray result(input.size());
+    encrOfb(input.data(), input.size(), result.data(), iv.data());
+    return result;
+}
+
+ByteArray AES::decrOfb(const ByteArray& input, const ByteArray& iv) const
+{
+    return encrOfb(input, iv);
+}
+
+///
+/// Key stream is CBC-Mode encryption of zeros chained to IV, so
+/// engine ciphers it in batches in its CBC path
+///
+void AES::encrOfb(const byte* input, std::size_t length, byte* output, const byte* iv) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    const std::size_t kBatchBlocks = 64;
+    byte keyStream[kBatchBlocks * kBlockSize];
+    byte chain[kBlockSize];
+    std::copy_n(iv, kBlockSize, chain);
+    while (length > 0) {
+        const std::size_t batchLength = std::min(length, kBatchBlocks * kBlockSize);
+        const std::size_t blocks = (batchLength + kBlockSize - 1) / kBlockSize;
+        std::fill_n(keyStream, blocks * kBlockSize, 0);
+        encryptCbcBlocks(keyStream, keyStream, blocks, chain, &m_keySchedule, kTotalRounds);
+        for (std::size_t i = 0; i < batchLength; ++i) {
+            output[i] = input[i] ^ keyStream[i];
+        }
+        input += batchLength;
+        output += batchLength;
+        length -= batchLength;
+    }
+}
+
+void AES::decrOfb(const byte* input, std::size_t length, byte* output, const byte* iv) const
+{
+    encrOfb(input, length, output, iv);
+}
+
+void AES::ofbKeyStream(const byte* iv, std::size_t length, byte* keyStream) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    byte chain[kBlockSize];
+    std::copy_n(iv, kBlockSize, chain);
+
+    const std::size_t fullBlocks = length / kBlockSize;
+    std::fill_n(keyStream, fullBlocks * kBlockSize, 0);
+    encryptCbcBlocks(keyStream, keyStream, fullBlocks, chain, &m_keySchedule, kTotalRounds);
+
+    const std::size_t remaining = length % kBlockSize;
+    if (remaining != 0) {
+        byte lastBlock[kBlockSize] = {};
+        encryptCbcBlocks(lastBlock, lastBlock, 1, chain, &m_keySchedule, kTotalRounds);
+        std::copy_n(lastBlock, remaining, keyStream + (fullBlocks * kBlockSize));
+    }
+}
+
+ByteArray AES::encrGcm(const ByteArray& input, ByteArray& iv, const ByteArray& aad, ByteArray& tag, std::size_t tagSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (iv.empty()) {
+        // generate IV
+        iv = MineCommon::generateRandomBytes(12);
+    }
+
+    ByteArray result(input.size());
+    tag.resize(tagSize);
+    encrGcm(input.data(), input.size(), result.data(), iv.data(), iv.size(), aad.data(), aad.size(), tag.data(), tagSize);
+    return result;
+}
+
+ByteArray AES::decrGcm(const ByteArray& input, const ByteArray& iv, const ByteArray& aad, const ByteArray& tag) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    ByteArray result(input.size());
+    decrGcm(input.data(), input.size(), result.data(), iv.data(), iv.size(), aad.data(), aad.size(), tag.data(), tag.size());
+    return result;
+}
+
+void AES::encrGcm(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t ivSize, const byte* aad, std::size_t aadSize, byte* tag, std::size_t tagSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (tagSize > kBlockSize || (tagSize < 12 && tagSize != 8 && tagSize != 4)) {
+        throw std::invalid_argument("Invalid tag size, it should be 4, 8 or 12 to 16 bytes");
+    }
+
+    if (ivSize == 0) {
+        throw std::invalid_argument("Invalid IV, it should not be empty");
+    }
+
+    // 32-bit counter, at most 2^32 - 2 blocks (SP 800-38D Sec. 5.2.1.1)
+    if (length > (0xffffffffULL - 1) * kBlockSize) {
+        throw std::invalid_argument("Input is too long for GCM-Mode");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    byte fullTag[kBlockSize];
+    gcm(input, length, output, iv, ivSize, aad, aadSize, fullTag, false, &m_keySchedule, kTotalRounds);
+    std::copy_n(fullTag, tagSize, tag);
+}
+
+void AES::decrGcm(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t ivSize, const byte* aad, std::size_t aadSize, const byte* tag, std::size_t tagSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (tagSize > kBlockSize || (tagSize < 12 && tagSize != 8 && tagSize != 4)) {
+        throw std::invalid_argument("Invalid tag size, it should be 4, 8 or 12 to 16 bytes");
+    }
+
+    if (ivSize == 0) {
+        throw std::invalid_argument("Invalid IV, it should not be empty");
+    }
+
+    if (length > (0xffffffffULL - 1) * kBlockSize) {
+        throw std::invalid_argument("Input is too long for GCM-Mode");
+    }
+
+    const uint8_t kTotalRounds = m_rounds;
+
+    byte fullTag[kBlockSize];
+    gcm(input, length, output, iv, ivSize, aad, aadSize, fullTag, true, &m_keySchedule, kTotalRounds);
+
+    if (!tagsEqual(fullTag, tag, tagSize)) {
+        std::fill_n(output, length, 0);
+        throw std::runtime_error("Authentication failed");
+    }
+}
+
+ByteArray AES::encrCcm(const ByteArray& input, ByteArray& nonce, const ByteArray& aad, ByteArray& tag, std::size_t tagSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (nonce.empty()) {
+        // generate nonce
+        nonce = MineCommon::generateRandomBytes(12);
     }
-#if MINE_PROFILING
-    endProfiling(started, "stateToByteArray");
-#endif
 
+    ByteArray result(input.size());
+    tag.resize(tagSize);
+    encrCcm(input.data(), input.size(), result.data(), nonce.data(), nonce.size(), aad.data(), aad.size(), tag.data(), tagSize);
     return result;
 }
 
-ByteArray* AES::xorWithRange(ByteArray* input, const ByteArray::const_iterator& begin, const ByteArray::const_iterator& end)
+ByteArray AES::decrCcm(const ByteArray& input, const ByteArray& nonce, const ByteArray& aad, const ByteArray& tag) const
 {
-    int i = 0;
-    for (auto iter = begin; iter < end; ++iter, ++i) {
-        (*input)[i] ^= *iter;
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
     }
-    return input;
+
+    ByteArray result(input.size());
+    decrCcm(input.data(), input.size(), result.data(), nonce.data(), nonce.size(), aad.data(), aad.size(), tag.data(), tag.size());
+    return result;
 }
 
-ByteArray AES::encryptSingleBlock(const ByteArray::const_iterator& range, const Key* key, KeySchedule* keySchedule)
+void AES::encrCcm(const byte* input, std::size_t length, byte* output, const byte* nonce, std::size_t nonceSize, const byte* aad, std::size_t aadSize, byte* tag, std::size_t tagSize) const
 {
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
 
-    if (key == nullptr || keySchedule == nullptr) {
-        throw std::invalid_argument("AES raw encryption requires key");
+    if (tagSize < 4 || tagSize > kBlockSize || tagSize % 2 != 0) {
+        throw std::invalid_argument("Invalid tag size, it should be 4, 6, 8, 10, 12, 14 or 16 bytes");
     }
 
-    State state;
-    initState(&state, range);
+    if (nonceSize < 7 || nonceSize > 13) {
+        throw std::invalid_argument("Invalid nonce size, it should be 7 to 13 bytes");
+    }
 
-    const uint8_t kTotalRounds = kKeyParams.at(key->size())[1];
+    // length is encoded in 15 - nonce size bytes
+    const std::size_t q = kBlockSize - 1 - nonceSize;
+    if (q < 8 && static_cast<uint64_t>(length) >> (q * 8) != 0) {
+        throw std::invalid_argument("Input is too long for CCM-Mode with this nonce size");
+    }
 
-    int round = 0;
+    byte fullTag[kBlockSize];
+    ccm(input, length, output, nonce, nonceSize, aad, aadSize, fullTag, tagSize, false, &m_keySchedule, m_rounds);
+    std::copy_n(fullTag, tagSize, tag);
+}
 
-    // initial round
-    addRoundKey(&state, keySchedule, round++);
+void AES::decrCcm(const byte* input, std::size_t length, byte* output, const byte* nonce, std::size_t nonceSize, const byte* aad, std::size_t aadSize, const byte* tag, std::size_t tagSize) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
 
+    if (tagSize < 4 || tagSize > kBlockSize || tagSize % 2 != 0) {
+        throw std::invalid_argument("Invalid tag size, it should be 4, 6, 8, 10, 12, 14 or 16 bytes");
+    }
 
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    // intermediate round
-    for (; round < kTotalRounds; ++round) {
-        subBytes(&state);
-        shiftRows(&state);
-        mixColumns(&state);
-        addRoundKey(&state, keySchedule, round);
+    if (nonceSize < 7 || nonceSize > 13) {
+        throw std::invalid_argument("Invalid nonce size, it should be 7 to 13 bytes");
     }
 
-#if MINE_PROFILING
-    endProfiling(started, "rawCipher (intermediate rounds)");
-#endif
+    const std::size_t q = kBlockSize - 1 - nonceSize;
+    if (q < 8 && static_cast<uint64_t>(length) >> (q * 8) != 0) {
+        throw std::invalid_argument("Input is too long for CCM-Mode with this nonce size");
+    }
 
-    // final round
-    subBytes(&state);
-    shiftRows(&state);
-    addRoundKey(&state, keySchedule, round++);
+    byte fullTag[kBlockSize];
+    ccm(input, length, output, nonce, nonceSize, aad, aadSize, fullTag, tagSize, true, &m_keySchedule, m_rounds);
 
-    return stateToByteArray(&state);
+    if (!tagsEqual(fullTag, tag, tagSize)) {
+        std::fill_n(output, length, 0);
+        throw std::runtime_error("Authentication failed");
+    }
+}
 
+void AES::encrXts(const byte* input, std::size_t length, byte* output, const Key* tweakKey, uint64_t sector, std::size_t sectorSize) const
+{
+    xts(input, length, output, tweakKey, sector, sectorSize, false);
 }
 
-ByteArray AES::decryptSingleBlock(const ByteArray::const_iterator& range, const Key* key, KeySchedule* keySchedule)
+void AES::decrXts(const byte* input, std::size_t length, byte* output, const Key* tweakKey, uint64_t sector, std::size_t sectorSize) const
 {
+    xts(input, length, output, tweakKey, sector, sectorSize, true);
+}
 
-    if (key == nullptr || keySchedule == nullptr) {
-        throw std::invalid_argument("AES raw decryption requires key");
+void AES::encrSiv(const byte* input, std::size_t length, byte* output, const Key* ctrKey, const byte* const* aad, const std::size_t* aadSizes, std::size_t aadCount) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (ctrKey->size() != m_key.size()) {
+        throw std::invalid_argument("Invalid SIV CTR key, it should be same size as key");
     }
 
-    State state;
-    initState(&state, range);
+    // S2V takes up to 127 strings, last one is input
+    if (aadCount > 126) {
+        throw std::invalid_argument("Too many associated data items for SIV-Mode, it should be up to 126");
+    }
 
-    const uint8_t kTotalRounds = kKeyParams.at(key->size())[1];
+    alignas(16) KeySchedule otherCtrKeySchedule;
+    const KeySchedule* ctrKeySchedule = secondKeySchedule(ctrKey, &otherCtrKeySchedule);
 
-    int round = kTotalRounds;
+    s2v(input, length, aad, aadSizes, aadCount, output);
+    sivCtr(input, length, output + kBlockSize, output, ctrKeySchedule, m_rounds);
+}
 
-    // initial round
-    addRoundKey(&state, keySchedule, round--);
+void AES::decrSiv(const byte* input, std::size_t length, byte* output, const Key* ctrKey, const byte* const* aad, const std::size_t* aadSizes, std::size_t aadCount) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
+
+    if (ctrKey->size() != m_key.size()) {
+        throw std::invalid_argument("Invalid SIV CTR key, it should be same size as key");
+    }
+
+    if (aadCount > 126) {
+        throw std::invalid_argument("Too many associated data items for SIV-Mode, it should be up to 126");
+    }
 
-    // intermediate round
-    for (; round > 0; --round) {
-        invShiftRows(&state);
-        invSubBytes(&state);
-        addRoundKey(&state, keySchedule, round);
-        invMixColumns(&state);
+    if (length < kBlockSize) {
+        throw std::invalid_argument("Input is too short for SIV-Mode, it should be at least 16 bytes");
     }
 
-    // final round
-    invShiftRows(&state);
-    invSubBytes(&state);
-    addRoundKey(&state, keySchedule, round);
+    alignas(16) KeySchedule otherCtrKeySchedule;
+    const KeySchedule* ctrKeySchedule = secondKeySchedule(ctrKey, &otherCtrKeySchedule);
 
-    return stateToByteArray(&state);
+    sivCtr(input + kBlockSize, length - kBlockSize, output, input, ctrKeySchedule, m_rounds);
+    byte v[kBlockSize];
+    s2v(output, length - kBlockSize, aad, aadSizes, aadCount, v);
+
+    if (!tagsEqual(v, input, kBlockSize)) {
+        std::fill_n(output, length - kBlockSize, 0);
+        throw std::runtime_error("Authentication failed");
+    }
 }
 
-ByteArray AES::resolveInputMode(const std::string& input, MineCommon::Encoding inputMode)
+void AES::encrSivBatch(const Message* messages, std::size_t count, const Key* ctrKey) const
 {
-    if (inputMode == MineCommon::Encoding::Raw) {
-        return Base16::fromString(Base16::encode(input));
-    } else if (inputMode == MineCommon::Encoding::Base16) {
-        return Base16::fromString(input);
-    }
-    // base64
-    return Base16::fromString(Base16::encode(Base64::decode(input)));
+    sivBatch(messages, count, ctrKey, false, nullptr);
 }
 
-std::string AES::resolveOutputMode(const ByteArray& input, MineCommon::Encoding outputMode)
+bool AES::decrSivBatch(const Message* messages, std::size_t count, const Key* ctrKey, bool* authentic) const
 {
-    if (outputMode == MineCommon::Encoding::Raw) {
-        return MineCommon::byteArrayToRawString(input);
-    } else if (outputMode == MineCommon::Encoding::Base16) {
-        return Base16::encode(input.begin(), input.end());
-    }
-    // base64
-    return Base64::encode(input.begin(), input.end());
+    return sivBatch(messages, count, ctrKey, true, authentic);
 }
 
-std::size_t AES::getPaddingIndex(const ByteArray& byteArr)
+void AES::cmac(const byte* input, std::size_t length, byte* tag, std::size_t tagSize) const
 {
-    char lastChar = byteArr[kBlockSize - 1];
-    int c = lastChar & 0xff;
-    if (c > 0 && c <= kBlockSize) {
-        bool validPadding = true;
-        for (int chkIdx = kBlockSize - c; chkIdx < kBlockSize; ++chkIdx) {
-            if ((byteArr[chkIdx] & 0xff) != c) {
-                // with openssl we found padding
-                validPadding = false;
-                break;
-            }
-        }
-        if (validPadding) {
-            return kBlockSize - c;
-        } else {
-            throw std::runtime_error("Incorrect padding");
-        }
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
     }
-    return kBlockSize;
-}
 
-// public
+    if (tagSize == 0 || tagSize > kBlockSize) {
+        throw std::invalid_argument("Invalid tag size, it should be 1 to 16 bytes");
+    }
 
-ByteArray AES::encrypt(const ByteArray& input, const Key* key, bool pkcs5Padding)
+    const uint8_t kTotalRounds = m_rounds;
+
+    // last block (complete or not) is finalized with a subkey
+    const std::size_t blocks = length == 0 ? 0 : (length - 1) / kBlockSize;
+    byte chain[kBlockSize] = {};
+    cmacBlocks(input, blocks, chain, &m_keySchedule, kTotalRounds);
+    cmacFinal(input + (blocks * kBlockSize), length - (blocks * kBlockSize), chain, m_cmacSubkeys, &m_keySchedule, kTotalRounds);
+    std::copy_n(chain, tagSize, tag);
+}
+
+bool AES::verifyCmac(const byte* input, std::size_t length, const byte* tag, std::size_t tagSize) const
 {
+    byte expected[kBlockSize];
+    cmac(input, length, expected, tagSize);
 
-    std::size_t keySize = key->size();
+    return tagsEqual(expected, tag, tagSize);
+}
 
-    // key size validation
-    if (keySize != 16 && keySize != 24 && keySize != 32) {
-        throw std::invalid_argument("Invalid AES key size");
+///
+/// Initial value of key wrap (RFC 3394 Sec. 2.2.3.1) and prefix of
+/// alternative initial value of key wrap with padding (RFC 5649 Sec. 3)
+///
+static const uint64_t kKeyWrapIv = 0xa6a6a6a6a6a6a6a6ULL;
+static const uint64_t kKeyWrapPaddingIv = 0xa65959a6ULL;
+
+///
+/// Wrapped key in a lane of unwrapKeyBatch(), key data (R[1] to R[n])
+/// is unwrapped in place in output of the message
+///
+struct KeyUnwrapLane {
+    std::size_t message;
+    std::size_t blocks;
+    std::size_t remaining;
+    uint64_t a;
+};
+
+///
+/// Length of unwrapped key data for integrity check register a, 0 if
+/// the check fails. All the checks are done so time does not depend on
+/// which check fails
+/// \ref RFC 3394 Sec. 2.2.3 and RFC 5649 Sec. 3
+///
+static std::size_t unwrappedKeyLength(uint64_t a, const byte* keyData, std::size_t blocks, bool padding)
+{
+    if (!padding) {
+        return a == kKeyWrapIv ? blocks * 8 : 0;
+    }
+    const std::size_t length = static_cast<std::size_t>(a & 0xffffffffULL);
+    bool valid = (a >> 32) == kKeyWrapPaddingIv;
+    valid &= length > (blocks - 1) * 8 && length <= blocks * 8;
+    byte nonZero = 0;
+    for (std::size_t i = (blocks - 1) * 8; i < blocks * 8; ++i) {
+        nonZero |= static_cast<byte>(i >= length ? keyData[i] : 0);
     }
+    return valid && nonZero == 0 ? length : 0;
+}
 
-    const std::size_t inputSize = input.size();
+///
+/// Wrapping is serial, each step ciphers the integrity check register
+/// with one 64-bit block of key data
+/// \ref RFC 3394 Sec. 2.2.1 (index based) and RFC 5649 Sec. 4.1
+///
+std::size_t AES::wrapKey(const byte* input, std::size_t length, byte* output, bool padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
+    }
 
-    if (*key != m_key) {
-        m_keySchedule = keyExpansion(key);
-        m_key = *key;
+    if (padding) {
+        if (length == 0 || static_cast<uint64_t>(length) > 0xffffffffULL) {
+            throw std::invalid_argument("Invalid key data length, it should be 1 byte to 4 GiB");
+        }
+    } else if (length < 16 || length % 8 != 0) {
+        throw std::invalid_argument("Invalid key data length, it should be multiple of 64-bit and at least 128-bit");
     }
 
-    ByteArray result;
+    const uint8_t kTotalRounds = m_rounds;
 
-    for (std::size_t i = 0; i < inputSize; i += kBlockSize) {
-        ByteArray inputBlock(kBlockSize, 0);
+    const std::size_t blocks = (length + 7) / 8;
+    byte* keyData = output + 8;
+    std::copy_n(input, length, keyData);
+    std::fill(keyData + length, keyData + (blocks * 8), 0);
 
-        std::size_t j = 0;
-        // don't use copy_n as we are setting the values
-        for (; j < kBlockSize && inputSize > j + i; ++j) {
-            inputBlock[j] = input[j + i];
-        }
+    byte block[kBlockSize];
+    storeDoubleWord(padding ? (kKeyWrapPaddingIv << 32) | length : kKeyWrapIv, block);
 
-        if (pkcs5Padding && j != kBlockSize) {
-            // PKCS#5 padding
-            std::fill(inputBlock.begin() + j, inputBlock.end(), kBlockSize - (j % kBlockSize));
-        }
+    if (blocks == 1) {
+        // single block is ciphered as is
+        std::copy_n(keyData, 8, block + 8);
+        encryptBlocks(block, output, 1, &m_keySchedule, kTotalRounds);
+        return kBlockSize;
+    }
 
-        ByteArray outputBlock = encryptSingleBlock(inputBlock.begin() + i, key, &m_keySchedule);
-        std::copy(outputBlock.begin(), outputBlock.end(), std::back_inserter(result));
+    for (uint64_t t = 1; t <= 6 * static_cast<uint64_t>(blocks); ++t) {
+        byte* r = keyData + (((t - 1) % blocks) * 8);
+        std::copy_n(r, 8, block + 8);
+        encryptBlocks(block, block, 1, &m_keySchedule, kTotalRounds);
+        std::copy_n(block + 8, 8, r);
+        storeDoubleWord(loadDoubleWord(block) ^ t, block);
     }
-    return result;
+    std::copy_n(block, 8, output);
+    return (blocks + 1) * 8;
 }
 
-ByteArray AES::decrypt(const ByteArray& input, const Key* key)
+std::size_t AES::unwrapKey(const byte* input, std::size_t length, byte* output, bool padding) const
 {
-
-    std::size_t keySize = key->size();
-
-    // key size validation
-    if (keySize != 16 && keySize != 24 && keySize != 32) {
-        throw std::invalid_argument("Invalid AES key size");
+    Message message = { input, length, output, nullptr };
+    std::size_t result = 0;
+    if (!unwrapKeyBatch(&message, 1, &result, padding)) {
+        throw std::runtime_error("Authentication failed");
     }
+    return result;
+}
 
-    if (*key != m_key) {
-        m_keySchedule = keyExpansion(key);
-        m_key = *key;
+///
+/// Unwrapping one key is serial, so up to eight keys (lanes) take one
+/// step each per pass and engine deciphers their blocks together. Lanes
+/// are refilled with next keys as they finish
+/// \ref RFC 3394 Sec. 2.2.2 (index based) and RFC 5649 Sec. 4.2
+///
+bool AES::unwrapKeyBatch(const Message* messages, std::size_t count, std::size_t* lengths, bool padding) const
+{
+    if (m_key.empty()) {
+        throw std::runtime_error("Key not set");
     }
 
-    const std::size_t inputSize = input.size();
-    ByteArray result;
+    // at least two blocks of key data without padding and one with padding
+    const std::size_t minLength = padding ? kBlockSize : kBlockSize + 8;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (messages[i].length < minLength || messages[i].length % 8 != 0) {
+            throw std::invalid_argument("Invalid wrapped key length");
+        }
+    }
 
-    for (std::size_t i = 0; i < inputSize; i += kBlockSize) {
-        ByteArray inputBlock(kBlockSize, 0);
+    const uint8_t kTotalRounds = m_rounds;
+
+    const std::size_t kLanes = 8;
+    KeyUnwrapLane lanes[kLanes];
+    byte blocks[kLanes * kBlockSize];
+    std::size_t active = 0;
+    std::size_t next = 0;
+    bool authentic = true;
+
+    while (active > 0 || next < count) {
+        while (active < kLanes && next < count) {
+            const Message& message = messages[next];
+            KeyUnwrapLane& lane = lanes[active++];
+            lane.message = next++;
+            lane.blocks = (message.length / 8) - 1;
+            // single block of padded key is ciphered as is
+            lane.remaining = lane.blocks == 1 ? 1 : 6 * lane.blocks;
+            lane.a = loadDoubleWord(message.input);
+            std::copy_n(message.input + 8, message.length - 8, message.output);
+        }
 
-        std::size_t j = 0;
-        // don't use copy_n here as we are setting the values
-        for (; j < kBlockSize && inputSize > j + i; ++j) {
-            inputBlock[j] = input[j + i];
+        for (std::size_t i = 0; i < active; ++i) {
+            const KeyUnwrapLane& lane = lanes[i];
+            const uint64_t t = lane.blocks == 1 ? 0 : lane.remaining;
+            storeDoubleWord(lane.a ^ t, blocks + (i * kBlockSize));
+            std::copy_n(messages[lane.message].output + (((lane.remaining - 1) % lane.blocks) * 8), 8, blocks + (i * kBlockSize) + 8);
+        }
+        decryptBlocks(blocks, blocks, active, &m_inverseKeySchedule, kTotalRounds);
+        for (std::size_t i = 0; i < active; ++i) {
+            KeyUnwrapLane& lane = lanes[i];
+            lane.a = loadDoubleWord(blocks + (i * kBlockSize));
+            std::copy_n(blocks + (i * kBlockSize) + 8, 8, messages[lane.message].output + (((lane.remaining - 1) % lane.blocks) * 8));
+            --lane.remaining;
         }
-        ByteArray outputBlock = decryptSingleBlock(inputBlock.begin(), key, &m_keySchedule);
 
-        if (i + kBlockSize == inputSize) {
-            // check padding
-            j = getPaddingIndex(outputBlock);
+        for (std::size_t i = 0; i < active;) {
+            const KeyUnwrapLane& lane = lanes[i];
+            if (lane.remaining > 0) {
+                ++i;
+                continue;
+            }
+            byte* output = messages[lane.message].output;
+            lengths[lane.message] = unwrappedKeyLength(lane.a, output, lane.blocks, padding);
+            if (lengths[lane.message] == 0) {
+                std::fill_n(output, lane.blocks * 8, 0);
+                authentic = false;
+            }
+            lanes[i] = lanes[--active];
         }
-        std::copy_n(outputBlock.begin(), j, std::back_inserter(result));
     }
-    return result;
+    std::fill_n(blocks, sizeof(blocks), 0);
+    return authentic;
 }
 
-ByteArray AES::encrypt(const ByteArray& input, const Key* key, ByteArray& iv, bool pkcs5Padding)
-{
+// streaming
 
-    std::size_t keySize = key->size();
+AESEncryptor::AESEncryptor(const AES::Key& key, const ByteArray& iv, bool pkcs5Padding) :
+    m_cbc(!iv.empty()),
+    m_pkcs5Padding(pkcs5Padding),
+    m_finished(false),
+    m_bufferSize(0)
+{
+    std::size_t keySize = key.size();
 
     // key size validation
     if (keySize != 16 && keySize != 24 && keySize != 32) {
         throw std::invalid_argument("Invalid AES key size");
     }
 
-    if (!iv.empty() && iv.size() != 16) {
+    if (m_cbc && iv.size() != AES::kBlockSize) {
         throw std::invalid_argument("Invalid IV, it should be same as block size");
-    } else if (iv.empty()) {
-        // generate IV
-        iv = MineCommon::generateRandomBytes(16);
     }
 
-    if (*key != m_key) {
-        m_keySchedule = keyExpansion(key);
-        m_key = *key;
+    AES::KeySchedule inverseKeySchedule;
+    AES::expandKey(&key, &m_keySchedule, &inverseKeySchedule);
+    m_rounds = AES::roundsForKey(keySize);
+    if (m_cbc) {
+        std::copy_n(iv.begin(), AES::kBlockSize, m_chain);
     }
+}
 
-    const std::size_t inputSize = input.size();
-
-    ByteArray result;
-    ByteArray::const_iterator nextXorWithBeg = iv.begin();
-    ByteArray::const_iterator nextXorWithEnd = iv.end();
+void AESEncryptor::cipherBlocks(const byte* input, byte* output, std::size_t blocks)
+{
+    if (m_cbc) {
+        AES::encryptCbcBlocks(input, output, blocks, m_chain, &m_keySchedule, m_rounds);
+    } else {
+        AES::encryptBlocks(input, output, blocks, &m_keySchedule, m_rounds);
+    }
+}
 
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    for (std::size_t i = 0; i < inputSize; i += kBlockSize) {
-        ByteArray inputBlock(kBlockSize, 0);
+std::size_t AESEncryptor::update(const byte* input, std::size_t length, byte* output)
+{
+    if (m_finished) {
+        throw std::runtime_error("Stream is already finalized");
+    }
 
-        std::size_t j = 0;
-        // don't use copy_n as we are setting the values
-        for (; j < kBlockSize && inputSize > j + i; ++j) {
-            inputBlock[j] = input[j + i];
-        }
-        if (pkcs5Padding && j != kBlockSize) {
-            // PKCS#5 padding
-            std::fill(inputBlock.begin() + j, inputBlock.end(), kBlockSize - (j % kBlockSize));
+    std::size_t written = 0;
+    if (m_bufferSize > 0) {
+        // complete the pending block first
+        const std::size_t taken = std::min(length, AES::kBlockSize - m_bufferSize);
+        std::copy_n(input, taken, m_buffer + m_bufferSize);
+        m_bufferSize += taken;
+        input += taken;
+        length -= taken;
+        if (m_bufferSize < AES::kBlockSize) {
+            return 0;
         }
-        xorWithRange(&inputBlock, nextXorWithBeg, nextXorWithEnd);
+        cipherBlocks(m_buffer, output, 1);
+        m_bufferSize = 0;
+        written = AES::kBlockSize;
+    }
+
+    const std::size_t blocks = length / AES::kBlockSize;
+    cipherBlocks(input, output + written, blocks);
+    written += blocks * AES::kBlockSize;
 
-        ByteArray outputBlock = encryptSingleBlock(inputBlock.begin(), key, &m_keySchedule);
-        std::copy(outputBlock.begin(), outputBlock.end(), std::back_inserter(result));
-        nextXorWithBeg = result.end() - kBlockSize;
-        nextXorWithEnd = result.end();
+    m_bufferSize = length % AES::kBlockSize;
+    std::copy_n(input + (blocks * AES::kBlockSize), m_bufferSize, m_buffer);
+    return written;
+}
+
+std::size_t AESEncryptor::final(byte* output)
+{
+    if (m_finished) {
+        throw std::runtime_error("Stream is already finalized");
     }
-#if MINE_PROFILING
-    endProfiling(started, "block encryption");
-#endif
+    m_finished = true;
+
+    if (m_bufferSize == 0 && !m_pkcs5Padding) {
+        return 0;
+    }
+
+    byte lastBlock[AES::kBlockSize];
+    AES::padBlock(m_buffer, m_bufferSize, lastBlock, m_pkcs5Padding);
+    cipherBlocks(lastBlock, output, 1);
+    return AES::kBlockSize;
+}
 
+ByteArray AESEncryptor::update(const ByteArray& input)
+{
+    ByteArray result(input.size() + AES::kBlockSize - 1);
+    result.resize(update(input.data(), input.size(), result.data()));
     return result;
 }
 
-ByteArray AES::decrypt(const ByteArray& input, const Key* key, ByteArray& iv)
+ByteArray AESEncryptor::final()
 {
+    ByteArray result(AES::kBlockSize);
+    result.resize(final(result.data()));
+    return result;
+}
 
-    std::size_t keySize = key->size();
+AESDecryptor::AESDecryptor(const AES::Key& key, const ByteArray& iv) :
+    m_cbc(!iv.empty()),
+    m_finished(false),
+    m_bufferSize(0)
+{
+    std::size_t keySize = key.size();
 
     // key size validation
     if (keySize != 16 && keySize != 24 && keySize != 32) {
         throw std::invalid_argument("Invalid AES key size");
     }
 
-    const std::size_t inputSize = input.size();
-
-    if (inputSize % kBlockSize != 0) {
-        throw std::invalid_argument("Ciphertext length is not a multiple of block size");
+    if (m_cbc && iv.size() != AES::kBlockSize) {
+        throw std::invalid_argument("Invalid IV, it should be same as block size");
     }
 
-    if (*key != m_key) {
-        m_keySchedule = keyExpansion(key);
-        m_key = *key;
+    AES::KeySchedule keySchedule;
+    AES::expandKey(&key, &keySchedule, &m_inverseKeySchedule);
+    m_rounds = AES::roundsForKey(keySize);
+    if (m_cbc) {
+        std::copy_n(iv.begin(), AES::kBlockSize, m_chain);
     }
+}
 
-    ByteArray result;
-
-    ByteArray::const_iterator nextXorWithBeg = iv.begin();
-    ByteArray::const_iterator nextXorWithEnd = iv.end();
-
-#if MINE_PROFILING
-    auto started = std::chrono::steady_clock::now();
-#endif
-    for (std::size_t i = 0; i < inputSize; i += kBlockSize) {
-        ByteArray inputBlock(kBlockSize, 0);
+void AESDecryptor::decipherBlocks(const byte* input, byte* output, std::size_t blocks)
+{
+    if (m_cbc) {
+        AES::decryptCbcBlocks(input, output, blocks, m_chain, &m_inverseKeySchedule, m_rounds);
+    } else {
+        AES::decryptBlocks(input, output, blocks, &m_inverseKeySchedule, m_rounds);
+    }
+}
 
-        std::size_t j = 0;
-        // don't use copy_n as we are setting the values
-        for (; j < kBlockSize && inputSize > j + i; ++j) {
-            inputBlock[j] = input[j + i];
-        }
+std::size_t AESDecryptor::update(const byte* input, std::size_t length, byte* output)
+{
+    if (m_finished) {
+        throw std::runtime_error("Stream is already finalized");
+    }
 
-        ByteArray outputBlock = decryptSingleBlock(inputBlock.begin(), key, &m_keySchedule);
+    if (m_bufferSize + length <= AES::kBlockSize) {
+        std::copy_n(input, length, m_buffer + m_bufferSize);
+        m_bufferSize += length;
+        return 0;
+    }
 
-        xorWithRange(&outputBlock, nextXorWithBeg, nextXorWithEnd);
+    // keep at least one byte (i.e, last block) for final()
+    std::size_t blocks = (m_bufferSize + length - 1) / AES::kBlockSize;
+    std::size_t written = 0;
+    if (m_bufferSize > 0) {
+        const std::size_t taken = AES::kBlockSize - m_bufferSize;
+        std::copy_n(input, taken, m_buffer + m_bufferSize);
+        input += taken;
+        length -= taken;
+        decipherBlocks(m_buffer, output, 1);
+        written = AES::kBlockSize;
+        --blocks;
+    }
 
-        if (i + kBlockSize == inputSize) {
-            // check padding
-            j = getPaddingIndex(outputBlock);
-        } else {
-            nextXorWithBeg = input.begin() + i;
-            nextXorWithEnd = input.begin() + i + kBlockSize;
-        }
+    decipherBlocks(input, output + written, blocks);
+    written += blocks * AES::kBlockSize;
 
-        std::copy_n(outputBlock.begin(), j, std::back_inserter(result));
-    }
-#if MINE_PROFILING
-    endProfiling(started, "block decryption");
-#endif
-    return result;
+    m_bufferSize = length - (blocks * AES::kBlockSize);
+    std::copy_n(input + (blocks * AES::kBlockSize), m_bufferSize, m_buffer);
+    return written;
 }
 
-std::string AES::encrypt(const std::string& input, const std::string& key, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding)
+std::size_t AESDecryptor::final(byte* output)
 {
-    Key keyArr = Base16::fromString(key);
-    ByteArray inp = resolveInputMode(input, inputEncoding);
-    if (pkcs5Padding && inp.size() % kBlockSize == 0) {
-        // input size is multiple of block size, increase
-        // input size for padding
-        auto sz = inp.size();
-        inp.resize(sz + kBlockSize);
-        std::fill(inp.begin() + sz, inp.end(), 16);
+    if (m_finished) {
+        throw std::runtime_error("Stream is already finalized");
     }
-    ByteArray result = encrypt(inp, &keyArr, pkcs5Padding);
-    return resolveOutputMode(result, outputEncoding);
-}
+    m_finished = true;
 
-std::string AES::encrypt(const std::string& input, const std::string& key, std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding)
-{
-    Key keyArr = Base16::fromString(key);
-    ByteArray inp = resolveInputMode(input, inputEncoding);
-    if (pkcs5Padding && inp.size() % kBlockSize == 0) {
-        // input size is multiple of block size, increase
-        // input size for padding
-        auto sz = inp.size();
-        inp.resize(sz + kBlockSize);
-        std::fill(inp.begin() + sz, inp.end(), 16);
+    if (m_bufferSize == 0) {
+        return 0;
     }
-    ByteArray ivec = Base16::fromString(iv);
-    bool ivecGenerated = iv.empty();
-    ByteArray result = encrypt(inp, &keyArr, ivec, pkcs5Padding);
-    if (ivecGenerated) {
-        iv = Base16::encode(ivec.begin(), ivec.end());
+
+    if (m_bufferSize != AES::kBlockSize) {
+        throw std::invalid_argument("Ciphertext length is not a multiple of block size");
     }
-    return resolveOutputMode(result, outputEncoding);
+
+    decipherBlocks(m_buffer, output, 1);
+    return AES::getPaddingIndex(output);
 }
 
-std::string AES::decrypt(const std::string& input, const std::string& key, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding)
+ByteArray AESDecryptor::update(const ByteArray& input)
 {
-    Key keyArr = Base16::fromString(key);
-    ByteArray inp = resolveInputMode(input, inputEncoding);
-    ByteArray result = decrypt(inp, &keyArr);
-    return resolveOutputMode(result, outputEncoding);
+    ByteArray result(input.size() + AES::kBlockSize - 1);
+    result.resize(update(input.data(), input.size(), result.data()));
+    return result;
 }
 
-std::string AES::decrypt(const std::string& input, const std::string& key, const std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding)
+ByteArray AESDecryptor::final()
 {
-    Key keyArr = Base16::fromString(key);
-    ByteArray inp = resolveInputMode(input, inputEncoding);
-    ByteArray ivec = Base16::fromString(iv);
-    ByteArray result = decrypt(inp, &keyArr, ivec);
-    return resolveOutputMode(result, outputEncoding);
+    ByteArray result(AES::kBlockSize);
+    result.resize(final(result.data()));
+    return result;
 }
 
-std::string AES::generateRandomKey(const std::size_t len)
+AESCmac::AESCmac(const AES::Key& key) :
+    m_finished(false),
+    m_bufferSize(0)
 {
-    if (len != 128 && len != 192 && len != 256) {
-        throw std::invalid_argument("Please choose valid key length of 128, 192 or 256 bits");
-    }
-    ByteArray bytes = MineCommon::generateRandomBytes(len / 8);
-    return Base16::encode(bytes.begin(), bytes.end());
-}
+    std::size_t keySize = key.size();
 
+    // key size validation
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        throw std::invalid_argument("Invalid AES key size");
+    }
 
-// encryption / decryption with previously provided key
+    AES::KeySchedule inverseKeySchedule;
+    AES::expandKey(&key, &m_keySchedule, &inverseKeySchedule);
+    m_rounds = AES::roundsForKey(keySize);
+    AES::cmacSubkeys(&m_keySchedule, m_rounds, m_subkeys);
+    std::fill_n(m_chain, AES::kBlockSize, 0);
+}
 
-std::string AES::encr(const std::string& input, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding)
+void AESCmac::update(const byte* input, std::size_t length)
 {
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
+    if (m_finished) {
+        throw std::runtime_error("Stream is already finalized");
     }
-    return encrypt(input, Base16::encode(MineCommon::byteArrayToRawString(m_key)), inputEncoding, outputEncoding, pkcs5Padding);
-}
 
-std::string AES::encr(const std::string& input, std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding, bool pkcs5Padding)
-{
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
+    if (length == 0) {
+        return;
     }
-    return encrypt(input, Base16::encode(MineCommon::byteArrayToRawString(m_key)), iv, inputEncoding, outputEncoding, pkcs5Padding);
-}
 
-std::string AES::decr(const std::string& input, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding)
-{
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
+    // last block is held back until final() as it's finalized with a subkey
+    if (m_bufferSize > 0 || length <= AES::kBlockSize) {
+        const std::size_t taken = std::min(length, AES::kBlockSize - m_bufferSize);
+        std::copy_n(input, taken, m_buffer + m_bufferSize);
+        m_bufferSize += taken;
+        input += taken;
+        length -= taken;
+        if (length == 0) {
+            return;
+        }
+        AES::cmacBlocks(m_buffer, 1, m_chain, &m_keySchedule, m_rounds);
+        m_bufferSize = 0;
     }
-    return decrypt(input, Base16::encode(MineCommon::byteArrayToRawString(m_key)), inputEncoding, outputEncoding);
+
+    const std::size_t blocks = (length - 1) / AES::kBlockSize;
+    AES::cmacBlocks(input, blocks, m_chain, &m_keySchedule, m_rounds);
+
+    m_bufferSize = length - (blocks * AES::kBlockSize);
+    std::copy_n(input + (blocks * AES::kBlockSize), m_bufferSize, m_buffer);
 }
 
-std::string AES::decr(const std::string& input, const std::string& iv, MineCommon::Encoding inputEncoding, MineCommon::Encoding outputEncoding)
+void AESCmac::final(byte* tag, std::size_t tagSize)
 {
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
+    if (m_finished) {
+        throw std::runtime_error("Stream is already finalized");
     }
-    return decrypt(input, Base16::encode(MineCommon::byteArrayToRawString(m_key)), iv, inputEncoding, outputEncoding);
-}
 
-ByteArray AES::encr(const ByteArray& input, bool pkcs5Padding)
-{
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
+    if (tagSize == 0 || tagSize > AES::kBlockSize) {
+        throw std::invalid_argument("Invalid tag size, it should be 1 to 16 bytes");
     }
-    return encrypt(input, &m_key, pkcs5Padding);
+    m_finished = true;
+
+    AES::cmacFinal(m_buffer, m_bufferSize, m_chain, m_subkeys, &m_keySchedule, m_rounds);
+    std::copy_n(m_chain, tagSize, tag);
 }
 
-ByteArray AES::decr(const ByteArray& input)
+void AESCmac::update(const ByteArray& input)
 {
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
-    }
-    return decrypt(input, &m_key);
+    update(input.data(), input.size());
 }
 
-ByteArray AES::encr(const ByteArray& input, ByteArray& iv, bool pkcs5Padding)
+ByteArray AESCmac::final(std::size_t tagSize)
 {
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
-    }
-    return encrypt(input, &m_key, iv, pkcs5Padding);
+    ByteArray tag(tagSize);
+    final(tag.data(), tagSize);
+    return tag;
 }
 
-ByteArray AES::decr(const ByteArray& input, ByteArray& iv)
+void AESCmac::reset()
 {
-    if (m_key.empty()) {
-        throw std::runtime_error("Key not set");
-    }
-    return decrypt(input, &m_key, iv);
+    m_finished = false;
+    m_bufferSize = 0;
+    std::fill_n(m_chain, AES::kBlockSize, 0);
 }
@@ -21,9 +21,9 @@
 
 #include <string>
 #include <array>
-#include <unordered_map>
+#include <functional>
+#include <type_traits>
 #include <vector>
-#include <map>
 #include "src/mine-common.h"
 
 namespace mine {
@@ -41,6 +41,11 @@ namespace mine {
 /// the source code for AES class is heavily commented for
 /// verification on implementation.
 ///
+/// Functions without key that are const (e.g, encr(const byte*, ...) const)
+/// never change the instance, so a const AES with its key set is an immutable
+/// cipher context that can be used by many threads at a time without locks.
+/// Functions that take a key, and setKey(), change the instance.
+///
 class AES {
 public:
 
@@ -49,6 +54,72 @@ public:
     ///
     using Key = ByteArray;
 
+    ///
+    /// \brief Independent message for batch functions, e.g, encrCbcBatch()
+    ///
+    struct Message {
+        const byte* input;
+        std::size_t length;
+
+        // buffer big enough for the result, e.g, encryptedSize(length)
+        byte* output;
+
+        // 128-bit initialization vector
+        const byte* iv;
+    };
+
+    ///
+    /// \brief Message with its own key for key-agile batch functions, e.g, encrCbcKeyedBatch()
+    ///
+    struct KeyedMessage {
+        // key handle, messages with same key (same handle or same bytes) are ciphered together
+        const Key* key;
+
+        const byte* input;
+        std::size_t length;
+
+        // buffer big enough for the result, e.g, encryptedSize(length)
+        byte* output;
+
+        // 128-bit initialization vector
+        const byte* iv;
+    };
+
+    ///
+    /// \brief Implementations of block cipher. Engine is shared by all
+    /// the instances and is picked at runtime based on CPU features
+    ///
+    enum class Engine {
+        ///
+        /// \brief Fastest engine supported by the CPU
+        ///
+        Auto,
+
+        ///
+        /// \brief Table driven rounds, supported on every CPU
+        ///
+        Portable,
+
+        ///
+        /// \brief Bitsliced rounds on eight blocks at a time without any
+        /// table lookups (constant-time), supported on every CPU. Used when
+        /// CPU does not support AES-NI
+        ///
+        Bitsliced,
+
+        ///
+        /// \brief Intel AES New Instructions (x86 / x86-64)
+        ///
+        AesNi,
+
+        ///
+        /// \brief AES-NI on 512-bit registers, i.e, four blocks per instruction (VAES with
+        /// AVX-512, x86-64). ECB, CTR and CBC decryption use it, rest is same as AesNi.
+        /// Define MINE_DISABLE_VAES to build without it
+        ///
+        Vaes
+    };
+
     AES() = default;
     AES(const std::string& key);
     AES(const ByteArray& key);
@@ -65,6 +136,63 @@ public:
     ///
     static std::string generateRandomKey(const std::size_t len);
 
+    ///
+    /// \brief Engine in use by all AES instances (never Engine::Auto)
+    ///
+    static Engine engine();
+
+    ///
+    /// \brief Forces specified engine for all AES instances.
+    /// Engine::Auto brings back runtime detection
+    /// \throws std::invalid_argument if CPU does not support the engine
+    ///
+    static void setEngine(Engine engine);
+
+    ///
+    /// \brief Whether CPU (and build) supports specified engine
+    ///
+    static bool isEngineSupported(Engine engine);
+
+    ///
+    /// \brief Maximum number of threads used by modes that can be
+    /// parallelized (e.g, CTR) for large input
+    ///
+    static std::size_t threadCount();
+
+    ///
+    /// \brief Sets maximum number of threads for all AES instances.
+    /// Zero (default) uses number of hardware threads
+    ///
+    static void setThreadCount(std::size_t count);
+
+    ///
+    /// \brief Maximum number of keys in key schedule cache
+    ///
+    static std::size_t keyScheduleCacheCapacity();
+
+    ///
+    /// \brief Enables cache of expanded key schedules (for encryption and decryption)
+    /// shared by all AES instances, least recently used key is dropped when cache is full.
+    /// Zero (default) disables and clears the cache.
+    /// Note: Cache keeps copy of the keys in memory until they are dropped
+    ///
+    static void setKeyScheduleCacheCapacity(std::size_t capacity);
+
+    ///
+    /// \brief Number of times key schedule was found in cache
+    ///
+    static std::size_t keyScheduleCacheHits();
+
+    ///
+    /// \brief Number of times key schedule was not found in cache and had to be expanded
+    ///
+    static std::size_t keyScheduleCacheMisses();
+
+    ///
+    /// \brief Drops all the keys from cache and resets hits and misses
+    ///
+    static void clearKeyScheduleCache();
+
     ///
     /// \brief Ciphers the input with specified hex key
     /// \param key Hex key
@@ -144,21 +272,454 @@ public:
 
     // cipher / decipher interface without keys
 
-    std::string encr(const std::string& input, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Raw, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Base16, bool pkcs5Padding = true);
+    std::string encr(const std::string& input, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Raw, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Base16, bool pkcs5Padding = true) const;
+
+    std::string encr(const std::string& input, std::string& iv, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Raw, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Base16, bool pkcs5Padding = true) const;
+
+    std::string decr(const std::string& input, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Base16, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Raw) const;
+
+    std::string decr(const std::string& input, const std::string& iv, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Base16, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Raw) const;
+
+    ByteArray encr(const ByteArray& input, bool pkcs5Padding = true) const;
+
+    ByteArray decr(const ByteArray& input) const;
 
-    std::string encr(const std::string& input, std::string& iv, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Raw, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Base16, bool pkcs5Padding = true);
+    ByteArray encr(const ByteArray& input, ByteArray& iv, bool pkcs5Padding = true) const;
 
-    std::string decr(const std::string& input, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Base16, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Raw);
+    ByteArray decr(const ByteArray& input, ByteArray& iv) const;
 
-    std::string decr(const std::string& input, const std::string& iv, MineCommon::Encoding inputEncoding = MineCommon::Encoding::Base16, MineCommon::Encoding outputEncoding = MineCommon::Encoding::Raw);
+    // cipher / decipher interface without keys writing to caller's buffer,
+    // these do not allocate any memory
 
-    ByteArray encr(const ByteArray& input, bool pkcs5Padding = true);
+    ///
+    /// \brief Exact size of cipher for input of specified length
+    /// \param pkcs5Padding If true, there is always padding, i.e, a full block of
+    /// padding is added when length is multiple of block size
+    ///
+    static std::size_t encryptedSize(std::size_t length, bool pkcs5Padding = true);
+
+    ///
+    /// \brief Ciphers with ECB-Mode
+    /// \param input Plain input of length bytes
+    /// \param output Buffer of at least encryptedSize(length, pkcs5Padding) bytes
+    /// \param pkcs5Padding Defaults to true, if false non-standard zero-padding is used
+    /// \return Number of bytes written to output
+    ///
+    std::size_t encr(const byte* input, std::size_t length, byte* output, bool pkcs5Padding = true) const;
+
+    ///
+    /// \brief Ciphers with CBC-Mode
+    /// \param iv 128-bit initialization vector
+    /// \see encr(const byte*, std::size_t, byte*, bool)
+    ///
+    std::size_t encr(const byte* input, std::size_t length, byte* output, const byte* iv, bool pkcs5Padding = true) const;
+
+    ///
+    /// \brief Deciphers with ECB-Mode
+    /// \param input Cipher of length bytes, length must be multiple of block size
+    /// \param output Buffer of at least length bytes
+    /// \return Number of bytes written to output excluding padding
+    ///
+    std::size_t decr(const byte* input, std::size_t length, byte* output) const;
+
+    ///
+    /// \brief Deciphers with CBC-Mode, large input is deciphered on up to threadCount() threads
+    /// \param iv 128-bit initialization vector
+    /// \see decr(const byte*, std::size_t, byte*)
+    ///
+    std::size_t decr(const byte* input, std::size_t length, byte* output, const byte* iv) const;
+
+    ///
+    /// \brief Ciphers many independent messages with CBC-Mode, same as encr() for each
+    /// message. Chains of up to eight messages are interleaved so engine always has
+    /// multiple blocks to cipher at a time, this is much faster than one message at a time
+    /// for short messages
+    /// \param messages Messages with output of at least encryptedSize(length, pkcs5Padding) bytes,
+    /// output must not overlap any input
+    /// \param pkcs5Padding Defaults to true, if false non-standard zero-padding is used
+    ///
+    void encrCbcBatch(const Message* messages, std::size_t count, bool pkcs5Padding = true) const;
+
+    ///
+    /// \brief Ciphers many independent messages, each with its own key, with CBC-Mode. Messages
+    /// are grouped by key so each distinct key is expanded once per batch (or found in key
+    /// schedule cache). Messages of different keys of same size share the eight lanes of
+    /// encrCbcBatch(), so few messages per key still keep engine busy. No instance
+    /// is needed so there is no key switching between messages
+    /// \param messages Messages with valid AES keys and output of at least encryptedSize(length, pkcs5Padding)
+    /// bytes, output must not overlap any input
+    /// \see setKeyScheduleCacheCapacity() to keep keys expanded across batches
+    ///
+    static void encrCbcKeyedBatch(const KeyedMessage* messages, std::size_t count, bool pkcs5Padding = true);
+
+    // CTR-Mode, there is no padding and decryption is same as encryption
+
+    ///
+    /// \brief Ciphers with CTR-Mode (NIST SP 800-38A Sec. 6.5)
+    /// \param input Plain input of any length
+    /// \param key Pointer to a valid AES key
+    /// \param counterBlock Initial 128-bit counter block, i.e, nonce followed by the counter
+    /// \param counterSize Number of trailing bytes of counter block that make the counter (1 to 16),
+    /// the rest is nonce and never changes. Counter wraps around within these bytes
+    /// \return Cipher text byte array of same length as input
+    ///
+    ByteArray encryptCtr(const ByteArray& input, const Key* key, const ByteArray& counterBlock, std::size_t counterSize = 16);
+
+    ///
+    /// \brief Deciphers with CTR-Mode
+    /// \see encryptCtr()
+    ///
+    ByteArray decryptCtr(const ByteArray& input, const Key* key, const ByteArray& counterBlock, std::size_t counterSize = 16);
+
+    ByteArray encrCtr(const ByteArray& input, const ByteArray& counterBlock, std::size_t counterSize = 16) const;
+
+    ByteArray decrCtr(const ByteArray& input, const ByteArray& counterBlock, std::size_t counterSize = 16) const;
+
+    ///
+    /// \brief Ciphers with CTR-Mode writing to caller's buffer. Key stream is generated
+    /// on up to threadCount() threads for large input
+    /// \param output Buffer of at least length bytes, can be same as input
+    /// \param blockOffset Block of the key stream to start from, i.e, counter block is
+    /// incremented this many times first. This allows to process any part of the stream
+    /// \see encryptCtr()
+    ///
+    void encrCtr(const byte* input, std::size_t length, byte* output, const byte* counterBlock, std::size_t counterSize = 16, uint64_t blockOffset = 0) const;
 
-    ByteArray decr(const ByteArray& input);
+    void decrCtr(const byte* input, std::size_t length, byte* output, const byte* counterBlock, std::size_t counterSize = 16, uint64_t blockOffset = 0) const;
 
-    ByteArray encr(const ByteArray& input, ByteArray& iv, bool pkcs5Padding = true);
+    // CFB-Mode and OFB-Mode, there is no padding and input can be of any length
 
-    ByteArray decr(const ByteArray& input, ByteArray& iv);
+    ///
+    /// \brief Ciphers with CFB-Mode (NIST SP 800-38A Sec. 6.3)
+    /// \param input Plain input of any length, last segment can be partial
+    /// \param key Pointer to a valid AES key
+    /// \param iv Initialization vector of block size
+    /// \param segmentSize Size of segment in bytes (1 to 16), i.e, 16 for CFB-128 (default) and 1 for CFB-8.
+    /// Each segment needs one block cipher so smaller segments are slower
+    /// \return Cipher text byte array of same length as input
+    ///
+    ByteArray encryptCfb(const ByteArray& input, const Key* key, const ByteArray& iv, std::size_t segmentSize = 16);
+
+    ///
+    /// \brief Deciphers with CFB-Mode
+    /// \see encryptCfb()
+    ///
+    ByteArray decryptCfb(const ByteArray& input, const Key* key, const ByteArray& iv, std::size_t segmentSize = 16);
+
+    ByteArray encrCfb(const ByteArray& input, const ByteArray& iv, std::size_t segmentSize = 16) const;
+
+    ByteArray decrCfb(const ByteArray& input, const ByteArray& iv, std::size_t segmentSize = 16) const;
+
+    ///
+    /// \brief Ciphers with CFB-Mode writing to caller's buffer
+    /// \param output Buffer of at least length bytes, can be same as input
+    /// \see encryptCfb()
+    ///
+    void encrCfb(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t segmentSize = 16) const;
+
+    ///
+    /// \brief Deciphers with CFB-Mode writing to caller's buffer. Segments do not depend on each other
+    /// when deciphering so they are deciphered in batches, on up to threadCount() threads for large input
+    /// \param output Buffer of at least length bytes, can be same as input
+    /// \see encryptCfb()
+    ///
+    void decrCfb(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t segmentSize = 16) const;
+
+    ///
+    /// \brief Ciphers with OFB-Mode (NIST SP 800-38A Sec. 6.4), decryption is same as encryption
+    /// \param input Plain input of any length
+    /// \param key Pointer to a valid AES key
+    /// \param iv Initialization vector of block size, never use same IV twice with a key
+    /// \return Cipher text byte array of same length as input
+    ///
+    ByteArray encryptOfb(const ByteArray& input, const Key* key, const ByteArray& iv);
+
+    ///
+    /// \brief Deciphers with OFB-Mode
+    /// \see encryptOfb()
+    ///
+    ByteArray decryptOfb(const ByteArray& input, const Key* key, const ByteArray& iv);
+
+    ByteArray encrOfb(const ByteArray& input, const ByteArray& iv) const;
+
+    ByteArray decrOfb(const ByteArray& input, const ByteArray& iv) const;
+
+    ///
+    /// \brief Ciphers with OFB-Mode writing to caller's buffer
+    /// \param output Buffer of at least length bytes, can be same as input
+    /// \see encryptOfb()
+    ///
+    void encrOfb(const byte* input, std::size_t length, byte* output, const byte* iv) const;
+
+    void decrOfb(const byte* input, std::size_t length, byte* output, const byte* iv) const;
+
+    ///
+    /// \brief OFB-Mode key stream for iv. It does not depend on input so it can be made
+    /// ahead of time, input of up to length bytes is then ciphered (or deciphered) by
+    /// xor with key stream, same as encrOfb()
+    /// \param keyStream Buffer of at least length bytes
+    ///
+    void ofbKeyStream(const byte* iv, std::size_t length, byte* keyStream) const;
+
+    // GCM-Mode, authenticated encryption
+
+    ///
+    /// \brief Ciphers and authenticates with GCM-Mode (NIST SP 800-38D)
+    /// \param input Plain input of any length
+    /// \param key Pointer to a valid AES key
+    /// \param iv Initialization vector, passed by reference. If empty a random 96-bit IV is generated and passed in.
+    /// Any non-empty length is accepted but 96-bit is recommended, never use same IV twice with a key
+    /// \param aad Additional authenticated data, it's authenticated but not ciphered
+    /// \param tag Authentication tag, resized to tagSize
+    /// \param tagSize Size of tag in bytes, 16 (default), 15, 14, 13, 12, 8 or 4
+    /// \return Cipher text byte array of same length as input
+    ///
+    ByteArray encryptGcm(const ByteArray& input, const Key* key, ByteArray& iv, const ByteArray& aad, ByteArray& tag, std::size_t tagSize = 16);
+
+    ///
+    /// \brief Deciphers and verifies with GCM-Mode
+    /// \param tag Authentication tag from encryptGcm()
+    /// \throws std::runtime_error if authentication fails
+    /// \see encryptGcm()
+    ///
+    ByteArray decryptGcm(const ByteArray& input, const Key* key, const ByteArray& iv, const ByteArray& aad, const ByteArray& tag);
+
+    ByteArray encrGcm(const ByteArray& input, ByteArray& iv, const ByteArray& aad, ByteArray& tag, std::size_t tagSize = 16) const;
+
+    ByteArray decrGcm(const ByteArray& input, const ByteArray& iv, const ByteArray& aad, const ByteArray& tag) const;
+
+    ///
+    /// \brief Ciphers and authenticates with GCM-Mode writing to caller's buffer
+    /// \param output Buffer of at least length bytes, can be same as input
+    /// \param tag Buffer of at least tagSize bytes
+    /// \see encryptGcm()
+    ///
+    void encrGcm(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t ivSize, const byte* aad, std::size_t aadSize, byte* tag, std::size_t tagSize = 16) const;
+
+    ///
+    /// \brief Deciphers and verifies with GCM-Mode writing to caller's buffer. Output
+    /// is zeroed if authentication fails
+    /// \throws std::runtime_error if authentication fails
+    /// \see decryptGcm()
+    ///
+    void decrGcm(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t ivSize, const byte* aad, std::size_t aadSize, const byte* tag, std::size_t tagSize = 16) const;
+
+    // CCM-Mode, authenticated encryption
+
+    ///
+    /// \brief Ciphers and authenticates with CCM-Mode (NIST SP 800-38C). CBC-MAC and
+    /// CTR-Mode run in one pass over the input
+    /// \param input Plain input of any length that fits in 15 - nonce size bytes
+    /// \param key Pointer to a valid AES key
+    /// \param nonce Nonce, passed by reference. If empty a random 96-bit nonce is generated and passed in.
+    /// It should be 7 to 13 bytes, never use same nonce twice with a key
+    /// \param aad Additional authenticated data, it's authenticated but not ciphered
+    /// \param tag Authentication tag, resized to tagSize
+    /// \param tagSize Size of tag in bytes, 4, 6, 8, 10, 12, 14 or 16 (default)
+    /// \return Cipher text byte array of same length as input
+    ///
+    ByteArray encryptCcm(const ByteArray& input, const Key* key, ByteArray& nonce, const ByteArray& aad, ByteArray& tag, std::size_t tagSize = 16);
+
+    ///
+    /// \brief Deciphers and verifies with CCM-Mode
+    /// \param tag Authentication tag from encryptCcm()
+    /// \throws std::runtime_error if authentication fails
+    /// \see encryptCcm()
+    ///
+    ByteArray decryptCcm(const ByteArray& input, const Key* key, const ByteArray& nonce, const ByteArray& aad, const ByteArray& tag);
+
+    ByteArray encrCcm(const ByteArray& input, ByteArray& nonce, const ByteArray& aad, ByteArray& tag, std::size_t tagSize = 16) const;
+
+    ByteArray decrCcm(const ByteArray& input, const ByteArray& nonce, const ByteArray& aad, const ByteArray& tag) const;
+
+    ///
+    /// \brief Ciphers and authenticates with CCM-Mode writing to caller's buffer
+    /// \param output Buffer of at least length bytes, can be same as input
+    /// \param tag Buffer of at least tagSize bytes
+    /// \see encryptCcm()
+    ///
+    void encrCcm(const byte* input, std::size_t length, byte* output, const byte* nonce, std::size_t nonceSize, const byte* aad, std::size_t aadSize, byte* tag, std::size_t tagSize = 16) const;
+
+    ///
+    /// \brief Deciphers and verifies with CCM-Mode writing to caller's buffer. Output
+    /// is zeroed if authentication fails
+    /// \throws std::runtime_error if authentication fails
+    /// \see decryptCcm()
+    ///
+    void decrCcm(const byte* input, std::size_t length, byte* output, const byte* nonce, std::size_t nonceSize, const byte* aad, std::size_t aadSize, const byte* tag, std::size_t tagSize = 16) const;
+
+    // XTS-Mode, for storage where each sector (data unit) is ciphered independently
+
+    ///
+    /// \brief Ciphers consecutive sectors with XTS-AES (IEEE Std 1619, NIST SP 800-38E)
+    /// \param input Plain input of one or more sectors, last sector can be shorter but at least 128-bit.
+    /// Partial block at the end of a sector is handled with ciphertext stealing
+    /// \param key Pointer to a valid XTS key, i.e, 256-bit (two AES-128 keys) or 512-bit (two AES-256 keys),
+    /// first half ciphers the data and second half ciphers the tweak. Halves must be different
+    /// \param sector Number of first sector (data unit sequence number), next sector is sector + 1 and so on
+    /// \param sectorSize Size of each sector in bytes, at least 16
+    /// \return Cipher text byte array of same length as input
+    ///
+    ByteArray encryptXts(const ByteArray& input, const Key* key, uint64_t sector, std::size_t sectorSize = 512);
+
+    ///
+    /// \brief Deciphers consecutive sectors with XTS-AES
+    /// \see encryptXts()
+    ///
+    ByteArray decryptXts(const ByteArray& input, const Key* key, uint64_t sector, std::size_t sectorSize = 512);
+
+    ///
+    /// \brief Ciphers with XTS-Mode writing to caller's buffer, key of this instance ciphers the data.
+    /// Sectors are ciphered on up to threadCount() threads for large input
+    /// \param output Buffer of at least length bytes, can be same as input
+    /// \param tweakKey Pointer to AES key for tweak, of same size as key and different from it.
+    /// It is expanded on every call unless it is the tweak key of last encryptXts() or decryptXts()
+    /// \see encryptXts()
+    ///
+    void encrXts(const byte* input, std::size_t length, byte* output, const Key* tweakKey, uint64_t sector, std::size_t sectorSize = 512) const;
+
+    void decrXts(const byte* input, std::size_t length, byte* output, const Key* tweakKey, uint64_t sector, std::size_t sectorSize = 512) const;
+
+    // SIV-Mode, deterministic authenticated encryption
+
+    ///
+    /// \brief Ciphers and authenticates with SIV-Mode (RFC 5297). Same input and associated
+    /// data always give same result, e.g, to deduplicate ciphered data, so it only leaks
+    /// whether two inputs are same. Add a random nonce as last associated data otherwise
+    /// \param input Plain input of any length
+    /// \param key Pointer to a valid SIV key, i.e, 256-bit, 384-bit or 512-bit (two AES keys), first half
+    /// authenticates (S2V) and second half ciphers (CTR-Mode)
+    /// \param aad Associated data, up to 126 items, they're authenticated but not ciphered
+    /// \return Synthetic IV (128-bit) followed by cipher text, i.e, 16 bytes longer than input
+    ///
+    ByteArray encryptSiv(const ByteArray& input, const Key* key, const std::vector<ByteArray>& aad = std::vector<ByteArray>());
+
+    ///
+    /// \brief Deciphers and verifies with SIV-Mode
+    /// \param input Synthetic IV followed by cipher text, from encryptSiv()
+    /// \throws std::runtime_error if authentication fails
+    /// \see encryptSiv()
+    ///
+    ByteArray decryptSiv(const ByteArray& input, const Key* key, const std::vector<ByteArray>& aad = std::vector<ByteArray>());
+
+    ///
+    /// \brief Ciphers with SIV-Mode writing to caller's buffer, key of this instance authenticates
+    /// \param output Buffer of at least length + 16 bytes, it should not overlap input
+    /// \param ctrKey Pointer to AES key for CTR-Mode, of same size as key. It is expanded
+    /// on every call unless it is the CTR key of last encryptSiv() or decryptSiv()
+    /// \param aad Pointers to aadCount associated data items, aadSizes has their sizes
+    /// \see encryptSiv()
+    ///
+    void encrSiv(const byte* input, std::size_t length, byte* output, const Key* ctrKey, const byte* const* aad = nullptr, const std::size_t* aadSizes = nullptr, std::size_t aadCount = 0) const;
+
+    ///
+    /// \brief Deciphers and verifies with SIV-Mode writing to caller's buffer. Output
+    /// is zeroed if authentication fails
+    /// \param length Length of input, i.e, synthetic IV and cipher text
+    /// \param output Buffer of at least length - 16 bytes, it should not overlap input
+    /// \throws std::runtime_error if authentication fails
+    /// \see encrSiv()
+    ///
+    void decrSiv(const byte* input, std::size_t length, byte* output, const Key* ctrKey, const byte* const* aad = nullptr, const std::size_t* aadSizes = nullptr, std::size_t aadCount = 0) const;
+
+    ///
+    /// \brief Ciphers many inputs (e.g, chunks of storage) with SIV-Mode without associated
+    /// data, same as encrSiv() for each. S2V chains of up to eight inputs are interleaved and
+    /// CMAC of zero block is computed once for the batch
+    /// \param messages Inputs with output of at least length + 16 bytes, iv is not used
+    ///
+    void encrSivBatch(const Message* messages, std::size_t count, const Key* ctrKey) const;
+
+    ///
+    /// \brief Deciphers and verifies many inputs ciphered with encrSivBatch()
+    /// \param messages Inputs (synthetic IV and cipher text) with output of at least length - 16 bytes, iv is not used
+    /// \param authentic Whether each input is authentic, output of the one that is not is zeroed
+    /// \return Whether all the inputs are authentic
+    ///
+    bool decrSivBatch(const Message* messages, std::size_t count, const Key* ctrKey, bool* authentic) const;
+
+    // CMAC, message authentication code
+
+    ///
+    /// \brief Authenticates message with CMAC (NIST SP 800-38B, RFC 4493). Subkeys K1 and K2
+    /// are derived once for a key and reused for next messages
+    /// \param input Message of any length
+    /// \param key Pointer to a valid AES key
+    /// \param tagSize Size of tag in bytes (1 to 16), it's truncated from left. At least 8 is recommended
+    /// \return Authentication tag of tagSize bytes
+    /// \see AESCmac for message in multiple chunks
+    ///
+    ByteArray cmac(const ByteArray& input, const Key* key, std::size_t tagSize = 16);
+
+    ///
+    /// \brief Verifies CMAC tag of message in constant time
+    /// \param tag Tag from cmac(), of 1 to 16 bytes
+    /// \return Whether tag is authentic
+    ///
+    bool verifyCmac(const ByteArray& input, const Key* key, const ByteArray& tag);
+
+    ///
+    /// \brief Authenticates message with CMAC writing tag to caller's buffer
+    /// \param tag Buffer of at least tagSize bytes
+    /// \see cmac()
+    ///
+    void cmac(const byte* input, std::size_t length, byte* tag, std::size_t tagSize = 16) const;
+
+    bool verifyCmac(const byte* input, std::size_t length, const byte* tag, std::size_t tagSize = 16) const;
+
+    // Key wrap, to store keys ciphered with a key-encryption key (KEK)
+
+    ///
+    /// \brief Wraps key data with AES Key Wrap (RFC 3394, KW in NIST SP 800-38F) or with
+    /// AES Key Wrap with Padding (RFC 5649, KWP)
+    /// \param input Key data, without padding it should be multiple of 64-bit and at least 128-bit.
+    /// With padding it can be of any length from 1 byte
+    /// \param kek Pointer to a valid AES key that wraps the key data
+    /// \param padding Whether to use key wrap with padding
+    /// \return Wrapped key of wrappedKeySize() bytes
+    ///
+    ByteArray wrapKey(const ByteArray& input, const Key* kek, bool padding = false);
+
+    ///
+    /// \brief Unwraps key data wrapped with wrapKey()
+    /// \param padding Whether key was wrapped with padding
+    /// \throws std::runtime_error if integrity check fails
+    /// \see wrapKey()
+    ///
+    ByteArray unwrapKey(const ByteArray& input, const Key* kek, bool padding = false);
+
+    ///
+    /// \brief Size of wrapped key for key data of length bytes
+    ///
+    static std::size_t wrappedKeySize(std::size_t length, bool padding = false);
+
+    ///
+    /// \brief Wraps key data writing to caller's buffer, key of this instance is the KEK
+    /// \param output Buffer of at least wrappedKeySize(length, padding) bytes, must not overlap input
+    /// \return Number of bytes written to output
+    /// \see wrapKey()
+    ///
+    std::size_t wrapKey(const byte* input, std::size_t length, byte* output, bool padding = false) const;
+
+    ///
+    /// \brief Unwraps key data writing to caller's buffer, key of this instance is the KEK.
+    /// Output is zeroed if integrity check fails
+    /// \param output Buffer of at least length - 8 bytes, can be same as input
+    /// \return Length of key data
+    /// \throws std::runtime_error if integrity check fails
+    /// \see unwrapKey()
+    ///
+    std::size_t unwrapKey(const byte* input, std::size_t length, byte* output, bool padding = false) const;
+
+    ///
+    /// \brief Unwraps many keys wrapped with key of this instance, same as unwrapKey() for each
+    /// key. Up to eight keys are unwrapped together so engine always has multiple blocks to
+    /// decipher at a time, this is much faster than one key at a time
+    /// \param messages Wrapped keys with output of at least length - 8 bytes, iv is not used
+    /// \param lengths Length of each unwrapped key, 0 if its integrity check fails (its output is zeroed)
+    /// \return Whether all the keys passed integrity check
+    ///
+    bool unwrapKeyBatch(const Message* messages, std::size_t count, std::size_t* lengths, bool padding = false) const;
 
 private:
 
@@ -168,25 +729,48 @@ private:
     using Word = std::array<byte, 4>;
 
     ///
-    /// \brief KeySchedule is linear array of 4-byte words
+    /// \brief KeySchedule is linear array of words w[i] packed as
+    /// big-endian 32-bit integers, round r uses w[Nb * r] to w[Nb * r + 3]
+    ///
+    /// It is sized for the largest schedule, i.e, Nb * (14 + 1) for
+    /// 256-bit keys, unused words are zero
     /// \ref FIPS.197 Sec 5.2
     ///
-    using KeySchedule = std::map<uint8_t, Word>;
+    using KeySchedule = std::array<uint32_t, 60>;
 
     ///
     /// \brief State as described in FIPS.197 Sec. 3.4
     ///
     using State = std::array<Word, 4>;
 
+    ///
+    /// \brief Hash subkey H = CIPH(0^128) with precomputed values for ghash()
+    /// \ref NIST SP 800-38D Sec. 6.4
+    ///
+    struct GHashKey {
+        // H multiplied by each 4-bit value (as big-endian halves) for portable multiplication
+        uint64_t table[16][2];
+
+        // H, H^2, H^3 and H^4 byte reversed, for carry-less multiplication
+        alignas(16) byte powers[64];
+
+        // whether to use PCLMULQDQ
+        bool carryless;
+
+        // whether to multiply bit by bit without lookups
+        bool constantTime;
+    };
+
     ///
     /// \brief AES works on 16 bit block at a time
     ///
     static const uint8_t kBlockSize = 16;
 
     ///
-    /// \brief Defines the key params to it's size
+    /// \brief Number of rounds (Nr) for the key size
+    /// \throws std::invalid_argument if key size is invalid
     ///
-    static const std::unordered_map<uint8_t, std::vector<uint8_t>> kKeyParams;
+    static uint8_t roundsForKey(std::size_t keySize);
 
     ///
     /// \brief As defined in FIPS. 197 Sec. 5.1.1
@@ -207,6 +791,28 @@ private:
     ///
     static const byte kRoundConstant[];
 
+    ///
+    /// \brief Round tables for the cipher. Each entry combines
+    /// SubBytes(), ShiftRows() and MixColumns() for a single
+    /// byte of the state so a round is sixteen lookups and xors
+    /// on 32-bit words. kTe1, kTe2 and kTe3 are kTe0 rotated
+    /// right by 8, 16 and 24 bits respectively
+    /// \ref Sec. 4.2 of "The Design of Rijndael" (Daemen & Rijmen)
+    ///
+    static const uint32_t kTe0[];
+    static const uint32_t kTe1[];
+    static const uint32_t kTe2[];
+    static const uint32_t kTe3[];
+
+    ///
+    /// \brief Round tables for the inverse cipher, same as kTe0..kTe3 but
+    /// combining InvSubBytes() and InvMixColumns()
+    ///
+    static const uint32_t kTd0[];
+    static const uint32_t kTd1[];
+    static const uint32_t kTd2[];
+    static const uint32_t kTd3[];
+
     ///
     /// \brief Nb
     /// \note we make it constant as FIPS.197 p.9 says
@@ -214,6 +820,12 @@ private:
     ///
     static const uint8_t kNb = 4;
 
+    ///
+    /// \brief Minimum number of blocks (64 KiB) for each thread in parallelized modes,
+    /// smaller input is not worth starting threads for
+    ///
+    static const std::size_t kMinBlocksPerThread = 4096;
+
 
     /// rotateWord function is specified in FIPS.197 Sec. 5.2:
     ///      The function RotWord() takes a
@@ -230,7 +842,7 @@ private:
     ///           [a3]  =>  [a4]
     ///           [a4]      [a1]
     ///
-    static void rotateWord(Word* w);
+    static void rotateWord(uint32_t* w);
 
     /// this function is also specified in FIPS.197 Sec. 5.2:
     ///      SubWord() is a function that takes a four-byte
@@ -241,17 +853,29 @@ private:
     /// It's a simple substition with kSbox for corresponding byte
     /// index
     ///
-    static void substituteWord(Word* w);
+    static void substituteWord(uint32_t* w);
+
+    ///
+    /// \brief Whether engine() uses AES-NI instructions, i.e, AesNi or Vaes
+    ///
+    static bool aesNiEngine();
 
     ///
     /// \brief Key expansion function as described in FIPS.197
     ///
     static KeySchedule keyExpansion(const Key* key);
 
+    ///
+    /// \brief Key schedule and inverse key schedule for key, from key schedule cache
+    /// if enabled otherwise using keyExpansion() and toInverseKeySchedule()
+    /// \param inverseKeySchedule Null if only key schedule is needed, e.g, to encrypt
+    ///
+    static void expandKey(const Key* key, KeySchedule* keySchedule, KeySchedule* inverseKeySchedule);
+
     ///
     /// \brief Adds round to the state using specified key schedule
     ///
-    static void addRoundKey(State* state, KeySchedule* keySchedule, int round);
+    static void addRoundKey(State* state, const KeySchedule* keySchedule, int round);
 
     ///
     /// \brief Substitution step for state
@@ -319,19 +943,28 @@ private:
     static void initState(State* state, const ByteArray::const_iterator& begin);
 
     ///
-    /// \brief Creates byte array from input based on input mode
+    /// \brief Creates byte array from input based on input mode, decoded straight in to
+    /// the array. It has space for extra bytes after input (e.g, padding) so it can be
+    /// ciphered in place without growing
     ///
-    static ByteArray resolveInputMode(const std::string& input, MineCommon::Encoding inputMode);
+    static ByteArray resolveInputMode(const std::string& input, MineCommon::Encoding inputMode, std::size_t extra = 0);
 
     ///
-    /// \brief Creates string from byte array based on convert mode
+    /// \brief Creates string from length bytes based on convert mode, encoded straight in to
+    /// the string that is allocated once
     ///
-    static std::string resolveOutputMode(const ByteArray& input, MineCommon::Encoding outputMode);
+    static std::string resolveOutputMode(const byte* input, std::size_t length, MineCommon::Encoding outputMode);
 
     ///
-    /// \brief Exclusive XOR with iter of range size as input
+    /// \brief Exclusive XOR of 128-bit block with another block
     ///
-    static ByteArray* xorWithRange(ByteArray* input, const ByteArray::const_iterator& begin, const ByteArray::const_iterator& end);
+    static void xorBlock(byte* block, const byte* with);
+
+    ///
+    /// \brief Copies input of length (less than block size) to block
+    /// and fills the rest with PKCS#5 padding or zeros
+    ///
+    static void padBlock(const byte* input, std::size_t length, byte* block, bool pkcs5Padding);
 
     ///
     /// \brief Raw encryption function - not for public use
@@ -356,6 +989,228 @@ private:
     ///
     static ByteArray decryptSingleBlock(const ByteArray::const_iterator& range, const Key* key, KeySchedule* keySchedule);
 
+    ///
+    /// \brief Creates key schedule for decryptBlock() from key schedule.
+    /// The order of round keys is reversed and InvMixColumns() is applied
+    /// to all but first and last round key
+    /// \ref Sec. 5.3.5 (Equivalent Inverse Cipher)
+    ///
+    static void toInverseKeySchedule(const KeySchedule* keySchedule, uint8_t rounds, KeySchedule* inverseKeySchedule);
+
+    ///
+    /// \brief Ciphers single 128-bit block using round tables
+    /// \param input 16 bytes to cipher
+    /// \param output 16 bytes of output, can be same as input
+    /// \param keySchedule Key schedule from keyExpansion()
+    /// \param rounds Nr (10, 12 or 14)
+    ///
+    static void encryptBlock(const byte* input, byte* output, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Deciphers single 128-bit block using inverse round tables
+    /// \param inverseKeySchedule Key schedule from toInverseKeySchedule()
+    /// \see encryptBlock()
+    ///
+    static void decryptBlock(const byte* input, byte* output, const KeySchedule* inverseKeySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers contiguous 128-bit blocks independently (ECB) using engine()
+    /// \param output Can be same as input
+    ///
+    static void encryptBlocks(const byte* input, byte* output, std::size_t blocks, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Deciphers contiguous 128-bit blocks independently (ECB) using engine()
+    /// \see encryptBlocks()
+    ///
+    static void decryptBlocks(const byte* input, byte* output, std::size_t blocks, const KeySchedule* inverseKeySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers contiguous 128-bit blocks with CBC-Mode using engine()
+    /// \param iv Chaining value, it's updated to last cipher block
+    /// \see encryptBlocks()
+    ///
+    static void encryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers blocks of up to eight independent CBC-Mode chains (lanes) together using engine()
+    /// \param inputs Input of each lane, at least blocks long
+    /// \param chains Chaining value of each lane, updated to last cipher block
+    /// \see encryptCbcBlocks()
+    ///
+    static void encryptCbcLanes(const byte* const* inputs, byte* const* outputs, byte* const* chains, std::size_t lanes, std::size_t blocks, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Same as encryptCbcLanes() with own key schedule for each lane, all keys of same size
+    /// \param keySchedules Key schedule of each lane
+    ///
+    static void encryptCbcKeyedLanes(const byte* const* inputs, byte* const* outputs, byte* const* chains, std::size_t lanes, std::size_t blocks, const KeySchedule* const* keySchedules, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers independent messages with CBC-Mode in lanes of eight
+    /// \param keySchedules Key schedule of each message (all keys of same size), if null all the
+    /// messages use keySchedule
+    /// \see encrCbcBatch()
+    ///
+    static void cbcBatch(const Message* messages, std::size_t count, bool pkcs5Padding, const KeySchedule* keySchedule, const KeySchedule* const* keySchedules, uint8_t rounds);
+
+    ///
+    /// \brief Deciphers contiguous 128-bit blocks with CBC-Mode using engine()
+    /// \param iv Chaining value, it's updated to last cipher block
+    /// \see decryptBlocks()
+    ///
+    static void decryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const KeySchedule* inverseKeySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Adds value to the counter, i.e, last counterSize bytes of counter block
+    /// as big-endian integer, modulo 2^(8 * counterSize)
+    ///
+    static void incrementCounter(byte* counterBlock, std::size_t counterSize, uint64_t value);
+
+    ///
+    /// \brief Ciphers contiguous 128-bit blocks with CTR-Mode using engine()
+    /// \param counterBlock Counter block for first block, it's updated to the one after last block
+    /// \see encryptBlocks()
+    ///
+    static void ctrBlocks(const byte* input, byte* output, std::size_t blocks, byte* counterBlock, std::size_t counterSize, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers with CFB-Mode using engine()
+    /// \ref NIST SP 800-38A Sec. 6.3
+    ///
+    static void cfbEncrypt(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t segmentSize, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Deciphers consecutive segments with CFB-Mode using engine()
+    /// \param history Last 128-bit of cipher text before input, or IV for first segment
+    /// \see cfbEncrypt()
+    ///
+    static void cfbDecrypt(const byte* input, std::size_t length, byte* output, const byte* history, std::size_t segmentSize, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief CMAC subkeys K1 followed by K2
+    /// \ref RFC 4493 Sec. 2.3
+    ///
+    static void cmacSubkeys(const KeySchedule* keySchedule, uint8_t rounds, byte* subkeys);
+
+    ///
+    /// \brief Updates CBC-MAC chain with complete blocks that are not the last block of message
+    ///
+    static void cmacBlocks(const byte* input, std::size_t blocks, byte* chain, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Updates CBC-MAC chain with last block of message, chain is then the tag
+    /// \param lastSize Bytes in last block, 0 to 16. Incomplete block is padded
+    /// \ref RFC 4493 Sec. 2.4
+    ///
+    static void cmacFinal(const byte* lastBlock, std::size_t lastSize, byte* chain, const byte* subkeys, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Number of blocks in each chunk for parallelBlocks(), at least kMinBlocksPerThread
+    /// so there are up to threadCount() chunks. All the chunks are of this size except the
+    /// last one. Same as blocks if there is single chunk
+    ///
+    static std::size_t chunkBlocks(std::size_t blocks);
+
+    ///
+    /// \brief Splits blocks in to contiguous chunks and calls func(firstBlock, blocks) for each
+    /// chunk on its own thread. The first chunk runs on calling thread, returns when all the
+    /// chunks are done
+    /// \param chunk Blocks in each chunk, from chunkBlocks()
+    ///
+    static void parallelBlocks(std::size_t blocks, std::size_t chunk, const std::function<void(std::size_t, std::size_t)>& func);
+
+    ///
+    /// \brief Prepares GHASH key for hash subkey h
+    ///
+    static void initGHashKey(const byte* h, GHashKey* ghashKey);
+
+    ///
+    /// \brief Updates GHASH value y with data, last partial block is padded with zeros
+    /// \ref NIST SP 800-38D Sec. 6.4
+    ///
+    static void ghash(byte* y, const GHashKey* ghashKey, const byte* data, std::size_t length);
+
+    ///
+    /// \brief GCM authenticated encryption / decryption in one pass, each chunk
+    /// of data is hashed while it's still in cache
+    /// \param tag Full 128-bit tag
+    /// \ref NIST SP 800-38D Sec. 7.1 and Sec. 7.2
+    ///
+    static void gcm(const byte* input, std::size_t length, byte* output, const byte* iv, std::size_t ivSize, const byte* aad, std::size_t aadSize, byte* tag, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers (or deciphers) full blocks with CTR-Mode and updates CBC-MAC of
+    /// plain blocks in the same loop, so the two independent chains are in flight at once
+    /// \param mac CBC-MAC chain, it's updated
+    /// \param counterBlock Counter block for first block, it's updated to the one after last block
+    ///
+    static void ccmBlocks(const byte* input, byte* output, std::size_t blocks, byte* mac, byte* counterBlock, std::size_t counterSize, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief CCM generation-encryption / decryption-verification in one pass
+    /// \param tag Full 128-bit tag, caller truncates it
+    /// \ref NIST SP 800-38C Sec. 6.1, Sec. 6.2 and Appendix A
+    ///
+    static void ccm(const byte* input, std::size_t length, byte* output, const byte* nonce, std::size_t nonceSize, const byte* aad, std::size_t aadSize, byte* tag, std::size_t tagSize, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers or deciphers single sector (data unit) with XTS-Mode
+    /// \param tweak Ciphered tweak of the sector, it's updated
+    /// \param keySchedule Key schedule, or inverse key schedule if decrypting
+    /// \ref IEEE Std 1619-2007 Sec. 5.3 and 5.4
+    ///
+    static void xtsSector(const byte* input, std::size_t length, byte* output, byte* tweak, bool decrypting, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Expands second key of two-key modes (tweak key of XTS-Mode, CTR key of
+    /// SIV-Mode) and keeps it for next call
+    ///
+    void setSecondKey(const Key& secondKey);
+
+    ///
+    /// \brief Key schedule of second key, the kept one or key expanded in to other
+    /// for the call only so instance is not changed
+    ///
+    const KeySchedule* secondKeySchedule(const Key* secondKey, KeySchedule* other) const;
+
+    ///
+    /// \brief XTS-Mode for consecutive sectors on up to threadCount() threads.
+    /// Tweak key other than the kept one is expanded for the call only
+    ///
+    void xts(const byte* input, std::size_t length, byte* output, const Key* tweakKey, uint64_t sector, std::size_t sectorSize, bool decrypting) const;
+
+    ///
+    /// \brief Number of leading blocks of last S2V string that are authenticated as is, the
+    /// rest is xor'ed with (or padded for) S2V value before it's authenticated
+    ///
+    static std::size_t s2vLeadingBlocks(std::size_t length);
+
+    ///
+    /// \brief Finishes S2V with last string after its leading blocks
+    /// \param chain CMAC chain after s2vLeadingBlocks() blocks of input, it's updated to synthetic IV
+    /// \param d S2V value of associated data, it's changed
+    /// \ref RFC 5297 Sec. 2.4
+    ///
+    static void s2vFinal(const byte* input, std::size_t length, byte* chain, byte* d, const byte* subkeys, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief Ciphers (or deciphers) with CTR-Mode using synthetic IV as counter block
+    /// \ref RFC 5297 Sec. 2.5
+    ///
+    static void sivCtr(const byte* input, std::size_t length, byte* output, const byte* v, const KeySchedule* keySchedule, uint8_t rounds);
+
+    ///
+    /// \brief S2V of associated data and input, i.e, synthetic IV
+    ///
+    void s2v(const byte* input, std::size_t length, const byte* const* aad, const std::size_t* aadSizes, std::size_t aadCount, byte* v) const;
+
+    ///
+    /// \brief Runs S2V of many inputs in interleaved chains, decrypting deciphers
+    /// all the inputs first
+    ///
+    bool sivBatch(const Message* messages, std::size_t count, const Key* ctrKey, bool decrypting, bool* authentic) const;
+
     ///
     /// \brief Converts 4x4 byte state matrix in to linear 128-bit byte array
     ///
@@ -363,11 +1218,29 @@ private:
 
     ///
     /// \brief Get padding index for stripping the padding (unpadding)
+    /// \param block Last 128-bit block of plain text
     ///
-    static std::size_t getPaddingIndex(const ByteArray& byteArr);
+    static std::size_t getPaddingIndex(const byte* block);
+
+    ///
+    /// \brief Compares authentication tags in constant time, i.e, all the bytes are
+    /// compared so time does not depend on where tags differ
+    ///
+    static bool tagsEqual(const byte* a, const byte* b, std::size_t size);
 
     Key m_key; // to keep track of key differences
-    KeySchedule m_keySchedule;
+    uint8_t m_rounds = 0;
+    alignas(16) KeySchedule m_keySchedule = {};
+
+    // key schedule for decryption, computed with m_keySchedule
+    alignas(16) KeySchedule m_inverseKeySchedule = {};
+
+    // second key of two-key modes (XTS tweak key, SIV CTR key), kept for next call
+    Key m_secondKey;
+    alignas(16) KeySchedule m_secondKeySchedule = {};
+
+    // CMAC subkeys K1 and K2, derived when key is set
+    byte m_cmacSubkeys[2 * kBlockSize] = {};
 
     // for tests
     friend class AESTest_RawCipher_Test;
@@ -385,6 +1258,224 @@ private:
     friend class AESTest_AddRoundKey_Test;
     friend class AESTest_CbcCipher_Test;
     friend class AESTest_Copy_Test;
+    friend class AESTest_RoundTables_Test;
+    friend class AESTest_CompileTimeCipher_Test;
+    friend class AESTest_Engines_Test;
+    friend class AESTest_CtrCipher_Test;
+    friend class AESTest_GcmCipher_Test;
+    friend class AESTest_CbcDecipherParallel_Test;
+    friend class AESTest_InverseKeySchedule_Test;
+    friend class AESTest_KeyScheduleCache_Test;
+    friend class AESTest_XtsCipher_Test;
+    friend class AESTest_CfbOfbCipher_Test;
+    friend class AESTest_Cmac_Test;
+    friend class AESTest_SharedContext_Test;
+
+    friend class AESEncryptor;
+    friend class AESDecryptor;
+    friend class AESCmac;
+    template <unsigned int> friend class AESCipher;
+};
+
+///
+/// \brief AES block cipher on T-tables with key size fixed at compile time
+///
+/// Round count and key schedule size are constants and rounds are
+/// unrolled, AES switches on round count once per call to pick the instance.
+/// Round keys are AES::KeySchedule words (inverse key schedule for decryption)
+///
+template <unsigned int KeyBits>
+class AESCipher {
+    static_assert(KeyBits == 128 || KeyBits == 192 || KeyBits == 256, "AES key must be 128-bit, 192-bit or 256-bit");
+public:
+    /// \brief Number of 32-bit words in key (Nk)
+    static const uint8_t kKeyWords = KeyBits / 32;
+
+    /// \brief Number of rounds (Nr)
+    static const uint8_t kRounds = kKeyWords + 6;
+
+    /// \brief Number of 32-bit words in key schedule
+    static const uint8_t kScheduleWords = AES::kNb * (kRounds + 1);
+
+    static void encryptBlock(const byte* input, byte* output, const uint32_t* roundKeys);
+    static void decryptBlock(const byte* input, byte* output, const uint32_t* inverseRoundKeys);
+
+    static void encryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* roundKeys);
+    static void decryptBlocks(const byte* input, byte* output, std::size_t blocks, const uint32_t* inverseRoundKeys);
+
+    ///
+    /// \brief CBC chain over blocks, iv is updated to the last cipher block
+    ///
+    static void encryptCbcBlocks(const byte* input, byte* output, std::size_t blocks, byte* iv, const uint32_t* roundKeys);
+
+private:
+    AESCipher() = delete;
+
+    ///
+    /// \brief Intermediate round Round and the ones after it
+    ///
+    template <int Round>
+    static void encryptRounds(uint32_t* state, const uint32_t* roundKeys, std::integral_constant<int, Round>);
+    static void encryptRounds(uint32_t*, const uint32_t*, std::integral_constant<int, kRounds>) {}
+
+    template <int Round>
+    static void decryptRounds(uint32_t* state, const uint32_t* inverseRoundKeys, std::integral_constant<int, Round>);
+    static void decryptRounds(uint32_t*, const uint32_t*, std::integral_constant<int, kRounds>) {}
+};
+
+///
+/// \brief Ciphers a stream with ECB or CBC-Mode chunk by chunk, same as the byte buffer
+/// AES::encr(const byte*, ...) for whole input. With PKCS#5 padding, whole-block input
+/// always gets a full padding block unlike AES::encr(const ByteArray&, ...).
+/// Only the partial block is kept between calls so memory does not depend on the length
+/// of the stream
+///
+class AESEncryptor {
+public:
+    ///
+    /// \param key Valid AES key
+    /// \param iv 128-bit initialization vector for CBC-Mode, empty for ECB-Mode
+    /// \param pkcs5Padding Defaults to true, if false non-standard zero-padding is used
+    /// \throws std::invalid_argument if key or IV is invalid
+    ///
+    AESEncryptor(const AES::Key& key, const ByteArray& iv = ByteArray(), bool pkcs5Padding = true);
+
+    ///
+    /// \brief Ciphers next chunk of plain input
+    /// \return Cipher of all the complete blocks so far, may be empty
+    ///
+    ByteArray update(const ByteArray& input);
+
+    ///
+    /// \brief Ciphers the rest of input with padding, no more input is accepted afterwards
+    ///
+    ByteArray final();
+
+    ///
+    /// \brief Ciphers next chunk writing to caller's buffer
+    /// \param output Buffer of at least length + 15 bytes, must not overlap input
+    /// \return Number of bytes written to output
+    ///
+    std::size_t update(const byte* input, std::size_t length, byte* output);
+
+    ///
+    /// \brief Ciphers the rest of input writing to caller's buffer
+    /// \param output Buffer of at least 16 bytes
+    /// \return Number of bytes written to output
+    ///
+    std::size_t final(byte* output);
+
+private:
+    void cipherBlocks(const byte* input, byte* output, std::size_t blocks);
+
+    alignas(16) AES::KeySchedule m_keySchedule;
+    uint8_t m_rounds;
+    bool m_cbc;
+    bool m_pkcs5Padding;
+    bool m_finished;
+    byte m_chain[AES::kBlockSize];
+    byte m_buffer[AES::kBlockSize];
+    std::size_t m_bufferSize;
+};
+
+///
+/// \brief Deciphers a stream with ECB or CBC-Mode chunk by chunk, same as the byte buffer
+/// AES::decr(const byte*, ...) for whole input. Input must be padded as AESEncryptor does.
+/// Last block is held back until final() as it has the padding
+///
+class AESDecryptor {
+public:
+    ///
+    /// \param key Valid AES key
+    /// \param iv 128-bit initialization vector for CBC-Mode, empty for ECB-Mode
+    /// \throws std::invalid_argument if key or IV is invalid
+    ///
+    AESDecryptor(const AES::Key& key, const ByteArray& iv = ByteArray());
+
+    ///
+    /// \brief Deciphers next chunk of cipher
+    /// \return Plain text deciphered so far, may be empty
+    ///
+    ByteArray update(const ByteArray& input);
+
+    ///
+    /// \brief Deciphers last block and strips the padding, no more input is accepted afterwards
+    /// \throws std::invalid_argument if total length is not multiple of block size
+    ///
+    ByteArray final();
+
+    ///
+    /// \brief Deciphers next chunk writing to caller's buffer
+    /// \param output Buffer of at least length + 15 bytes, must not overlap input
+    /// \return Number of bytes written to output
+    ///
+    std::size_t update(const byte* input, std::size_t length, byte* output);
+
+    ///
+    /// \brief Deciphers last block writing to caller's buffer
+    /// \param output Buffer of at least 16 bytes
+    /// \return Number of bytes written to output excluding padding
+    ///
+    std::size_t final(byte* output);
+
+private:
+    void decipherBlocks(const byte* input, byte* output, std::size_t blocks);
+
+    alignas(16) AES::KeySchedule m_inverseKeySchedule;
+    uint8_t m_rounds;
+    bool m_cbc;
+    bool m_finished;
+    byte m_chain[AES::kBlockSize];
+    byte m_buffer[AES::kBlockSize];
+    std::size_t m_bufferSize;
+};
+
+///
+/// \brief Authenticates a message with CMAC chunk by chunk, same as AES::cmac()
+/// for whole message. Key schedule and subkeys are prepared once so reset()
+/// starts next message with no key setup
+///
+class AESCmac {
+public:
+    ///
+    /// \param key Valid AES key
+    /// \throws std::invalid_argument if key is invalid
+    ///
+    explicit AESCmac(const AES::Key& key);
+
+    ///
+    /// \brief Authenticates next chunk of message
+    ///
+    void update(const ByteArray& input);
+
+    ///
+    /// \brief Authenticates last chunk, no more input is accepted afterwards until reset()
+    /// \param tagSize Size of tag in bytes (1 to 16)
+    /// \return Authentication tag
+    ///
+    ByteArray final(std::size_t tagSize = 16);
+
+    void update(const byte* input, std::size_t length);
+
+    ///
+    /// \brief Writes tag to caller's buffer
+    /// \param tag Buffer of at least tagSize bytes
+    ///
+    void final(byte* tag, std::size_t tagSize = 16);
+
+    ///
+    /// \brief Starts a new message with same key
+    ///
+    void reset();
+
+private:
+    alignas(16) AES::KeySchedule m_keySchedule;
+    uint8_t m_rounds;
+    bool m_finished;
+    byte m_subkeys[2 * AES::kBlockSize];
+    byte m_chain[AES::kBlockSize];
+    byte m_buffer[AES::kBlockSize];
+    std::size_t m_bufferSize;
 };
 } // end namespace mine
 
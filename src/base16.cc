@@ -31,16 +31,23 @@ const std::unordered_map<byte, byte> Base16::kDecodeMap = {
 };
 
 ByteArray Base16::fromString(const std::string& hex)
+{
+    ByteArray byteArr;
+    fromString(hex, &byteArr);
+    return byteArr;
+}
+
+void Base16::fromString(const std::string& hex, ByteArray* byteArr)
 {
     if (hex.size() % 2 != 0) {
         throw std::invalid_argument("Invalid base-16 encoding");
     }
 
-    ByteArray byteArr;
+    byteArr->reserve(byteArr->size() + (hex.size() / 2));
     for (std::size_t i = 0; i < hex.length(); i += 2) {
-        byteArr.push_back(encode(hex.substr(i, 2).c_str()));
+        const char pair[] = { hex[i], hex[i + 1], '\0' };
+        byteArr->push_back(encode(pair));
     }
-    return byteArr;
 }
 
 void Base16::decode(char a, char b, std::ostringstream& ss)
@@ -21,6 +21,7 @@
 
 #include <cstdlib>
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <sstream>
 #include <unordered_map>
@@ -72,11 +73,24 @@ public:
     template <class Iter>
     static std::string encode(const Iter& begin, const Iter& end) noexcept
     {
-        std::ostringstream ss;
+        std::string result;
+        result.reserve(2 * static_cast<std::size_t>(end - begin));
+        encode(begin, end, std::back_inserter(result));
+        return result;
+    }
+
+    ///
+    /// \brief Encodes input iterator to hex encoding, characters are written to out
+    /// (e.g, back inserter of string that already has space for them)
+    ///
+    template <class Iter, class OutputIter>
+    static void encode(const Iter& begin, const Iter& end, OutputIter out) noexcept
+    {
         for (auto it = begin; it < end; ++it) {
-            encode(*it, ss);
+            int h = (*it & 0xff);
+            *out++ = kValidChars[(h >> 4) & 0xf];
+            *out++ = kValidChars[(h & 0xf)];
         }
-        return ss.str();
     }
 
     ///
@@ -87,6 +101,12 @@ public:
     ///
     static ByteArray fromString(const std::string& hex);
 
+    ///
+    /// \brief Same as fromString(const std::string&) except bytes are appended to byteArr
+    /// \throws invalid_argument if hex is not valid
+    ///
+    static void fromString(const std::string& hex, ByteArray* byteArr);
+
     ///
     /// \brief Encodes integer to hex
     ///
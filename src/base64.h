@@ -19,6 +19,7 @@
 #ifndef Base64_H
 #define Base64_H
 
+#include <iterator>
 #include <string>
 #include <sstream>
 #include <unordered_map>
@@ -74,8 +75,19 @@ public:
     template <class Iter>
     static std::string encode(const Iter& begin, const Iter& end) noexcept
     {
-        std::string padding;
-        std::stringstream ss;
+        std::string result;
+        result.reserve(expectedLength(static_cast<std::size_t>(end - begin)));
+        encode(begin, end, std::back_inserter(result));
+        return result;
+    }
+
+    ///
+    /// \brief Encodes iterators, characters are written to out (e.g, back
+    /// inserter of string that already has expectedLength() space for them)
+    ///
+    template <class Iter, class OutputIter>
+    static void encode(const Iter& begin, const Iter& end, OutputIter out) noexcept
+    {
         for (auto it = begin; it < end; it += 3) {
 
             //
@@ -86,10 +98,10 @@ public:
             //
 
             int c = static_cast<int>(*it & 0xff);
-            ss << static_cast<char>(static_cast<char>(kValidChars[(c >> 2) & 0x3f])); // first 6 bits from first bitset
+            *out++ = kValidChars[(c >> 2) & 0x3f]; // first 6 bits from first bitset
             if (it + 1 < end) {
                 int c2 = static_cast<int>(*(it + 1) & 0xff);
-                ss << static_cast<char>(kValidChars[((c << 4) | // remaining 2 bits from first bitset - shift them left to get 4-bit spaces 010000
+                *out++ = static_cast<char>(kValidChars[((c << 4) | // remaining 2 bits from first bitset - shift them left to get 4-bit spaces 010000
                                                      (c2 >> 4) // first 4 bits of second bitset - shift them right to get 2 spaces and bitwise
                                                                       // to add them 000110
                                                      ) & 0x3f]);      // must be within 63 --
@@ -102,21 +114,21 @@ public:
                                                                       // 010110 ==> 22
                 if (it + 2 < end) {
                     int c3 = static_cast<int>(*(it + 2) & 0xff);
-                    ss << static_cast<char>(kValidChars[((c2 << 2) | // remaining 4 bits from second bitset - shift them to get 011000
+                    *out++ = static_cast<char>(kValidChars[((c2 << 2) | // remaining 4 bits from second bitset - shift them to get 011000
                                                          (c3 >> 6)   // the first 2 bits from third bitset - shift them right to get 000001
                                                          ) & 0x3f]);
                                                                              // the rest of the explanation is same as above
-                    ss << static_cast<char>(kValidChars[c3 & 0x3f]); // all the remaing bits
+                    *out++ = static_cast<char>(kValidChars[c3 & 0x3f]); // all the remaing bits
                 } else {
-                    ss << static_cast<char>(kValidChars[(c2 << 2) & 0x3f]); // we have 4 bits left from last byte need space for two 0-bits
-                    ss << "=";
+                    *out++ = static_cast<char>(kValidChars[(c2 << 2) & 0x3f]); // we have 4 bits left from last byte need space for two 0-bits
+                    *out++ = '=';
                 }
             } else {
-                ss << static_cast<char>(kValidChars[(c << 4) & 0x3f]); // remaining 2 bits from single byte
-                ss << "==";
+                *out++ = static_cast<char>(kValidChars[(c << 4) & 0x3f]); // remaining 2 bits from single byte
+                *out++ = '=';
+                *out++ = '=';
             }
         }
-        return ss.str() + padding;
     }
 
     ///
@@ -139,6 +151,20 @@ public:
     ///
     template <class Iter>
     static std::string decode(const Iter& begin, const Iter& end)
+    {
+        std::string result;
+        result.reserve((static_cast<std::size_t>(end - begin) / 4) * 3);
+        decode(begin, end, std::back_inserter(result));
+        return result;
+    }
+
+    ///
+    /// \brief Decodes base64 iterator from begin to end, bytes are written to out
+    /// (e.g, back inserter of byte array)
+    /// \see decode(const Iter&, const Iter&)
+    ///
+    template <class Iter, class OutputIter>
+    static void decode(const Iter& begin, const Iter& end, OutputIter out)
     {
         //
         // we use example following example for implementation basis
@@ -155,14 +181,13 @@ public:
             }
         };
 
-        std::stringstream ss;
         for (auto it = begin; it < end; it += 4) {
             try {
                 while (iswspace(*it)) {
                     ++it;
 
                     if (it >= end) {
-                        goto result;
+                        return;
                     }
                 }
                 int b0 = findPosOf(*it);
@@ -177,7 +202,7 @@ public:
                     ++it;
 
                     if (it >= end) {
-                        goto result;
+                        return;
                     }
                 }
                 int b1 = findPosOf(*(it + 1));
@@ -189,7 +214,7 @@ public:
                     ++it;
 
                     if (it >= end) {
-                        goto result;
+                        return;
                     }
                 }
                 int b2 = findPosOf(*(it + 2));
@@ -201,7 +226,7 @@ public:
                     ++it;
 
                     if (it >= end) {
-                        goto result;
+                        return;
                     }
                 }
                 int b3 = findPosOf(*(it + 3));
@@ -209,21 +234,21 @@ public:
                     throw std::invalid_argument("Invalid base64 encoding");
                 }
 
-                ss << static_cast<byte>(b0 << 2 |     // 011000 << 2 ==> 01100000
+                *out++ = static_cast<byte>(b0 << 2 |     // 011000 << 2 ==> 01100000
                                         b1 >> 4); // 000001 >> 4 ==> 01100001 ==> 11000001 = 97
 
                 if (b1 != kPadding) {
                     if (b2 == kPadding) {
                         // second bitset is only 4 bits
                     } else {
-                        ss << static_cast<byte>((b1 & ~(1 << 5) & ~(1 << 4)) << 4 |     // 010110 ==> 000110 << 4 ==> 1100000
+                        *out++ = static_cast<byte>((b1 & ~(1 << 5) & ~(1 << 4)) << 4 |     // 010110 ==> 000110 << 4 ==> 1100000
                                                                                         // first we clear the bits at pos 4 and 5
                                                                                         // then we concat with next bit
                                                  b2 >> 2); // 001001 >> 2 ==> 00000010 ==> 01100010 = 98
                         if (b3 == kPadding) {
                             // third bitset is only 4 bits
                         } else {
-                            ss << static_cast<byte>((b2 & ~(1 << 5) & ~(1 << 4) & ~(1 << 3) & ~(1 << 2)) << 6 |     // 001001 ==> 000001 << 6 ==> 01000000
+                            *out++ = static_cast<byte>((b2 & ~(1 << 5) & ~(1 << 4) & ~(1 << 3) & ~(1 << 2)) << 6 |     // 001001 ==> 000001 << 6 ==> 01000000
                                                     // first we clear first 4 bits
                                                     // then concat with last byte as is
                                                      b3); // as is
@@ -234,8 +259,6 @@ public:
                 throw std::invalid_argument(std::string("Invalid base64 encoding: " + std::string(e.what())));
             }
         }
-result:
-        return ss.str();
     }
 
 
@@ -1,6 +1,8 @@
 #ifndef AES_TEST_H
 #define AES_TEST_H
 
+#include <atomic>
+#include <thread>
 #include "test.h"
 
 #ifdef MINE_SINGLE_HEADER_TEST
@@ -18,6 +20,24 @@ namespace mine {
 
 static AES aes;
 
+///
+/// \brief Restores settings shared by all the AES instances (engine, thread count and key
+/// schedule cache capacity) to defaults when test returns, even if an assertion fails
+///
+class AESSettingsGuard {
+public:
+    AESSettingsGuard() = default;
+    AESSettingsGuard(const AESSettingsGuard&) = delete;
+    AESSettingsGuard& operator=(const AESSettingsGuard&) = delete;
+
+    ~AESSettingsGuard()
+    {
+        AES::setEngine(AES::Engine::Auto);
+        AES::setThreadCount(0);
+        AES::setKeyScheduleCacheCapacity(0);
+    }
+};
+
 TEST(AESTest, KeyExpansion)
 {
     // This key expansion is original key from FIPS.197 example
@@ -28,50 +48,17 @@ TEST(AESTest, KeyExpansion)
                                                        0xab, 0xf7, 0x15, 0x88,
                                                        0x09, 0xcf, 0x4f, 0x3c
                                                    }}, AES::KeySchedule{{
-                                                                            {0, {{ 0x2B, 0x7E, 0x15, 0x16 }}},
-                                                                            {1, {{ 0x28, 0xAE, 0xD2, 0xA6 }}},
-                                                                            {2, {{ 0xAB, 0xF7, 0x15, 0x88 }}},
-                                                                            {3, {{ 0x9, 0xCF, 0x4F, 0x3C }}},
-                                                                            {4, {{ 0xA0, 0xFA, 0xFE, 0x17 }}},
-                                                                            {5, {{ 0x88, 0x54, 0x2C, 0xB1 }}},
-                                                                            {6, {{ 0x23, 0xA3, 0x39, 0x39 }}},
-                                                                            {7, {{ 0x2A, 0x6C, 0x76, 0x5 }}},
-                                                                            {8, {{ 0xF2, 0xC2, 0x95, 0xF2 }}},
-                                                                            {9, {{ 0x7A, 0x96, 0xB9, 0x43 }}},
-                                                                            {10, {{ 0x59, 0x35, 0x80, 0x7A }}},
-                                                                            {11, {{ 0x73, 0x59, 0xF6, 0x7F }}},
-                                                                            {12, {{ 0x3D, 0x80, 0x47, 0x7D }}},
-                                                                            {13, {{ 0x47, 0x16, 0xFE, 0x3E }}},
-                                                                            {14, {{ 0x1E, 0x23, 0x7E, 0x44 }}},
-                                                                            {15, {{ 0x6D, 0x7A, 0x88, 0x3B }}},
-                                                                            {16, {{ 0xEF, 0x44, 0xA5, 0x41 }}},
-                                                                            {17, {{ 0xA8, 0x52, 0x5B, 0x7F }}},
-                                                                            {18, {{ 0xB6, 0x71, 0x25, 0x3B }}},
-                                                                            {19, {{ 0xDB, 0xB, 0xAD, 0x00 }}},
-                                                                            {20, {{ 0xD4, 0xD1, 0xC6, 0xF8 }}},
-                                                                            {21, {{ 0x7C, 0x83, 0x9D, 0x87 }}},
-                                                                            {22, {{ 0xCA, 0xF2, 0xB8, 0xBC }}},
-                                                                            {23, {{ 0x11, 0xF9, 0x15, 0xBC }}},
-                                                                            {24, {{ 0x6D, 0x88, 0xA3, 0x7A }}},
-                                                                            {25, {{ 0x11, 0xB, 0x3E, 0xFD }}},
-                                                                            {26, {{ 0xDB, 0xF9, 0x86, 0x41 }}},
-                                                                            {27, {{ 0xCA, 0x00, 0x93, 0xFD }}},
-                                                                            {28, {{ 0x4E, 0x54, 0xF7, 0xE }}},
-                                                                            {29, {{ 0x5F, 0x5F, 0xC9, 0xF3 }}},
-                                                                            {30, {{ 0x84, 0xA6, 0x4F, 0xB2 }}},
-                                                                            {31, {{ 0x4E, 0xA6, 0xDC, 0x4F }}},
-                                                                            {32, {{ 0xEA, 0xD2, 0x73, 0x21 }}},
-                                                                            {33, {{ 0xB5, 0x8D, 0xBA, 0xD2 }}},
-                                                                            {34, {{ 0x31, 0x2B, 0xF5, 0x60 }}},
-                                                                            {35, {{ 0x7F, 0x8D, 0x29, 0x2F }}},
-                                                                            {36, {{ 0xAC, 0x77, 0x66, 0xF3 }}},
-                                                                            {37, {{ 0x19, 0xFA, 0xDC, 0x21 }}},
-                                                                            {38, {{ 0x28, 0xD1, 0x29, 0x41 }}},
-                                                                            {39, {{ 0x57, 0x5C, 0x00, 0x6E }}},
-                                                                            {40, {{ 0xD0, 0x14, 0xF9, 0xA8 }}},
-                                                                            {41, {{ 0xC9, 0xEE, 0x25, 0x89 }}},
-                                                                            {42, {{ 0xE1, 0x3F, 0xC, 0xC8 }}},
-                                                                            {43, {{ 0xB6, 0x63, 0xC, 0xA6 }}}
+                                                                            0x2b7e1516, 0x28aed2a6, 0xabf71588, 0x09cf4f3c,
+                                                                            0xa0fafe17, 0x88542cb1, 0x23a33939, 0x2a6c7605,
+                                                                            0xf2c295f2, 0x7a96b943, 0x5935807a, 0x7359f67f,
+                                                                            0x3d80477d, 0x4716fe3e, 0x1e237e44, 0x6d7a883b,
+                                                                            0xef44a541, 0xa8525b7f, 0xb671253b, 0xdb0bad00,
+                                                                            0xd4d1c6f8, 0x7c839d87, 0xcaf2b8bc, 0x11f915bc,
+                                                                            0x6d88a37a, 0x110b3efd, 0xdbf98641, 0xca0093fd,
+                                                                            0x4e54f70e, 0x5f5fc9f3, 0x84a64fb2, 0x4ea6dc4f,
+                                                                            0xead27321, 0xb58dbad2, 0x312bf560, 0x7f8d292f,
+                                                                            0xac7766f3, 0x19fadc21, 0x28d12941, 0x575c006e,
+                                                                            0xd014f9a8, 0xc9ee2589, 0xe13f0cc8, 0xb6630ca6
                                                                         }}),
         TestCase("192-bit key expansion", AES::Key{{
                                                        0x8e, 0x73, 0xb0, 0xf7,
@@ -81,58 +68,19 @@ TEST(AESTest, KeyExpansion)
                                                        0x62, 0xf8, 0xea, 0xd2,
                                                        0x52, 0x2c, 0x6b, 0x7b
                                                    }}, AES::KeySchedule{{
-                                                                            {0, {{ 0x8E, 0x73, 0xB0, 0xF7 }}},
-                                                                            {1, {{ 0xDA, 0xE, 0x64, 0x52 }}},
-                                                                            {2, {{ 0xC8, 0x10, 0xF3, 0x2B }}},
-                                                                            {3, {{ 0x80, 0x90, 0x79, 0xE5 }}},
-                                                                            {4, {{ 0x62, 0xF8, 0xEA, 0xD2 }}},
-                                                                            {5, {{ 0x52, 0x2C, 0x6B, 0x7B }}},
-                                                                            {6, {{ 0xFE, 0xC, 0x91, 0xF7 }}},
-                                                                            {7, {{ 0x24, 0x2, 0xF5, 0xA5 }}},
-                                                                            {8, {{ 0xEC, 0x12, 0x6, 0x8E }}},
-                                                                            {9, {{ 0x6C, 0x82, 0x7F, 0x6B }}},
-                                                                            {10, {{ 0xE, 0x7A, 0x95, 0xB9 }}},
-                                                                            {11, {{ 0x5C, 0x56, 0xFE, 0xC2 }}},
-                                                                            {12, {{ 0x4D, 0xB7, 0xB4, 0xBD }}},
-                                                                            {13, {{ 0x69, 0xB5, 0x41, 0x18 }}},
-                                                                            {14, {{ 0x85, 0xA7, 0x47, 0x96 }}},
-                                                                            {15, {{ 0xE9, 0x25, 0x38, 0xFD }}},
-                                                                            {16, {{ 0xE7, 0x5F, 0xAD, 0x44 }}},
-                                                                            {17, {{ 0xBB, 0x9, 0x53, 0x86 }}},
-                                                                            {18, {{ 0x48, 0x5A, 0xF0, 0x57 }}},
-                                                                            {19, {{ 0x21, 0xEF, 0xB1, 0x4F }}},
-                                                                            {20, {{ 0xA4, 0x48, 0xF6, 0xD9 }}},
-                                                                            {21, {{ 0x4D, 0x6D, 0xCE, 0x24 }}},
-                                                                            {22, {{ 0xAA, 0x32, 0x63, 0x60 }}},
-                                                                            {23, {{ 0x11, 0x3B, 0x30, 0xE6 }}},
-                                                                            {24, {{ 0xA2, 0x5E, 0x7E, 0xD5 }}},
-                                                                            {25, {{ 0x83, 0xB1, 0xCF, 0x9A }}},
-                                                                            {26, {{ 0x27, 0xF9, 0x39, 0x43 }}},
-                                                                            {27, {{ 0x6A, 0x94, 0xF7, 0x67 }}},
-                                                                            {28, {{ 0xC0, 0xA6, 0x94, 0x7 }}},
-                                                                            {29, {{ 0xD1, 0x9D, 0xA4, 0xE1 }}},
-                                                                            {30, {{ 0xEC, 0x17, 0x86, 0xEB }}},
-                                                                            {31, {{ 0x6F, 0xA6, 0x49, 0x71 }}},
-                                                                            {32, {{ 0x48, 0x5F, 0x70, 0x32 }}},
-                                                                            {33, {{ 0x22, 0xCB, 0x87, 0x55 }}},
-                                                                            {34, {{ 0xE2, 0x6D, 0x13, 0x52 }}},
-                                                                            {35, {{ 0x33, 0xF0, 0xB7, 0xB3 }}},
-                                                                            {36, {{ 0x40, 0xBE, 0xEB, 0x28 }}},
-                                                                            {37, {{ 0x2F, 0x18, 0xA2, 0x59 }}},
-                                                                            {38, {{ 0x67, 0x47, 0xD2, 0x6B }}},
-                                                                            {39, {{ 0x45, 0x8C, 0x55, 0x3E }}},
-                                                                            {40, {{ 0xA7, 0xE1, 0x46, 0x6C }}},
-                                                                            {41, {{ 0x94, 0x11, 0xF1, 0xDF }}},
-                                                                            {42, {{ 0x82, 0x1F, 0x75, 0xA }}},
-                                                                            {43, {{ 0xAD, 0x7, 0xD7, 0x53 }}},
-                                                                            {44, {{ 0xCA, 0x40, 0x5, 0x38 }}},
-                                                                            {45, {{ 0x8F, 0xCC, 0x50, 0x6 }}},
-                                                                            {46, {{ 0x28, 0x2D, 0x16, 0x6A }}},
-                                                                            {47, {{ 0xBC, 0x3C, 0xE7, 0xB5 }}},
-                                                                            {48, {{ 0xE9, 0x8B, 0xA0, 0x6F }}},
-                                                                            {49, {{ 0x44, 0x8C, 0x77, 0x3C }}},
-                                                                            {50, {{ 0x8E, 0xCC, 0x72, 0x4 }}},
-                                                                            {51, {{ 0x1, 0x0, 0x22, 0x2 }}},
+                                                                            0x8e73b0f7, 0xda0e6452, 0xc810f32b, 0x809079e5,
+                                                                            0x62f8ead2, 0x522c6b7b, 0xfe0c91f7, 0x2402f5a5,
+                                                                            0xec12068e, 0x6c827f6b, 0x0e7a95b9, 0x5c56fec2,
+                                                                            0x4db7b4bd, 0x69b54118, 0x85a74796, 0xe92538fd,
+                                                                            0xe75fad44, 0xbb095386, 0x485af057, 0x21efb14f,
+                                                                            0xa448f6d9, 0x4d6dce24, 0xaa326360, 0x113b30e6,
+                                                                            0xa25e7ed5, 0x83b1cf9a, 0x27f93943, 0x6a94f767,
+                                                                            0xc0a69407, 0xd19da4e1, 0xec1786eb, 0x6fa64971,
+                                                                            0x485f7032, 0x22cb8755, 0xe26d1352, 0x33f0b7b3,
+                                                                            0x40beeb28, 0x2f18a259, 0x6747d26b, 0x458c553e,
+                                                                            0xa7e1466c, 0x9411f1df, 0x821f750a, 0xad07d753,
+                                                                            0xca400538, 0x8fcc5006, 0x282d166a, 0xbc3ce7b5,
+                                                                            0xe98ba06f, 0x448c773c, 0x8ecc7204, 0x01002202,
 
                                                                         }}),
 
@@ -146,66 +94,21 @@ TEST(AESTest, KeyExpansion)
                                                        0x2d, 0x98, 0x10, 0xa3,
                                                        0x09, 0x14, 0xdf, 0xf4
                                                    }}, AES::KeySchedule{{
-                                                                            {0, {{ 0x60, 0x3D, 0xEB, 0x10 }}},
-                                                                            {1, {{ 0x15, 0xCA, 0x71, 0xBE }}},
-                                                                            {2, {{ 0x2B, 0x73, 0xAE, 0xF0 }}},
-                                                                            {3, {{ 0x85, 0x7D, 0x77, 0x81 }}},
-                                                                            {4, {{ 0x1F, 0x35, 0x2C, 0x7 }}},
-                                                                            {5, {{ 0x3B, 0x61, 0x8, 0xD7 }}},
-                                                                            {6, {{ 0x2D, 0x98, 0x10, 0xA3 }}},
-                                                                            {7, {{ 0x9, 0x14, 0xDF, 0xF4 }}},
-                                                                            {8, {{ 0x9B, 0xA3, 0x54, 0x11 }}},
-                                                                            {9, {{ 0x8E, 0x69, 0x25, 0xAF }}},
-                                                                            {10, {{ 0xA5, 0x1A, 0x8B, 0x5F }}},
-                                                                            {11, {{ 0x20, 0x67, 0xFC, 0xDE }}},
-                                                                            {12, {{ 0xA8, 0xB0, 0x9C, 0x1A }}},
-                                                                            {13, {{ 0x93, 0xD1, 0x94, 0xCD }}},
-                                                                            {14, {{ 0xBE, 0x49, 0x84, 0x6E }}},
-                                                                            {15, {{ 0xB7, 0x5D, 0x5B, 0x9A }}},
-                                                                            {16, {{ 0xD5, 0x9A, 0xEC, 0xB8 }}},
-                                                                            {17, {{ 0x5B, 0xF3, 0xC9, 0x17 }}},
-                                                                            {18, {{ 0xFE, 0xE9, 0x42, 0x48 }}},
-                                                                            {19, {{ 0xDE, 0x8E, 0xBE, 0x96 }}},
-                                                                            {20, {{ 0xB5, 0xA9, 0x32, 0x8A }}},
-                                                                            {21, {{ 0x26, 0x78, 0xA6, 0x47 }}},
-                                                                            {22, {{ 0x98, 0x31, 0x22, 0x29 }}},
-                                                                            {23, {{ 0x2F, 0x6C, 0x79, 0xB3 }}},
-                                                                            {24, {{ 0x81, 0x2C, 0x81, 0xAD }}},
-                                                                            {25, {{ 0xDA, 0xDF, 0x48, 0xBA }}},
-                                                                            {26, {{ 0x24, 0x36, 0xA, 0xF2 }}},
-                                                                            {27, {{ 0xFA, 0xB8, 0xB4, 0x64 }}},
-                                                                            {28, {{ 0x98, 0xC5, 0xBF, 0xC9 }}},
-                                                                            {29, {{ 0xBE, 0xBD, 0x19, 0x8E }}},
-                                                                            {30, {{ 0x26, 0x8C, 0x3B, 0xA7 }}},
-                                                                            {31, {{ 0x9, 0xE0, 0x42, 0x14 }}},
-                                                                            {32, {{ 0x68, 0x0, 0x7B, 0xAC }}},
-                                                                            {33, {{ 0xB2, 0xDF, 0x33, 0x16 }}},
-                                                                            {34, {{ 0x96, 0xE9, 0x39, 0xE4 }}},
-                                                                            {35, {{ 0x6C, 0x51, 0x8D, 0x80 }}},
-                                                                            {36, {{ 0xC8, 0x14, 0xE2, 0x4 }}},
-                                                                            {37, {{ 0x76, 0xA9, 0xFB, 0x8A }}},
-                                                                            {38, {{ 0x50, 0x25, 0xC0, 0x2D }}},
-                                                                            {39, {{ 0x59, 0xC5, 0x82, 0x39 }}},
-                                                                            {40, {{ 0xDE, 0x13, 0x69, 0x67 }}},
-                                                                            {41, {{ 0x6C, 0xCC, 0x5A, 0x71 }}},
-                                                                            {42, {{ 0xFA, 0x25, 0x63, 0x95 }}},
-                                                                            {43, {{ 0x96, 0x74, 0xEE, 0x15 }}},
-                                                                            {44, {{ 0x58, 0x86, 0xCA, 0x5D }}},
-                                                                            {45, {{ 0x2E, 0x2F, 0x31, 0xD7 }}},
-                                                                            {46, {{ 0x7E, 0xA, 0xF1, 0xFA }}},
-                                                                            {47, {{ 0x27, 0xCF, 0x73, 0xC3 }}},
-                                                                            {48, {{ 0x74, 0x9C, 0x47, 0xAB }}},
-                                                                            {49, {{ 0x18, 0x50, 0x1D, 0xDA }}},
-                                                                            {50, {{ 0xE2, 0x75, 0x7E, 0x4F }}},
-                                                                            {51, {{ 0x74, 0x1, 0x90, 0x5A }}},
-                                                                            {52, {{ 0xCA, 0xFA, 0xAA, 0xE3 }}},
-                                                                            {53, {{ 0xE4, 0xD5, 0x9B, 0x34 }}},
-                                                                            {54, {{ 0x9A, 0xDF, 0x6A, 0xCE }}},
-                                                                            {55, {{ 0xBD, 0x10, 0x19, 0xD }}},
-                                                                            {56, {{ 0xFE, 0x48, 0x90, 0xD1 }}},
-                                                                            {57, {{ 0xE6, 0x18, 0x8D, 0xB }}},
-                                                                            {58, {{ 0x4, 0x6D, 0xF3, 0x44 }}},
-                                                                            {59, {{ 0x70, 0x6C, 0x63, 0x1E }}},
+                                                                            0x603deb10, 0x15ca71be, 0x2b73aef0, 0x857d7781,
+                                                                            0x1f352c07, 0x3b6108d7, 0x2d9810a3, 0x0914dff4,
+                                                                            0x9ba35411, 0x8e6925af, 0xa51a8b5f, 0x2067fcde,
+                                                                            0xa8b09c1a, 0x93d194cd, 0xbe49846e, 0xb75d5b9a,
+                                                                            0xd59aecb8, 0x5bf3c917, 0xfee94248, 0xde8ebe96,
+                                                                            0xb5a9328a, 0x2678a647, 0x98312229, 0x2f6c79b3,
+                                                                            0x812c81ad, 0xdadf48ba, 0x24360af2, 0xfab8b464,
+                                                                            0x98c5bfc9, 0xbebd198e, 0x268c3ba7, 0x09e04214,
+                                                                            0x68007bac, 0xb2df3316, 0x96e939e4, 0x6c518d80,
+                                                                            0xc814e204, 0x76a9fb8a, 0x5025c02d, 0x59c58239,
+                                                                            0xde136967, 0x6ccc5a71, 0xfa256395, 0x9674ee15,
+                                                                            0x5886ca5d, 0x2e2f31d7, 0x7e0af1fa, 0x27cf73c3,
+                                                                            0x749c47ab, 0x18501dda, 0xe2757e4f, 0x7401905a,
+                                                                            0xcafaaae3, 0xe4d59b34, 0x9adf6ace, 0xbd10190d,
+                                                                            0xfe4890d1, 0xe6188d0b, 0x046df344, 0x706c631e,
                                                                         }}),
     };
 
@@ -899,66 +802,21 @@ TEST(AESTest, Copy)
             0x09, 0x14, 0xdf, 0xf4
         }};
     AES::KeySchedule expectedKeySchedule = {{
-                                                {0, {{ 0x60, 0x3D, 0xEB, 0x10 }}},
-                                                {1, {{ 0x15, 0xCA, 0x71, 0xBE }}},
-                                                {2, {{ 0x2B, 0x73, 0xAE, 0xF0 }}},
-                                                {3, {{ 0x85, 0x7D, 0x77, 0x81 }}},
-                                                {4, {{ 0x1F, 0x35, 0x2C, 0x7 }}},
-                                                {5, {{ 0x3B, 0x61, 0x8, 0xD7 }}},
-                                                {6, {{ 0x2D, 0x98, 0x10, 0xA3 }}},
-                                                {7, {{ 0x9, 0x14, 0xDF, 0xF4 }}},
-                                                {8, {{ 0x9B, 0xA3, 0x54, 0x11 }}},
-                                                {9, {{ 0x8E, 0x69, 0x25, 0xAF }}},
-                                                {10, {{ 0xA5, 0x1A, 0x8B, 0x5F }}},
-                                                {11, {{ 0x20, 0x67, 0xFC, 0xDE }}},
-                                                {12, {{ 0xA8, 0xB0, 0x9C, 0x1A }}},
-                                                {13, {{ 0x93, 0xD1, 0x94, 0xCD }}},
-                                                {14, {{ 0xBE, 0x49, 0x84, 0x6E }}},
-                                                {15, {{ 0xB7, 0x5D, 0x5B, 0x9A }}},
-                                                {16, {{ 0xD5, 0x9A, 0xEC, 0xB8 }}},
-                                                {17, {{ 0x5B, 0xF3, 0xC9, 0x17 }}},
-                                                {18, {{ 0xFE, 0xE9, 0x42, 0x48 }}},
-                                                {19, {{ 0xDE, 0x8E, 0xBE, 0x96 }}},
-                                                {20, {{ 0xB5, 0xA9, 0x32, 0x8A }}},
-                                                {21, {{ 0x26, 0x78, 0xA6, 0x47 }}},
-                                                {22, {{ 0x98, 0x31, 0x22, 0x29 }}},
-                                                {23, {{ 0x2F, 0x6C, 0x79, 0xB3 }}},
-                                                {24, {{ 0x81, 0x2C, 0x81, 0xAD }}},
-                                                {25, {{ 0xDA, 0xDF, 0x48, 0xBA }}},
-                                                {26, {{ 0x24, 0x36, 0xA, 0xF2 }}},
-                                                {27, {{ 0xFA, 0xB8, 0xB4, 0x64 }}},
-                                                {28, {{ 0x98, 0xC5, 0xBF, 0xC9 }}},
-                                                {29, {{ 0xBE, 0xBD, 0x19, 0x8E }}},
-                                                {30, {{ 0x26, 0x8C, 0x3B, 0xA7 }}},
-                                                {31, {{ 0x9, 0xE0, 0x42, 0x14 }}},
-                                                {32, {{ 0x68, 0x0, 0x7B, 0xAC }}},
-                                                {33, {{ 0xB2, 0xDF, 0x33, 0x16 }}},
-                                                {34, {{ 0x96, 0xE9, 0x39, 0xE4 }}},
-                                                {35, {{ 0x6C, 0x51, 0x8D, 0x80 }}},
-                                                {36, {{ 0xC8, 0x14, 0xE2, 0x4 }}},
-                                                {37, {{ 0x76, 0xA9, 0xFB, 0x8A }}},
-                                                {38, {{ 0x50, 0x25, 0xC0, 0x2D }}},
-                                                {39, {{ 0x59, 0xC5, 0x82, 0x39 }}},
-                                                {40, {{ 0xDE, 0x13, 0x69, 0x67 }}},
-                                                {41, {{ 0x6C, 0xCC, 0x5A, 0x71 }}},
-                                                {42, {{ 0xFA, 0x25, 0x63, 0x95 }}},
-                                                {43, {{ 0x96, 0x74, 0xEE, 0x15 }}},
-                                                {44, {{ 0x58, 0x86, 0xCA, 0x5D }}},
-                                                {45, {{ 0x2E, 0x2F, 0x31, 0xD7 }}},
-                                                {46, {{ 0x7E, 0xA, 0xF1, 0xFA }}},
-                                                {47, {{ 0x27, 0xCF, 0x73, 0xC3 }}},
-                                                {48, {{ 0x74, 0x9C, 0x47, 0xAB }}},
-                                                {49, {{ 0x18, 0x50, 0x1D, 0xDA }}},
-                                                {50, {{ 0xE2, 0x75, 0x7E, 0x4F }}},
-                                                {51, {{ 0x74, 0x1, 0x90, 0x5A }}},
-                                                {52, {{ 0xCA, 0xFA, 0xAA, 0xE3 }}},
-                                                {53, {{ 0xE4, 0xD5, 0x9B, 0x34 }}},
-                                                {54, {{ 0x9A, 0xDF, 0x6A, 0xCE }}},
-                                                {55, {{ 0xBD, 0x10, 0x19, 0xD }}},
-                                                {56, {{ 0xFE, 0x48, 0x90, 0xD1 }}},
-                                                {57, {{ 0xE6, 0x18, 0x8D, 0xB }}},
-                                                {58, {{ 0x4, 0x6D, 0xF3, 0x44 }}},
-                                                {59, {{ 0x70, 0x6C, 0x63, 0x1E }}},
+                                                0x603deb10, 0x15ca71be, 0x2b73aef0, 0x857d7781,
+                                                0x1f352c07, 0x3b6108d7, 0x2d9810a3, 0x0914dff4,
+                                                0x9ba35411, 0x8e6925af, 0xa51a8b5f, 0x2067fcde,
+                                                0xa8b09c1a, 0x93d194cd, 0xbe49846e, 0xb75d5b9a,
+                                                0xd59aecb8, 0x5bf3c917, 0xfee94248, 0xde8ebe96,
+                                                0xb5a9328a, 0x2678a647, 0x98312229, 0x2f6c79b3,
+                                                0x812c81ad, 0xdadf48ba, 0x24360af2, 0xfab8b464,
+                                                0x98c5bfc9, 0xbebd198e, 0x268c3ba7, 0x09e04214,
+                                                0x68007bac, 0xb2df3316, 0x96e939e4, 0x6c518d80,
+                                                0xc814e204, 0x76a9fb8a, 0x5025c02d, 0x59c58239,
+                                                0xde136967, 0x6ccc5a71, 0xfa256395, 0x9674ee15,
+                                                0x5886ca5d, 0x2e2f31d7, 0x7e0af1fa, 0x27cf73c3,
+                                                0x749c47ab, 0x18501dda, 0xe2757e4f, 0x7401905a,
+                                                0xcafaaae3, 0xe4d59b34, 0x9adf6ace, 0xbd10190d,
+                                                0xfe4890d1, 0xe6188d0b, 0x046df344, 0x706c631e,
                                             }};
     AES aesSimple(key);
     ASSERT_EQ(aesSimple.m_key, key);
@@ -990,58 +848,19 @@ TEST(AESTest, Copy)
 
     AES::KeySchedule expectedKeySchedule2 =
             AES::KeySchedule{{
-                {0, {{ 0x8E, 0x73, 0xB0, 0xF7 }}},
-                {1, {{ 0xDA, 0xE, 0x64, 0x52 }}},
-                {2, {{ 0xC8, 0x10, 0xF3, 0x2B }}},
-                {3, {{ 0x80, 0x90, 0x79, 0xE5 }}},
-                {4, {{ 0x62, 0xF8, 0xEA, 0xD2 }}},
-                {5, {{ 0x52, 0x2C, 0x6B, 0x7B }}},
-                {6, {{ 0xFE, 0xC, 0x91, 0xF7 }}},
-                {7, {{ 0x24, 0x2, 0xF5, 0xA5 }}},
-                {8, {{ 0xEC, 0x12, 0x6, 0x8E }}},
-                {9, {{ 0x6C, 0x82, 0x7F, 0x6B }}},
-                {10, {{ 0xE, 0x7A, 0x95, 0xB9 }}},
-                {11, {{ 0x5C, 0x56, 0xFE, 0xC2 }}},
-                {12, {{ 0x4D, 0xB7, 0xB4, 0xBD }}},
-                {13, {{ 0x69, 0xB5, 0x41, 0x18 }}},
-                {14, {{ 0x85, 0xA7, 0x47, 0x96 }}},
-                {15, {{ 0xE9, 0x25, 0x38, 0xFD }}},
-                {16, {{ 0xE7, 0x5F, 0xAD, 0x44 }}},
-                {17, {{ 0xBB, 0x9, 0x53, 0x86 }}},
-                {18, {{ 0x48, 0x5A, 0xF0, 0x57 }}},
-                {19, {{ 0x21, 0xEF, 0xB1, 0x4F }}},
-                {20, {{ 0xA4, 0x48, 0xF6, 0xD9 }}},
-                {21, {{ 0x4D, 0x6D, 0xCE, 0x24 }}},
-                {22, {{ 0xAA, 0x32, 0x63, 0x60 }}},
-                {23, {{ 0x11, 0x3B, 0x30, 0xE6 }}},
-                {24, {{ 0xA2, 0x5E, 0x7E, 0xD5 }}},
-                {25, {{ 0x83, 0xB1, 0xCF, 0x9A }}},
-                {26, {{ 0x27, 0xF9, 0x39, 0x43 }}},
-                {27, {{ 0x6A, 0x94, 0xF7, 0x67 }}},
-                {28, {{ 0xC0, 0xA6, 0x94, 0x7 }}},
-                {29, {{ 0xD1, 0x9D, 0xA4, 0xE1 }}},
-                {30, {{ 0xEC, 0x17, 0x86, 0xEB }}},
-                {31, {{ 0x6F, 0xA6, 0x49, 0x71 }}},
-                {32, {{ 0x48, 0x5F, 0x70, 0x32 }}},
-                {33, {{ 0x22, 0xCB, 0x87, 0x55 }}},
-                {34, {{ 0xE2, 0x6D, 0x13, 0x52 }}},
-                {35, {{ 0x33, 0xF0, 0xB7, 0xB3 }}},
-                {36, {{ 0x40, 0xBE, 0xEB, 0x28 }}},
-                {37, {{ 0x2F, 0x18, 0xA2, 0x59 }}},
-                {38, {{ 0x67, 0x47, 0xD2, 0x6B }}},
-                {39, {{ 0x45, 0x8C, 0x55, 0x3E }}},
-                {40, {{ 0xA7, 0xE1, 0x46, 0x6C }}},
-                {41, {{ 0x94, 0x11, 0xF1, 0xDF }}},
-                {42, {{ 0x82, 0x1F, 0x75, 0xA }}},
-                {43, {{ 0xAD, 0x7, 0xD7, 0x53 }}},
-                {44, {{ 0xCA, 0x40, 0x5, 0x38 }}},
-                {45, {{ 0x8F, 0xCC, 0x50, 0x6 }}},
-                {46, {{ 0x28, 0x2D, 0x16, 0x6A }}},
-                {47, {{ 0xBC, 0x3C, 0xE7, 0xB5 }}},
-                {48, {{ 0xE9, 0x8B, 0xA0, 0x6F }}},
-                {49, {{ 0x44, 0x8C, 0x77, 0x3C }}},
-                {50, {{ 0x8E, 0xCC, 0x72, 0x4 }}},
-                {51, {{ 0x1, 0x0, 0x22, 0x2 }}},
+                0x8e73b0f7, 0xda0e6452, 0xc810f32b, 0x809079e5,
+                0x62f8ead2, 0x522c6b7b, 0xfe0c91f7, 0x2402f5a5,
+                0xec12068e, 0x6c827f6b, 0x0e7a95b9, 0x5c56fec2,
+                0x4db7b4bd, 0x69b54118, 0x85a74796, 0xe92538fd,
+                0xe75fad44, 0xbb095386, 0x485af057, 0x21efb14f,
+                0xa448f6d9, 0x4d6dce24, 0xaa326360, 0x113b30e6,
+                0xa25e7ed5, 0x83b1cf9a, 0x27f93943, 0x6a94f767,
+                0xc0a69407, 0xd19da4e1, 0xec1786eb, 0x6fa64971,
+                0x485f7032, 0x22cb8755, 0xe26d1352, 0x33f0b7b3,
+                0x40beeb28, 0x2f18a259, 0x6747d26b, 0x458c553e,
+                0xa7e1466c, 0x9411f1df, 0x821f750a, 0xad07d753,
+                0xca400538, 0x8fcc5006, 0x282d166a, 0xbc3ce7b5,
+                0xe98ba06f, 0x448c773c, 0x8ecc7204, 0x01002202,
 
             }};
 
@@ -1126,7 +945,1353 @@ TEST(AESTest, EncryptResultsForLongTextMatchesRipe)
     run(Base64::encode(input17), input17Enc, MineCommon::Encoding::Base64);
     run(Base64::encode(input32), input32Enc, MineCommon::Encoding::Base64);
 
+    // const instance uses its key schedule directly, keyed overload sets the key first
+    const AES keyed(Base16::fromString(key));
+    std::string ivCopy = iv;
+    ASSERT_STRCASEEQ(input32Enc.c_str(), keyed.encr(input32, ivCopy).c_str());
+    ASSERT_EQ(input32, keyed.decr(input32Enc, iv));
+    AES other;
+    ASSERT_STRCASEEQ(input17Enc.c_str(), other.encrypt(input17, key, ivCopy).c_str());
+    ASSERT_EQ(input17, other.decr(input17Enc, iv));
+
+    std::string generatedIv;
+    std::string output = keyed.encr(input15, generatedIv);
+    ASSERT_EQ(32, generatedIv.size());
+    ASSERT_EQ(input15, keyed.decr(output, generatedIv));
+
+    std::string shortIv = "a14c5456";
+    ASSERT_THROW(keyed.encr(input15, shortIv), std::invalid_argument);
+    ASSERT_THROW(other.encrypt(input15, "a14c5456", ivCopy), std::invalid_argument);
+    const AES noKey;
+    ASSERT_THROW(noKey.encr(input15), std::runtime_error);
+    ASSERT_THROW(noKey.decr(input15Enc), std::runtime_error);
+}
+
+TEST(AESTest, StringCipherEncodings)
+{
+    AESSettingsGuard settings;
+
+    // string functions decode and encode in place, result is same as buffer functions
+    const AES::Key key = MineCommon::generateRandomBytes(24);
+    const ByteArray ivBytes = MineCommon::generateRandomBytes(16);
+    const std::string iv = Base16::encode(ivBytes.begin(), ivBytes.end());
+    AES::setThreadCount(4);
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+        const AES aesString(key);
+        for (std::size_t length : { 0, 1, 15, 16, 17, 32, 47, 100, 4101 }) {
+            const ByteArray plain = MineCommon::generateRandomBytes(length);
+            const std::string raw = MineCommon::byteArrayToRawString(plain);
+            for (bool pkcs5Padding : { true, false }) {
+                ByteArray expected(AES::encryptedSize(length, pkcs5Padding));
+                expected.resize(aesString.encr(plain.data(), length, expected.data(), pkcs5Padding));
+                ByteArray expectedCbc(AES::encryptedSize(length, pkcs5Padding));
+                expectedCbc.resize(aesString.encr(plain.data(), length, expectedCbc.data(), ivBytes.data(), pkcs5Padding));
+                const std::string expected16 = Base16::encode(expected.begin(), expected.end());
+                const std::string expectedCbc64 = Base64::encode(expectedCbc.begin(), expectedCbc.end());
+
+                for (MineCommon::Encoding encoding : { MineCommon::Encoding::Raw, MineCommon::Encoding::Base16, MineCommon::Encoding::Base64 }) {
+                    const std::string input = encoding == MineCommon::Encoding::Raw ? raw :
+                                              (encoding == MineCommon::Encoding::Base16 ? Base16::encode(raw) : Base64::encode(raw));
+                    ASSERT_EQ(expected16, aesString.encr(input, encoding, MineCommon::Encoding::Base16, pkcs5Padding));
+                    ASSERT_EQ(MineCommon::byteArrayToRawString(expected), aesString.encr(input, encoding, MineCommon::Encoding::Raw, pkcs5Padding));
+                    std::string ivCopy = iv;
+                    ASSERT_EQ(expectedCbc64, aesString.encr(input, ivCopy, encoding, MineCommon::Encoding::Base64, pkcs5Padding));
+                }
+                if (pkcs5Padding) {
+                    ASSERT_EQ(raw, aesString.decr(expected16, MineCommon::Encoding::Base16, MineCommon::Encoding::Raw));
+                    ASSERT_EQ(raw, aesString.decr(expectedCbc64, iv, MineCommon::Encoding::Base64, MineCommon::Encoding::Raw));
+                    ASSERT_EQ(Base64::encode(raw), aesString.decr(expectedCbc64, iv, MineCommon::Encoding::Base64, MineCommon::Encoding::Base64));
+                }
+            }
+        }
+    }
+
+    const AES aesString(key);
+    ASSERT_THROW(aesString.decr("0011", "00", MineCommon::Encoding::Base16), std::invalid_argument);
+    ASSERT_THROW(aesString.decr("001", MineCommon::Encoding::Base16), std::invalid_argument);
+}
+
+TEST(AESTest, EcbCipherMultipleBlocks)
+{
+    // NIST SP 800-38A F.1.1
+    AES::Key key = Base16::fromString("2b7e151628aed2a6abf7158809cf4f3c");
+    ByteArray input = Base16::fromString("6bc1bee22e409f96e93d7e117393172a"
+                                         "ae2d8a571e03ac9c9eb76fac45af8e51"
+                                         "30c81c46a35ce411e5fbc1191a0a52ef"
+                                         "f69f2445df4f9b17ad2b417be66c3710");
+    ByteArray expected = Base16::fromString("3ad77bb40d7a3660a89ecaf32466ef97"
+                                            "f5d3d58503b9699de785895a96fdbaaf"
+                                            "43b1cd7f598ece23881b00e3ed030688"
+                                            "7b0c785e27e8ad3f8223207104725dd4");
+    ASSERT_EQ(expected, aes.encrypt(input, &key, false));
+
+    ByteArray padded(input.begin(), input.begin() + 40);
+    ASSERT_EQ(padded, aes.decrypt(aes.encrypt(padded, &key), &key));
+}
+
+TEST(AESTest, RoundTables)
+{
+    // table driven rounds should be same as each step
+    // applied one by one as described in FIPS.197 Sec. 5.1
+    for (std::size_t keySize : { 16, 24, 32 }) {
+        AES::Key key = MineCommon::generateRandomBytes(keySize);
+        AES::KeySchedule keySchedule = aes.keyExpansion(&key);
+        const uint8_t rounds = AES::roundsForKey(keySize);
+        AES::KeySchedule inverseKeySchedule;
+        aes.toInverseKeySchedule(&keySchedule, rounds, &inverseKeySchedule);
+
+        for (int i = 0; i < 100; ++i) {
+            ByteArray input = MineCommon::generateRandomBytes(16);
+            AES::State state;
+            aes.initState(&state, input.begin());
+            aes.addRoundKey(&state, &keySchedule, 0);
+            for (int round = 1; round < rounds; ++round) {
+                aes.subBytes(&state);
+                aes.shiftRows(&state);
+                aes.mixColumns(&state);
+                aes.addRoundKey(&state, &keySchedule, round);
+            }
+            aes.subBytes(&state);
+            aes.shiftRows(&state);
+            aes.addRoundKey(&state, &keySchedule, rounds);
+            ByteArray expected = aes.stateToByteArray(&state);
+
+            ByteArray output(16);
+            aes.encryptBlock(input.data(), output.data(), &keySchedule, rounds);
+            ASSERT_EQ(expected, output);
+
+            aes.decryptBlock(output.data(), output.data(), &inverseKeySchedule, rounds);
+            ASSERT_EQ(input, output);
+        }
+    }
+}
+
+TEST(AESTest, CompileTimeCipher)
+{
+    ASSERT_EQ(10, AESCipher<128>::kRounds);
+    ASSERT_EQ(12, AESCipher<192>::kRounds);
+    ASSERT_EQ(14, AESCipher<256>::kRounds);
+    ASSERT_EQ(44, AESCipher<128>::kScheduleWords);
+    ASSERT_EQ(52, AESCipher<192>::kScheduleWords);
+    ASSERT_EQ(60, AESCipher<256>::kScheduleWords);
+    ASSERT_THROW(AES::roundsForKey(20), std::invalid_argument);
+
+    // FIPS.197 Appendix C
+    const ByteArray input = Base16::fromString("00112233445566778899AABBCCDDEEFF");
+    const ByteArray fullKey = Base16::fromString("000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F");
+    const std::vector<std::string> expected = {
+        "69C4E0D86A7B0430D8CDB78070B4C55A",
+        "DDA97CA4864CDFE06EAF70A0EC0D7191",
+        "8EA2B7CA516745BFEAFC49904B496089",
+    };
+    for (std::size_t i = 0; i < 3; ++i) {
+        const std::size_t keySize = 16 + (i * 8);
+        AES::Key key(fullKey.begin(), fullKey.begin() + keySize);
+        AES::KeySchedule keySchedule = aes.keyExpansion(&key);
+        AES::KeySchedule inverseKeySchedule;
+        aes.toInverseKeySchedule(&keySchedule, AES::roundsForKey(keySize), &inverseKeySchedule);
+
+        ByteArray output(16);
+        ByteArray decrypted(16);
+        if (keySize == 16) {
+            AESCipher<128>::encryptBlock(input.data(), output.data(), keySchedule.data());
+            AESCipher<128>::decryptBlock(output.data(), decrypted.data(), inverseKeySchedule.data());
+        } else if (keySize == 24) {
+            AESCipher<192>::encryptBlock(input.data(), output.data(), keySchedule.data());
+            AESCipher<192>::decryptBlock(output.data(), decrypted.data(), inverseKeySchedule.data());
+        } else {
+            AESCipher<256>::encryptBlock(input.data(), output.data(), keySchedule.data());
+            AESCipher<256>::decryptBlock(output.data(), decrypted.data(), inverseKeySchedule.data());
+        }
+        ASSERT_EQ(expected[i], Base16::encode(output.begin(), output.end()));
+        ASSERT_EQ(input, decrypted);
+
+        // instance picks same cipher when key is set and keeps it on copy
+        AES keyed(key);
+        AES copied(keyed);
+        ASSERT_EQ(AES::roundsForKey(keySize), copied.m_rounds);
+        ByteArray cipher(16);
+        copied.encr(input.data(), input.size(), cipher.data(), false);
+        ASSERT_EQ(output, cipher);
+    }
+
+    // many blocks same as block by block
+    AES::Key key = MineCommon::generateRandomBytes(32);
+    AES::KeySchedule keySchedule = aes.keyExpansion(&key);
+    ByteArray many = MineCommon::generateRandomBytes(16 * 9);
+    ByteArray output(many.size());
+    AESCipher<256>::encryptBlocks(many.data(), output.data(), 9, keySchedule.data());
+    for (std::size_t i = 0; i < 9; ++i) {
+        ByteArray block(16);
+        AESCipher<256>::encryptBlock(many.data() + (i * 16), block.data(), keySchedule.data());
+        ASSERT_TRUE(std::equal(block.begin(), block.end(), output.begin() + (i * 16)));
+    }
+}
+
+TEST(AESTest, Engines)
+{
+    AESSettingsGuard settings;
+
+    ASSERT_NE(AES::Engine::Auto, AES::engine());
+    ASSERT_TRUE(AES::isEngineSupported(AES::Engine::Portable));
+
+    AES::setEngine(AES::Engine::Portable);
+    ASSERT_EQ(AES::Engine::Portable, AES::engine());
+    AES::Key key = MineCommon::generateRandomBytes(32);
+    ByteArray iv = MineCommon::generateRandomBytes(16);
+    ByteArray input = MineCommon::generateRandomBytes(1000);
+    ByteArray expectedEcb = aes.encrypt(input, &key);
+    ByteArray expectedCbc = aes.encrypt(input, &key, iv);
+    std::vector<AES::Key> keys = {
+        MineCommon::generateRandomBytes(16),
+        MineCommon::generateRandomBytes(24),
+        key
+    };
+    std::vector<AES::KeySchedule> expectedKeySchedules;
+    for (auto& k : keys) {
+        expectedKeySchedules.push_back(aes.keyExpansion(&k));
+    }
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            LOG(INFO) << "Skipping unsupported engine " << static_cast<int>(engine);
+            continue;
+        }
+        AES::setEngine(engine);
+        ASSERT_EQ(engine, AES::engine());
+
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            ASSERT_EQ(expectedKeySchedules[i], aes.keyExpansion(&keys[i]));
+        }
+
+        for (auto& item : RawCipherData) {
+            std::string output = aes.encrypt(PARAM(0), PARAM(1), MineCommon::Encoding::Base16, MineCommon::Encoding::Base16, false);
+            ASSERT_STRCASEEQ(PARAM(2).c_str(), output.c_str());
+            output = aes.decrypt(PARAM(2), PARAM(1), MineCommon::Encoding::Base16, MineCommon::Encoding::Base16);
+            ASSERT_STRCASEEQ(PARAM(0).c_str(), output.c_str());
+        }
+
+        AES aesEngine(key);
+        ASSERT_EQ(expectedEcb, aesEngine.encr(input));
+        ASSERT_EQ(expectedCbc, aesEngine.encr(input, iv));
+        ASSERT_EQ(input, aesEngine.decr(expectedEcb));
+        ASSERT_EQ(input, aesEngine.decr(expectedCbc, iv));
+    }
+
+    // every number of blocks around engines' batch sizes, against portable engine
+    const uint8_t rounds = 14;
+    AES::KeySchedule keySchedule = aes.keyExpansion(&key);
+    AES::KeySchedule inverseKeySchedule;
+    AES::toInverseKeySchedule(&keySchedule, rounds, &inverseKeySchedule);
+    for (AES::Engine engine : { AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        for (std::size_t blocks = 0; blocks <= 70; ++blocks) {
+            ByteArray data = MineCommon::generateRandomBytes(blocks * 16);
+            ByteArray counterBlock = MineCommon::generateRandomBytes(16);
+            ByteArray expected[4] = { data, data, data, data };
+            ByteArray chain = iv;
+            AES::setEngine(AES::Engine::Portable);
+            AES::encryptBlocks(data.data(), expected[0].data(), blocks, &keySchedule, rounds);
+            AES::decryptBlocks(data.data(), expected[1].data(), blocks, &inverseKeySchedule, rounds);
+            AES::decryptCbcBlocks(data.data(), expected[2].data(), blocks, chain.data(), &inverseKeySchedule, rounds);
+            ByteArray counter = counterBlock;
+            AES::ctrBlocks(data.data(), expected[3].data(), blocks, counter.data(), 8, &keySchedule, rounds);
+
+            ByteArray actual = data;
+            ByteArray actualChain = iv;
+            AES::setEngine(engine);
+            AES::encryptBlocks(actual.data(), actual.data(), blocks, &keySchedule, rounds);
+            ASSERT_EQ(expected[0], actual);
+            actual = data;
+            AES::decryptBlocks(actual.data(), actual.data(), blocks, &inverseKeySchedule, rounds);
+            ASSERT_EQ(expected[1], actual);
+            actual = data;
+            AES::decryptCbcBlocks(actual.data(), actual.data(), blocks, actualChain.data(), &inverseKeySchedule, rounds);
+            ASSERT_EQ(expected[2], actual);
+            ASSERT_EQ(chain, actualChain);
+            actual = data;
+            ByteArray actualCounter = counterBlock;
+            AES::ctrBlocks(actual.data(), actual.data(), blocks, actualCounter.data(), 8, &keySchedule, rounds);
+            ASSERT_EQ(expected[3], actual);
+            ASSERT_EQ(counter, actualCounter);
+        }
+    }
+}
+
+TEST(AESTest, CipherToBuffer)
+{
+    ASSERT_EQ(16u, AES::encryptedSize(0));
+    ASSERT_EQ(16u, AES::encryptedSize(15));
+    ASSERT_EQ(32u, AES::encryptedSize(16));
+    ASSERT_EQ(0u, AES::encryptedSize(0, false));
+    ASSERT_EQ(16u, AES::encryptedSize(15, false));
+    ASSERT_EQ(16u, AES::encryptedSize(16, false));
+
+    AES::Key key = Base16::fromString("163E6AC9A9EB43253AC237D849BDD22C4798393D38FBE322F7E593E318F1AEAF");
+    ByteArray iv = Base16::fromString("a14c54563269e9e368f56b325f04ff00");
+    AES aesBuffer(key);
+
+    // same as EncryptResultsForLongTextMatchesRipe
+    const std::string input = "abcdefgabcdefgab";
+    byte output[32];
+    ASSERT_EQ(32u, aesBuffer.encr(reinterpret_cast<const byte*>(input.data()), input.size(), output, iv.data()));
+    ASSERT_EQ(Base16::fromString("CF85BA7FB9F2A908DC2DBF1017EA987E90C8DEBE266C11831528F85B1DB0DCE5"), ByteArray(output, output + 32));
+
+    byte plain[32];
+    ASSERT_EQ(input.size(), aesBuffer.decr(output, 32, plain, iv.data()));
+    ASSERT_EQ(input, std::string(plain, plain + input.size()));
+
+    for (std::size_t length : { 0, 1, 15, 16, 17, 100, 256 }) {
+        ByteArray data = MineCommon::generateRandomBytes(length);
+        ByteArray buffer(AES::encryptedSize(length));
+
+        // ECB
+        ASSERT_EQ(buffer.size(), aesBuffer.encr(data.data(), length, buffer.data()));
+        if (length % 16 != 0) {
+            ASSERT_EQ(aesBuffer.encr(data), buffer);
+        }
+        ASSERT_EQ(length, aesBuffer.decr(buffer.data(), buffer.size(), buffer.data()));
+        ASSERT_EQ(data, ByteArray(buffer.begin(), buffer.begin() + length));
+
+        // CBC
+        buffer.resize(AES::encryptedSize(length));
+        ASSERT_EQ(buffer.size(), aesBuffer.encr(data.data(), length, buffer.data(), iv.data()));
+        if (length % 16 != 0) {
+            ASSERT_EQ(aesBuffer.encr(data, iv), buffer);
+        }
+        ASSERT_EQ(length, aesBuffer.decr(buffer.data(), buffer.size(), buffer.data(), iv.data()));
+        ASSERT_EQ(data, ByteArray(buffer.begin(), buffer.begin() + length));
+    }
+
+    ASSERT_THROW(aesBuffer.decr(output, 31, plain), std::invalid_argument);
+    AES noKey;
+    ASSERT_THROW(noKey.encr(plain, 16, output), std::runtime_error);
+}
+
+TEST(AESTest, CtrCipher)
+{
+    AESSettingsGuard settings;
+
+    // NIST SP 800-38A F.5.1 and F.5.5
+    ByteArray counterBlock = Base16::fromString("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    ByteArray input = Base16::fromString("6bc1bee22e409f96e93d7e117393172a"
+                                         "ae2d8a571e03ac9c9eb76fac45af8e51"
+                                         "30c81c46a35ce411e5fbc1191a0a52ef"
+                                         "f69f2445df4f9b17ad2b417be66c3710");
+    AES::Key key = Base16::fromString("2b7e151628aed2a6abf7158809cf4f3c");
+    ByteArray expected = Base16::fromString("874d6191b620e3261bef6864990db6ce"
+                                            "9806f66b7970fdff8617187bb9fffdff"
+                                            "5ae4df3edbd5d35e5b4f09020db03eab"
+                                            "1e031dda2fbe03d1792170a0f3009cee");
+    ASSERT_EQ(expected, aes.encryptCtr(input, &key, counterBlock));
+    ASSERT_EQ(input, aes.decryptCtr(expected, &key, counterBlock));
+
+    key = Base16::fromString("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+    expected = Base16::fromString("601ec313775789a5b7a7f504bbf3d228"
+                                  "f443e3ca4d62b59aca84e990cacaf5c5"
+                                  "2b0930daa23de94ce87017ba2d84988d"
+                                  "dfc9c58db67aada613c2dd08457941a6");
+    ASSERT_EQ(expected, aes.encryptCtr(input, &key, counterBlock));
+
+    // no padding for partial block
+    ByteArray partial(input.begin(), input.begin() + 21);
+    ASSERT_EQ(ByteArray(expected.begin(), expected.begin() + 21), aes.encryptCtr(partial, &key, counterBlock));
+
+    // counter wraps around within counter bytes, nonce stays same
+    ByteArray counter = Base16::fromString("fffffffffffffffffffffffffffffffe");
+    AES::incrementCounter(counter.data(), 4, 3);
+    ASSERT_EQ(Base16::fromString("ffffffffffffffffffffffff00000001"), counter);
+    AES::incrementCounter(counter.data(), 16, 0x1ff);
+    ASSERT_EQ(Base16::fromString("ffffffffffffffffffffffff00000200"), counter);
+
+    AES aesCtr(key);
+    counterBlock = Base16::fromString("0102030405060708090a0b0cfffffffe");
+    ByteArray keyStream = Base16::fromString("0102030405060708090a0b0cfffffffe"
+                                             "0102030405060708090a0b0cffffffff"
+                                             "0102030405060708090a0b0c00000000");
+    ASSERT_EQ(aesCtr.encr(keyStream, false), aesCtr.encrCtr(ByteArray(48, 0), counterBlock, 4));
+
+    // seeking in to the stream
+    ByteArray data = MineCommon::generateRandomBytes(1000);
+    ByteArray cipher = aesCtr.encrCtr(data, counterBlock, 8);
+    ByteArray part(100);
+    aesCtr.decrCtr(cipher.data() + 320, part.size(), part.data(), counterBlock.data(), 8, 20);
+    ASSERT_EQ(ByteArray(data.begin() + 320, data.begin() + 420), part);
+
+    // large input split across threads must give same result
+    data = MineCommon::generateRandomBytes((AES::kMinBlocksPerThread * 16 * 3) + 7);
+    AES::setThreadCount(1);
+    cipher = aesCtr.encrCtr(data, counterBlock, 4);
+    AES::setThreadCount(4);
+    ASSERT_EQ(4u, AES::threadCount());
+    ASSERT_EQ(cipher, aesCtr.encrCtr(data, counterBlock, 4));
+    aesCtr.decrCtr(cipher.data(), cipher.size(), cipher.data(), counterBlock.data(), 4);
+    ASSERT_EQ(data, cipher);
+    AES::setThreadCount(0);
+    ASSERT_LE(1u, AES::threadCount());
+
+    // engines agree on counters crossing 32-bit boundary (AES-NI makes counter blocks in registers)
+    data = MineCommon::generateRandomBytes((100 * 16) + 9);
+    counterBlock = Base16::fromString("0102030405060708ffffffffffffffd0");
+    for (std::size_t counterSize : { 4, 5, 8, 16 }) {
+        AES::setEngine(AES::Engine::Portable);
+        cipher = aesCtr.encrCtr(data, counterBlock, counterSize);
+        for (AES::Engine engine : { AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+            if (AES::isEngineSupported(engine)) {
+                AES::setEngine(engine);
+                ASSERT_EQ(cipher, aesCtr.encrCtr(data, counterBlock, counterSize));
+            }
+        }
+    }
+
+    ASSERT_THROW(aesCtr.encrCtr(data, counterBlock, 0), std::invalid_argument);
+    ASSERT_THROW(aesCtr.encrCtr(data, ByteArray(15, 0)), std::invalid_argument);
+}
+
+TEST(AESTest, GcmCipher)
+{
+    AESSettingsGuard settings;
+
+    // key, iv, aad, input, cipher, tag
+    static TestData<std::string, std::string, std::string, std::string, std::string, std::string> GcmCipherData = {
+        // NIST GCM test case 2
+        TestCase("00000000000000000000000000000000", "000000000000000000000000", "", "00000000000000000000000000000000", "0388dace60b6a392f328c2b971b2fe78", "ab6e47d42cec13bdf53a67b21257bddf"),
+        // NIST GCM test case 4
+        TestCase("feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+                 "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+                 "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091", "5bc94fbc3221a5db94fae95ae7121a47"),
+        // IV that is not 96-bit
+        TestCase("feffe9928665731c6d6a8f9467308308", "9313225df88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+                 "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+                 "2b4b26fb49f400296428f090cdb8671a60f2f674c7d2635c67c52763caccfb7afbde37c47ceaeaf102e38224d71d8e8c6a6ed055a28dcef35ee92cd9", "9a58d4b7c0030413d4cc72a5b67c11df"),
+        // 256-bit key
+        TestCase("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+                 "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+                 "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662", "76fc6ece0f4e1768cddf8853bb2d551b"),
+        // 192-bit key, only tag
+        TestCase("feffe9928665731c6d6a8f9467308308feffe9928665731c", "cafebabefacedbaddecaf888", "", "", "", "c835aa88aebbc94f5a02e179fdcfc3e4"),
+    };
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        for (auto& item : GcmCipherData) {
+            AES::Key key = Base16::fromString(PARAM(0));
+            ByteArray iv = Base16::fromString(PARAM(1));
+            ByteArray aad = Base16::fromString(PARAM(2));
+            ByteArray input = Base16::fromString(PARAM(3));
+            ByteArray expected = Base16::fromString(PARAM(4));
+            ByteArray expectedTag = Base16::fromString(PARAM(5));
+            ByteArray tag;
+            ASSERT_EQ(expected, aes.encryptGcm(input, &key, iv, aad, tag));
+            ASSERT_EQ(expectedTag, tag);
+            ASSERT_EQ(input, aes.decryptGcm(expected, &key, iv, aad, tag));
+
+            // truncated tag
+            aes.encryptGcm(input, &key, iv, aad, tag, 12);
+            ASSERT_EQ(ByteArray(expectedTag.begin(), expectedTag.begin() + 12), tag);
+            ASSERT_EQ(input, aes.decryptGcm(expected, &key, iv, aad, tag));
+        }
+
+        // multiple chunks with partial last block
+        AES::Key key = Base16::fromString("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+        ByteArray iv = Base16::fromString("0f0e0d0c0b0a09080706050403020100");
+        ByteArray aad(33);
+        ByteArray input(3001);
+        for (std::size_t i = 0; i < aad.size(); ++i) {
+            aad[i] = static_cast<byte>(i);
+        }
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            input[i] = static_cast<byte>(i * 7);
+        }
+        ByteArray tag;
+        ByteArray cipher = aes.encryptGcm(input, &key, iv, aad, tag);
+        ASSERT_EQ(Base16::fromString("123d76509de99c4858827f79dbb3d35b"), tag);
+        ASSERT_EQ(input, aes.decryptGcm(cipher, &key, iv, aad, tag));
+
+        // any change must fail authentication
+        cipher[1000] ^= 1;
+        ASSERT_THROW(aes.decryptGcm(cipher, &key, iv, aad, tag), std::runtime_error);
+        cipher[1000] ^= 1;
+        aad[0] ^= 1;
+        ASSERT_THROW(aes.decryptGcm(cipher, &key, iv, aad, tag), std::runtime_error);
+        aad[0] ^= 1;
+        tag[15] ^= 1;
+        ASSERT_THROW(aes.decryptGcm(cipher, &key, iv, aad, tag), std::runtime_error);
+        tag[15] ^= 1;
+
+        // in-place with buffer
+        AES aesGcm(key);
+        aesGcm.decrGcm(cipher.data(), cipher.size(), cipher.data(), iv.data(), iv.size(), aad.data(), aad.size(), tag.data(), tag.size());
+        ASSERT_EQ(input, cipher);
+    }
+
+    AES aesGcm(MineCommon::generateRandomBytes(16));
+    ByteArray iv;
+    ByteArray tag;
+    ByteArray input = MineCommon::generateRandomBytes(100);
+    ByteArray cipher = aesGcm.encrGcm(input, iv, ByteArray(), tag);
+    ASSERT_EQ(12u, iv.size());
+    ASSERT_EQ(16u, tag.size());
+    ASSERT_EQ(input, aesGcm.decrGcm(cipher, iv, ByteArray(), tag));
+    ASSERT_THROW(aesGcm.encrGcm(input, iv, ByteArray(), tag, 10), std::invalid_argument);
+    ASSERT_THROW(aesGcm.decrGcm(cipher, ByteArray(), ByteArray(), tag), std::invalid_argument);
+}
+
+TEST(AESTest, CcmCipher)
+{
+    AESSettingsGuard settings;
+
+    // key, nonce, aad, input, cipher, tag
+    static TestData<std::string, std::string, std::string, std::string, std::string, std::string> CcmCipherData = {
+        // NIST SP 800-38C example 1
+        TestCase("404142434445464748494a4b4c4d4e4f", "10111213141516", "0001020304050607", "20212223", "7162015b", "4dac255d"),
+        // NIST SP 800-38C example 2
+        TestCase("404142434445464748494a4b4c4d4e4f", "1011121314151617", "000102030405060708090a0b0c0d0e0f", "202122232425262728292a2b2c2d2e2f",
+                 "d2a1f0e051ea5f62081a7792073d593d", "1fc64fbfaccd"),
+        // NIST SP 800-38C example 3
+        TestCase("404142434445464748494a4b4c4d4e4f", "101112131415161718191a1b", "000102030405060708090a0b0c0d0e0f10111213",
+                 "202122232425262728292a2b2c2d2e2f3031323334353637", "e3b201a9f5b71a7a9b1ceaeccd97e70b6176aad9a4428aa5", "484392fbc1b09951"),
+        // no associated data, 64-bit nonce, partial last block
+        TestCase("000102030405060708090a0b0c0d0e0f", "0f0e0d0c0b0a0908", "", "00070e151c232a31383f464d545b626970",
+                 "87e893bb0f87b57350e78a31b2a8d9b38f", "addb9c58"),
+    };
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        for (auto& item : CcmCipherData) {
+            AES::Key key = Base16::fromString(PARAM(0));
+            ByteArray nonce = Base16::fromString(PARAM(1));
+            ByteArray aad = Base16::fromString(PARAM(2));
+            ByteArray input = Base16::fromString(PARAM(3));
+            ByteArray expected = Base16::fromString(PARAM(4));
+            ByteArray expectedTag = Base16::fromString(PARAM(5));
+            ByteArray tag;
+            ASSERT_EQ(expected, aes.encryptCcm(input, &key, nonce, aad, tag, expectedTag.size()));
+            ASSERT_EQ(expectedTag, tag);
+            ASSERT_EQ(input, aes.decryptCcm(expected, &key, nonce, aad, tag));
+        }
+
+        // multiple blocks with partial last block
+        AES::Key key = Base16::fromString("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+        ByteArray nonce = Base16::fromString("0f0e0d0c0b0a09080706050403");
+        ByteArray aad(33);
+        ByteArray input(3001);
+        for (std::size_t i = 0; i < aad.size(); ++i) {
+            aad[i] = static_cast<byte>(i);
+        }
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            input[i] = static_cast<byte>(i * 7);
+        }
+        ByteArray tag;
+        ByteArray cipher = aes.encryptCcm(input, &key, nonce, aad, tag);
+        ASSERT_EQ(Base16::fromString("faa70e7b67675f3f4e9a0d72f58be137"), tag);
+        ASSERT_EQ(input, aes.decryptCcm(cipher, &key, nonce, aad, tag));
+
+        // any change must fail authentication
+        cipher[1000] ^= 1;
+        ASSERT_THROW(aes.decryptCcm(cipher, &key, nonce, aad, tag), std::runtime_error);
+        cipher[1000] ^= 1;
+        aad[0] ^= 1;
+        ASSERT_THROW(aes.decryptCcm(cipher, &key, nonce, aad, tag), std::runtime_error);
+        aad[0] ^= 1;
+        tag[15] ^= 1;
+        ASSERT_THROW(aes.decryptCcm(cipher, &key, nonce, aad, tag), std::runtime_error);
+        tag[15] ^= 1;
+
+        // in-place with buffer
+        AES aesCcm(key);
+        aesCcm.decrCcm(cipher.data(), cipher.size(), cipher.data(), nonce.data(), nonce.size(), aad.data(), aad.size(), tag.data(), tag.size());
+        ASSERT_EQ(input, cipher);
+
+        // associated data of 2^16 - 2^8 bytes or more has longer length encoding
+        AES::Key key192(key.begin(), key.begin() + 24);
+        ByteArray shortNonce(nonce.begin(), nonce.begin() + 7);
+        ByteArray largeAad(70000);
+        for (std::size_t i = 0; i < largeAad.size(); ++i) {
+            largeAad[i] = static_cast<byte>(i * 3);
+        }
+        ByteArray shortInput(input.begin(), input.begin() + 100);
+        cipher = aes.encryptCcm(shortInput, &key192, shortNonce, largeAad, tag, 10);
+        ASSERT_EQ(Base16::fromString("528b0205c64b2fda341b8de147c08cdb206176f3e1cfc29d71ba2b9888067dd856accbc2dcea26176c14faf5b6236e8fdc4b935832da843ba9a13a050efefd64c24ab7a2431599d03be2e65d55ef8cffe04fce5e22a8fa086f2ee49e6a172151bc0ed804"), cipher);
+        ASSERT_EQ(Base16::fromString("5cdbd09448ea219f545e"), tag);
+        ASSERT_EQ(shortInput, aes.decryptCcm(cipher, &key192, shortNonce, largeAad, tag));
+    }
+
+    AES aesCcm(MineCommon::generateRandomBytes(16));
+    ByteArray nonce;
+    ByteArray tag;
+    ByteArray input = MineCommon::generateRandomBytes(100);
+    ByteArray cipher = aesCcm.encrCcm(input, nonce, ByteArray(), tag);
+    ASSERT_EQ(12u, nonce.size());
+    ASSERT_EQ(16u, tag.size());
+    ASSERT_EQ(input, aesCcm.decrCcm(cipher, nonce, ByteArray(), tag));
+    ASSERT_THROW(aesCcm.encrCcm(input, nonce, ByteArray(), tag, 5), std::invalid_argument);
+    ASSERT_THROW(aesCcm.decrCcm(cipher, ByteArray(6), ByteArray(), tag), std::invalid_argument);
+    ASSERT_THROW(aesCcm.decrCcm(cipher, ByteArray(14), ByteArray(), tag), std::invalid_argument);
+
+    // 13-byte nonce leaves two bytes for length
+    ByteArray longNonce(13);
+    ASSERT_THROW(aesCcm.encrCcm(ByteArray(0x10000), longNonce, ByteArray(), tag), std::invalid_argument);
+    ASSERT_NO_THROW(aesCcm.encrCcm(ByteArray(0xffff), longNonce, ByteArray(), tag));
+}
+
+TEST(AESTest, CbcDecipherParallel)
+{
+    AESSettingsGuard settings;
+
+    AES::Key key = MineCommon::generateRandomBytes(24);
+    ByteArray iv = MineCommon::generateRandomBytes(16);
+    AES aesCbc(key);
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        // partial batches of interleaved blocks
+        for (std::size_t length = 0; length < 300; length += 13) {
+            ByteArray input = MineCommon::generateRandomBytes(length);
+            ByteArray cipher(AES::encryptedSize(length));
+            aesCbc.encr(input.data(), length, cipher.data(), iv.data());
+            ASSERT_EQ(length, aesCbc.decr(cipher.data(), cipher.size(), cipher.data(), iv.data()));
+            ASSERT_EQ(input, ByteArray(cipher.begin(), cipher.begin() + length));
+        }
+
+        // large input split across threads, in-place
+        ByteArray input = MineCommon::generateRandomBytes((AES::kMinBlocksPerThread * 16 * 3) + 5);
+        ByteArray cipher(AES::encryptedSize(input.size()));
+        aesCbc.encr(input.data(), input.size(), cipher.data(), iv.data());
+        AES::setThreadCount(4);
+        ASSERT_EQ(input.size(), aesCbc.decr(cipher.data(), cipher.size(), cipher.data(), iv.data()));
+        ASSERT_EQ(input, ByteArray(cipher.begin(), cipher.begin() + input.size()));
+    }
+}
+
+TEST(AESTest, StreamCipher)
+{
+    AES::Key key = MineCommon::generateRandomBytes(32);
+    ByteArray iv = MineCommon::generateRandomBytes(16);
+    AES aes(key);
+
+    for (const ByteArray& ivec : { ByteArray(), iv }) {
+        for (bool pkcs5Padding : { true, false }) {
+            for (std::size_t length : { 0, 1, 15, 16, 17, 100, 1024, 5000 }) {
+                ByteArray input = MineCommon::generateRandomBytes(length);
+                ByteArray expected(AES::encryptedSize(length, pkcs5Padding));
+                if (ivec.empty()) {
+                    expected.resize(aes.encr(input.data(), length, expected.data(), pkcs5Padding));
+                } else {
+                    expected.resize(aes.encr(input.data(), length, expected.data(), ivec.data(), pkcs5Padding));
+                }
+
+                for (std::size_t chunkSize : { 1, 7, 16, 33, 4096 }) {
+                    AESEncryptor encryptor(key, ivec, pkcs5Padding);
+                    ByteArray cipher;
+                    for (std::size_t i = 0; i < length; i += chunkSize) {
+                        ByteArray chunk = encryptor.update(ByteArray(input.begin() + i, input.begin() + std::min(length, i + chunkSize)));
+                        cipher.insert(cipher.end(), chunk.begin(), chunk.end());
+                    }
+                    ByteArray last = encryptor.final();
+                    cipher.insert(cipher.end(), last.begin(), last.end());
+                    ASSERT_EQ(expected, cipher);
+                    ASSERT_THROW(encryptor.update(input), std::runtime_error);
+
+                    if (!pkcs5Padding) {
+                        continue;
+                    }
+                    AESDecryptor decryptor(key, ivec);
+                    ByteArray plain;
+                    for (std::size_t i = 0; i < cipher.size(); i += chunkSize) {
+                        ByteArray chunk = decryptor.update(ByteArray(cipher.begin() + i, cipher.begin() + std::min(cipher.size(), i + chunkSize)));
+                        plain.insert(plain.end(), chunk.begin(), chunk.end());
+                    }
+                    last = decryptor.final();
+                    plain.insert(plain.end(), last.begin(), last.end());
+                    ASSERT_EQ(input, plain);
+                }
+            }
+        }
+    }
+
+    AESDecryptor decryptor(key, iv);
+    decryptor.update(ByteArray(20));
+    ASSERT_THROW(decryptor.final(), std::invalid_argument);
+    ASSERT_THROW(AESEncryptor(key, ByteArray(8)), std::invalid_argument);
+    ASSERT_THROW(AESDecryptor(ByteArray(8)), std::invalid_argument);
+}
+
+TEST(AESTest, InverseKeySchedule)
+{
+    AES::Key key128 = MineCommon::generateRandomBytes(16);
+    AES::Key key256 = MineCommon::generateRandomBytes(32);
+    AES::KeySchedule inverseKeySchedule;
+
+    AES aes(key128);
+    AES::toInverseKeySchedule(&aes.m_keySchedule, 10, &inverseKeySchedule);
+    ASSERT_EQ(inverseKeySchedule, aes.m_inverseKeySchedule);
+
+    // key changed by keyed function
+    ByteArray iv = MineCommon::generateRandomBytes(16);
+    ByteArray input = MineCommon::generateRandomBytes(100);
+    ByteArray cipher = aes.encrypt(input, &key256, iv);
+    AES::toInverseKeySchedule(&aes.m_keySchedule, 14, &inverseKeySchedule);
+    ASSERT_EQ(inverseKeySchedule, aes.m_inverseKeySchedule);
+
+    AES copy(aes);
+    ASSERT_EQ(inverseKeySchedule, copy.m_inverseKeySchedule);
+    ASSERT_EQ(input, copy.decr(cipher, iv));
+
+    copy.setKey(key128);
+    AES::toInverseKeySchedule(&copy.m_keySchedule, 10, &inverseKeySchedule);
+    ASSERT_EQ(inverseKeySchedule, copy.m_inverseKeySchedule);
+}
+
+TEST(AESTest, KeyScheduleCache)
+{
+    AESSettingsGuard settings;
+
+    AES::Key keyA = MineCommon::generateRandomBytes(16);
+    AES::Key keyB = MineCommon::generateRandomBytes(24);
+    AES::Key keyC = MineCommon::generateRandomBytes(32);
+
+    AES::setKeyScheduleCacheCapacity(2);
+    AES::clearKeyScheduleCache();
+
+    AES aes(keyA);
+    aes.setKey(keyB);
+    ASSERT_EQ(0, AES::keyScheduleCacheHits());
+    ASSERT_EQ(2, AES::keyScheduleCacheMisses());
+
+    AES other(keyA);
+    ASSERT_EQ(1, AES::keyScheduleCacheHits());
+    ASSERT_EQ(AES::keyExpansion(&keyA), other.m_keySchedule);
+    AES::KeySchedule inverseKeySchedule;
+    AES::toInverseKeySchedule(&other.m_keySchedule, 10, &inverseKeySchedule);
+    ASSERT_EQ(inverseKeySchedule, other.m_inverseKeySchedule);
+
+    // B is least recently used
+    other.setKey(keyC);
+    ASSERT_EQ(3, AES::keyScheduleCacheMisses());
+    other.setKey(keyA);
+    ASSERT_EQ(2, AES::keyScheduleCacheHits());
+    other.setKey(keyB);
+    ASSERT_EQ(4, AES::keyScheduleCacheMisses());
+    ASSERT_EQ(AES::keyExpansion(&keyB), other.m_keySchedule);
+
+    // keyed functions and streams go through the cache too
+    ByteArray iv = MineCommon::generateRandomBytes(16);
+    ByteArray input = MineCommon::generateRandomBytes(40);
+    ByteArray cipher = aes.encrypt(input, &keyA, iv);
+    ASSERT_EQ(3, AES::keyScheduleCacheHits());
+    AESDecryptor decryptor(keyA, iv);
+    ASSERT_EQ(4, AES::keyScheduleCacheHits());
+    ByteArray plain = decryptor.update(cipher);
+    ByteArray last = decryptor.final();
+    plain.insert(plain.end(), last.begin(), last.end());
+    ASSERT_EQ(input, plain);
+
+    // disabled
+    AES::setKeyScheduleCacheCapacity(0);
+    other.setKey(keyA);
+    ASSERT_EQ(4, AES::keyScheduleCacheHits());
+    ASSERT_EQ(4, AES::keyScheduleCacheMisses());
+    AES::clearKeyScheduleCache();
+    ASSERT_EQ(0, AES::keyScheduleCacheMisses());
+}
+
+TEST(AESTest, CbcCipherBatch)
+{
+    AESSettingsGuard settings;
+
+    AES::Key key = MineCommon::generateRandomBytes(16);
+    AES aesCbc(key);
+
+    // lengths differ so lanes finish at different times and are refilled
+    std::vector<ByteArray> inputs;
+    std::vector<ByteArray> ivs;
+    for (std::size_t length : { 0, 1, 15, 16, 17, 31, 32, 100, 250, 4, 64, 1000, 48, 33, 7, 16, 500, 0, 129 }) {
+        inputs.push_back(MineCommon::generateRandomBytes(length));
+        ivs.push_back(MineCommon::generateRandomBytes(16));
+    }
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        for (bool pkcs5Padding : { true, false }) {
+            std::vector<ByteArray> outputs;
+            std::vector<AES::Message> messages;
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                outputs.push_back(ByteArray(AES::encryptedSize(inputs[i].size(), pkcs5Padding)));
+            }
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                messages.push_back({ inputs[i].data(), inputs[i].size(), outputs[i].data(), ivs[i].data() });
+            }
+            aesCbc.encrCbcBatch(messages.data(), messages.size(), pkcs5Padding);
+
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                ByteArray expected(AES::encryptedSize(inputs[i].size(), pkcs5Padding));
+                aesCbc.encr(inputs[i].data(), inputs[i].size(), expected.data(), ivs[i].data(), pkcs5Padding);
+                ASSERT_EQ(expected, outputs[i]);
+            }
+        }
+    }
+
+    AES noKey;
+    ASSERT_THROW(noKey.encrCbcBatch(nullptr, 0), std::runtime_error);
+}
+
+TEST(AESTest, KeyedCbcCipherBatch)
+{
+    AESSettingsGuard settings;
+
+    // last key is a different handle of same bytes as second key
+    std::vector<AES::Key> keys = { MineCommon::generateRandomBytes(16), MineCommon::generateRandomBytes(24), MineCommon::generateRandomBytes(16) };
+    keys.push_back(keys[1]);
+    std::vector<ByteArray> inputs;
+    std::vector<ByteArray> ivs;
+    std::vector<ByteArray> outputs;
+    std::vector<AES::KeyedMessage> messages;
+    for (std::size_t n = 0; n < 12; ++n) {
+        inputs.push_back(MineCommon::generateRandomBytes(n * 21));
+        ivs.push_back(MineCommon::generateRandomBytes(16));
+        outputs.push_back(ByteArray(AES::encryptedSize(inputs[n].size())));
+    }
+    for (std::size_t n = 0; n < inputs.size(); ++n) {
+        messages.push_back({ &keys[n % keys.size()], inputs[n].data(), inputs[n].size(), outputs[n].data(), ivs[n].data() });
+    }
+
+    // each distinct key is expanded once
+    AES::setKeyScheduleCacheCapacity(8);
+    AES::clearKeyScheduleCache();
+    AES::encrCbcKeyedBatch(messages.data(), messages.size());
+    ASSERT_EQ(3, AES::keyScheduleCacheMisses());
+    ASSERT_EQ(0, AES::keyScheduleCacheHits());
+
+    for (std::size_t n = 0; n < inputs.size(); ++n) {
+        ByteArray expected(AES::encryptedSize(inputs[n].size()));
+        AES(*messages[n].key).encr(inputs[n].data(), inputs[n].size(), expected.data(), ivs[n].data());
+        ASSERT_EQ(expected, outputs[n]);
+    }
+
+    AES::Key badKey(20);
+    AES::KeyedMessage message = { &badKey, inputs[0].data(), inputs[0].size(), nullptr, ivs[0].data() };
+    ASSERT_THROW(AES::encrCbcKeyedBatch(&message, 1), std::invalid_argument);
+}
+
+TEST(AESTest, XtsCipher)
+{
+    AESSettingsGuard settings;
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        // IEEE Std 1619-2007 Vector 2
+        AES::Key key = Base16::fromString("11111111111111111111111111111111"
+                                          "22222222222222222222222222222222");
+        ByteArray input = Base16::fromString("4444444444444444444444444444444444444444444444444444444444444444");
+        ByteArray expected = Base16::fromString("c454185e6a16936e39334038acef838bfb186fff7480adc4289382ecd6d394f0");
+        ASSERT_EQ(expected, aes.encryptXts(input, &key, 0x3333333333ULL, input.size()));
+        ASSERT_EQ(input, aes.decryptXts(expected, &key, 0x3333333333ULL, input.size()));
+
+        // three sectors, last one is short and uses ciphertext stealing
+        input = Base16::fromString("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+                                   "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+                                   "404142434445464748494a4b4c4d4e4f50");
+        key = Base16::fromString("fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0");
+        expected = Base16::fromString("a5b5da006745aaec077ecfc57cb11057ff2d41dc92ddbcc3c282f39f214aab09"
+                                      "e96c865abbee3aa1d39a28669e0aa4d8e80795136f9cf7d0f55bc3b4335c9dd4"
+                                      "38b26ae02790d618e68d08ad921487743d");
+        ASSERT_EQ(expected, aes.encryptXts(input, &key, 9, 32));
+        ASSERT_EQ(input, aes.decryptXts(expected, &key, 9, 32));
+
+        key = Base16::fromString("27182818284590452353602874713526624977572470936999595749669676273141592653589793238462643383279502884197169399375105820974944592");
+        expected = Base16::fromString("65c63604162dd1c7701bb42ae17b1d51832aa71c2415caa3649f72c41ed0f8bc"
+                                      "011d4395dee88946857c6ec8e91e1236dc1e947d8e2e7702f2e0f464dc994784"
+                                      "c86b464d27682d02ac82c469a7eb0a3399");
+        ASSERT_EQ(expected, aes.encryptXts(input, &key, 9, 32));
+        ASSERT_EQ(input, aes.decryptXts(expected, &key, 9, 32));
+
+        // IEEE Std 1619-2007 Vector 10, 512-bit key
+        input.clear();
+        for (int i = 0; i < 512; ++i) {
+            input.push_back(static_cast<byte>(i));
+        }
+        ByteArray cipher = aes.encryptXts(input, &key, 0xff);
+        ASSERT_EQ(Base16::fromString("1c3b3a102f770386e4836c99e370cf9bea00803f5e482357a4ae12d414a3e63b"), ByteArray(cipher.begin(), cipher.begin() + 32));
+    }
+
+    // many sectors split across threads (in-place) must give same result as one sector at a time
+    AES::Key key = Base16::fromString("fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0");
+    AES aesXts(ByteArray(key.begin(), key.begin() + 16));
+    AES::Key tweakKey(key.begin() + 16, key.end());
+    ByteArray input = MineCommon::generateRandomBytes((AES::kMinBlocksPerThread * 16 * 3) + 100);
+    ByteArray cipher = input;
+    AES::setThreadCount(4);
+    aesXts.encrXts(cipher.data(), cipher.size(), cipher.data(), &tweakKey, 1000, 4096);
+    AES::setThreadCount(0);
+    for (std::size_t offset = 0; offset < input.size(); offset += 4096) {
+        const std::size_t size = std::min<std::size_t>(4096, input.size() - offset);
+        ByteArray sector(size);
+        aesXts.encrXts(input.data() + offset, size, sector.data(), &tweakKey, 1000 + (offset / 4096), 4096);
+        ASSERT_EQ(sector, ByteArray(cipher.begin() + offset, cipher.begin() + offset + size));
+    }
+    AES::setThreadCount(4);
+    aesXts.decrXts(cipher.data(), cipher.size(), cipher.data(), &tweakKey, 1000, 4096);
+    ASSERT_EQ(input, cipher);
+
+    AES::Key badKey(40, 0x01);
+    ASSERT_THROW(aes.encryptXts(input, &badKey, 0), std::invalid_argument);
+    ASSERT_THROW(aesXts.encrXts(input.data(), 15, cipher.data(), &tweakKey, 0), std::invalid_argument);
+    ASSERT_THROW(aesXts.encrXts(input.data(), 40, cipher.data(), &tweakKey, 0, 32), std::invalid_argument);
+    ASSERT_THROW(aesXts.encrXts(input.data(), 32, cipher.data(), &key, 0), std::invalid_argument);
+    AES::Key sameKey(key.begin(), key.begin() + 16);
+    ASSERT_THROW(aesXts.encrXts(input.data(), 32, cipher.data(), &sameKey, 0), std::invalid_argument);
+}
+
+TEST(AESTest, SivCipher)
+{
+    AESSettingsGuard settings;
+
+    // key, aad (comma separated), input, output
+    static TestData<std::string, std::string, std::string, std::string> SivCipherData = {
+        // RFC 5297 A.1
+        TestCase("fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", "101112131415161718191a1b1c1d1e1f2021222324252627",
+                 "112233445566778899aabbccddee", "85632d07c6e8f37f950acd320a2ecc9340c02b9690c4dc04daef7f6afe5c"),
+        // RFC 5297 A.2, nonce is last associated data
+        TestCase("7f7e7d7c7b7a79787776757473727170404142434445464748494a4b4c4d4e4f", "00112233445566778899aabbccddeeffdeaddadadeaddadaffeeddccbbaa99887766554433221100,102030405060708090a0,09f911029d74e35bd84156c5635688c0",
+                 "7468697320697320736f6d6520706c61696e7465787420746f20656e6372797074207573696e67205349562d414553",
+                 "7bdb6e3b432667eb06f4d14bff2fbd0fcb900f2fddbe404326601965c889bf17dba77ceb094fa663b7a3f748ba8af829ea64ad544a272e9c485b62a3fd5c0d"),
+    };
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        for (auto& item : SivCipherData) {
+            AES::Key key = Base16::fromString(PARAM(0));
+            std::vector<ByteArray> aad;
+            std::stringstream ss(PARAM(1));
+            std::string part;
+            while (std::getline(ss, part, ',')) {
+                aad.push_back(Base16::fromString(part));
+            }
+            ByteArray input = Base16::fromString(PARAM(2));
+            ByteArray expected = Base16::fromString(PARAM(3));
+            ASSERT_EQ(expected, aes.encryptSiv(input, &key, aad));
+            ASSERT_EQ(input, aes.decryptSiv(expected, &key, aad));
+
+            // any change must fail authentication
+            expected[expected.size() - 1] ^= 1;
+            ASSERT_THROW(aes.decryptSiv(expected, &key, aad), std::runtime_error);
+            expected[expected.size() - 1] ^= 1;
+            aad[0][0] ^= 1;
+            ASSERT_THROW(aes.decryptSiv(expected, &key, aad), std::runtime_error);
+        }
+
+        // deterministic without associated data, last block at every offset
+        AES::Key key = Base16::fromString("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f202122232425262728292a2b2c2d2e2f");
+        ByteArray input(3001);
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            input[i] = static_cast<byte>(i * 7);
+        }
+        ByteArray cipher = aes.encryptSiv(ByteArray(input.begin(), input.begin() + 17), &key);
+        ASSERT_EQ(Base16::fromString("a301eea9808d9717763d3af105a7dc113603b26eb3fd7cdd73fc70862c2d751fed"), cipher);
+        cipher = aes.encryptSiv(input, &key);
+        ASSERT_EQ(Base16::fromString("8c8f8de83aaa27b0028d7d9f5e652947"), ByteArray(cipher.begin(), cipher.begin() + 16));
+        ASSERT_EQ(cipher, aes.encryptSiv(input, &key));
+        ASSERT_EQ(input, aes.decryptSiv(cipher, &key));
+
+        // batch gives same result as one at a time
+        AES aesSiv(ByteArray(key.begin(), key.begin() + 24));
+        AES::Key ctrKey(key.begin() + 24, key.end());
+        std::vector<std::size_t> lengths = { 0, 1, 15, 16, 17, 31, 32, 33, 100, 3001, 1024, 2000, 16, 5 };
+        std::vector<ByteArray> outputs;
+        std::vector<ByteArray> plains;
+        std::vector<AES::Message> messages;
+        for (std::size_t length : lengths) {
+            outputs.push_back(ByteArray(length + 16));
+            plains.push_back(ByteArray(length));
+        }
+        for (std::size_t i = 0; i < lengths.size(); ++i) {
+            messages.push_back({ input.data() + i, lengths[i], outputs[i].data(), nullptr });
+        }
+        aesSiv.encrSivBatch(messages.data(), messages.size(), &ctrKey);
+        for (std::size_t i = 0; i < lengths.size(); ++i) {
+            ByteArray one(lengths[i] + 16);
+            aesSiv.encrSiv(input.data() + i, lengths[i], one.data(), &ctrKey);
+            ASSERT_EQ(one, outputs[i]);
+            messages[i] = { outputs[i].data(), outputs[i].size(), plains[i].data(), nullptr };
+        }
+        outputs[3][20] ^= 1;
+        bool authentic[14];
+        ASSERT_FALSE(aesSiv.decrSivBatch(messages.data(), messages.size(), &ctrKey, authentic));
+        for (std::size_t i = 0; i < lengths.size(); ++i) {
+            ASSERT_EQ(i != 3, authentic[i]);
+            ASSERT_EQ(i == 3 ? ByteArray(lengths[i]) : ByteArray(input.begin() + i, input.begin() + i + lengths[i]), plains[i]);
+        }
+        outputs[3][20] ^= 1;
+        ASSERT_TRUE(aesSiv.decrSivBatch(messages.data(), messages.size(), &ctrKey, authentic));
+    }
+
+    AES::Key key = MineCommon::generateRandomBytes(32);
+    AES::Key badKey(40, 0x01);
+    ASSERT_THROW(aes.encryptSiv(ByteArray(10), &badKey), std::invalid_argument);
+    ASSERT_THROW(aes.decryptSiv(ByteArray(15), &key), std::invalid_argument);
+    ASSERT_THROW(aes.encryptSiv(ByteArray(10), &key, std::vector<ByteArray>(127)), std::invalid_argument);
+    AES aesSiv(ByteArray(key.begin(), key.begin() + 16));
+    ByteArray output(26);
+    ASSERT_THROW(aesSiv.encrSiv(output.data(), 10, output.data(), &badKey), std::invalid_argument);
+}
+
+TEST(AESTest, CfbOfbCipher)
+{
+    AESSettingsGuard settings;
+
+    // NIST SP 800-38A F.3.13, F.3.7 and F.4.1
+    AES::Key key = Base16::fromString("2b7e151628aed2a6abf7158809cf4f3c");
+    ByteArray iv = Base16::fromString("000102030405060708090a0b0c0d0e0f");
+    ByteArray input = Base16::fromString("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                         "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    ByteArray cfb128 = Base16::fromString("3b3fd92eb72dad20333449f8e83cfb4ac8a64537a0b3a93fcde3cdad9f1ce58b"
+                                          "26751f67a3cbb140b1808cf187a4f4dfc04b05357c5d1c0eeac4c66f9ff7f2e6");
+    ByteArray cfb8 = Base16::fromString("3b79424c9c0dd436bace9e0ed4586a4f32b9ded50ae3ba69d472e88267fb5052"
+                                        "70cbad1e257691f7c47c5038297edda32ff26d0ed19174096161ecc14086dd62");
+    ByteArray ofb = Base16::fromString("3b3fd92eb72dad20333449f8e83cfb4a7789508d16918f03f53c52dac54ed825"
+                                       "9740051e9c5fecf64344f7a82260edcc304c6528f659c77866a510d9c1d6ae5e");
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        ASSERT_EQ(cfb128, aes.encryptCfb(input, &key, iv));
+        ASSERT_EQ(input, aes.decryptCfb(cfb128, &key, iv));
+        ASSERT_EQ(cfb8, aes.encryptCfb(input, &key, iv, 1));
+        ASSERT_EQ(input, aes.decryptCfb(cfb8, &key, iv, 1));
+        ASSERT_EQ(ofb, aes.encryptOfb(input, &key, iv));
+        ASSERT_EQ(input, aes.decryptOfb(ofb, &key, iv));
+
+        // F.3.8, CFB8-AES256 (first 29 bytes)
+        AES::Key key256 = Base16::fromString("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+        ByteArray partial(input.begin(), input.begin() + 29);
+        ASSERT_EQ(Base16::fromString("dc1f1a8520a64db55fcc8ac554844e889700adc6e10c63cf2d8cd2d8ce"), aes.encryptCfb(partial, &key256, iv, 1));
+
+        // partial segments, cipher text of part of input is same part of full cipher text
+        AES aesStream(key);
+        ByteArray longInput = MineCommon::generateRandomBytes(2000);
+        for (std::size_t segmentSize : { 1, 5, 8, 15, 16 }) {
+            ByteArray full = aesStream.encrCfb(longInput, iv, segmentSize);
+            for (std::size_t length : { 0, 1, 15, 16, 17, 33, 1025, 1999 }) {
+                ByteArray part(longInput.begin(), longInput.begin() + length);
+                ByteArray cipher = aesStream.encrCfb(part, iv, segmentSize);
+                ASSERT_EQ(ByteArray(full.begin(), full.begin() + length), cipher);
+                ASSERT_EQ(part, aesStream.decrCfb(cipher, iv, segmentSize));
+            }
+            ASSERT_EQ(longInput, aesStream.decrCfb(full, iv, segmentSize));
+        }
+        ByteArray full = aesStream.encrOfb(longInput, iv);
+        for (std::size_t length : { 0, 1, 15, 16, 17, 33, 1025, 1999 }) {
+            ByteArray part(longInput.begin(), longInput.begin() + length);
+            ByteArray cipher = aesStream.encrOfb(part, iv);
+            ASSERT_EQ(ByteArray(full.begin(), full.begin() + length), cipher);
+            ASSERT_EQ(part, aesStream.decrOfb(cipher, iv));
+
+            // key stream made ahead of time
+            ByteArray keyStream(length);
+            aesStream.ofbKeyStream(iv.data(), length, keyStream.data());
+            for (std::size_t i = 0; i < length; ++i) {
+                keyStream[i] ^= part[i];
+            }
+            ASSERT_EQ(cipher, keyStream);
+        }
+
+        // large input deciphered on multiple threads, in-place
+        for (std::size_t segmentSize : { 1, 16 }) {
+            ByteArray large = MineCommon::generateRandomBytes((AES::kMinBlocksPerThread * segmentSize * 3) + 7);
+            ByteArray cipher(large.size());
+            aesStream.encrCfb(large.data(), large.size(), cipher.data(), iv.data(), segmentSize);
+            AES::setThreadCount(4);
+            aesStream.decrCfb(cipher.data(), cipher.size(), cipher.data(), iv.data(), segmentSize);
+            ASSERT_EQ(large, cipher);
+        }
+
+        // in-place encryption
+        ByteArray inPlace = longInput;
+        aesStream.encrCfb(inPlace.data(), inPlace.size(), inPlace.data(), iv.data());
+        ASSERT_EQ(aesStream.encrCfb(longInput, iv), inPlace);
+        inPlace = longInput;
+        aesStream.encrOfb(inPlace.data(), inPlace.size(), inPlace.data(), iv.data());
+        ASSERT_EQ(full, inPlace);
+    }
+
+    ASSERT_THROW(aes.encryptCfb(input, &key, ByteArray(15)), std::invalid_argument);
+    ASSERT_THROW(aes.encryptOfb(input, &key, ByteArray(17)), std::invalid_argument);
+    ASSERT_THROW(aes.encryptCfb(input, &key, iv, 0), std::invalid_argument);
+    ASSERT_THROW(aes.decryptCfb(input, &key, iv, 17), std::invalid_argument);
+}
+
+TEST(AESTest, Cmac)
+{
+    AESSettingsGuard settings;
+
+    // RFC 4493 Sec. 4 and NIST SP 800-38B D.3
+    AES::Key key = Base16::fromString("2b7e151628aed2a6abf7158809cf4f3c");
+    ByteArray message = Base16::fromString("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                           "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    const std::vector<std::pair<std::size_t, std::string>> vectors = {
+        { 0, "bb1d6929e95937287fa37d129b756746" },
+        { 16, "070a16b46b4d4144f79bdd9dd04a287c" },
+        { 40, "dfa66747de9ae63030ca32611497c827" },
+        { 64, "51f0bebf7e3b9d92fc49741779363cfe" },
+    };
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        AES aesCmac;
+        AESCmac stream(key);
+        for (const auto& vector : vectors) {
+            ByteArray input(message.begin(), message.begin() + vector.first);
+            ByteArray expected = Base16::fromString(vector.second);
+            ASSERT_EQ(expected, aesCmac.cmac(input, &key));
+            ASSERT_TRUE(aesCmac.verifyCmac(input, &key, expected));
+            ASSERT_EQ(ByteArray(expected.begin(), expected.begin() + 8), aesCmac.cmac(input, &key, 8));
+
+            // chunk by chunk, same subkeys for every message
+            for (std::size_t chunk : { 1, 7, 16, 17 }) {
+                stream.reset();
+                for (std::size_t offset = 0; offset < input.size(); offset += chunk) {
+                    stream.update(ByteArray(input.begin() + offset, input.begin() + std::min(offset + chunk, input.size())));
+                }
+                ASSERT_EQ(expected, stream.final());
+            }
+        }
+
+        AES::Key key256 = Base16::fromString("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+        ASSERT_EQ(Base16::fromString("aaf3d8f1de5640c232f5b169b9c911e6"), aesCmac.cmac(ByteArray(message.begin(), message.begin() + 40), &key256));
+
+        // long message in batches
+        ByteArray longMessage = MineCommon::generateRandomBytes(5000);
+        ByteArray tag = aesCmac.cmac(longMessage, &key);
+        stream.reset();
+        stream.update(ByteArray(longMessage.begin(), longMessage.begin() + 1234));
+        stream.update(ByteArray(longMessage.begin() + 1234, longMessage.end()));
+        ASSERT_EQ(tag, stream.final());
+        longMessage[4999] ^= 1;
+        ASSERT_FALSE(aesCmac.verifyCmac(longMessage, &key, tag));
+    }
+
+    // subkeys are derived when key is set
+    AES aesCmac(key);
+    ASSERT_EQ(Base16::fromString("fbeed618357133667c85e08f7236a8de"), ByteArray(aesCmac.m_cmacSubkeys, aesCmac.m_cmacSubkeys + 16));
+    ASSERT_EQ(Base16::fromString("f7ddac306ae266ccf90bc11ee46d513b"), ByteArray(aesCmac.m_cmacSubkeys + 16, aesCmac.m_cmacSubkeys + 32));
+    AES::Key otherKey(16, 0x11);
+    aesCmac.setKey(otherKey);
+    ASSERT_NE(Base16::fromString("fbeed618357133667c85e08f7236a8de"), ByteArray(aesCmac.m_cmacSubkeys, aesCmac.m_cmacSubkeys + 16));
+    aesCmac.setKey(key);
+
+    AESCmac stream(key);
+    stream.final();
+    ASSERT_THROW(stream.update(message), std::runtime_error);
+    ASSERT_THROW(stream.final(), std::runtime_error);
+    ASSERT_THROW(aesCmac.cmac(message, &key, 0), std::invalid_argument);
+    ASSERT_THROW(aesCmac.cmac(message, &key, 17), std::invalid_argument);
+    ASSERT_THROW(AESCmac(ByteArray(10)), std::invalid_argument);
+}
+
+TEST(AESTest, KeyWrap)
+{
+    AESSettingsGuard settings;
+
+    // RFC 3394 Sec. 4.1, 4.4 and 4.6
+    const std::vector<std::vector<std::string>> vectors = {
+        { "000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff", "1fa68b0a8112b447aef34bd8fb5a7b829d3e862371d2cfe5" },
+        { "000102030405060708090a0b0c0d0e0f1011121314151617", "00112233445566778899aabbccddeeff0001020304050607", "031d33264e15d33268f24ec260743edce1c6c7ddee725a936ba814915c6762d2" },
+        { "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", "00112233445566778899aabbccddeeff000102030405060708090a0b0c0d0e0f", "28c9f404c4b810f4cbccb35cfb87f8263f5786e2d80ed326cbc7f0e71a99f43bfb988b9b7a02dd21" },
+    };
+    // RFC 5649 Sec. 6
+    const std::vector<std::vector<std::string>> paddedVectors = {
+        { "5840df6e29b02af1ab493b705bf16ea1ae8338f4dcc176a8", "c37b7e6492584340bed12207808941155068f738", "138bdeaa9b8fa7fc61f97742e72248ee5ae6ae5360d1ae6a5f54f373fa543b6a" },
+        { "5840df6e29b02af1ab493b705bf16ea1ae8338f4dcc176a8", "466f7250617369", "afbeb0f07dfbf5419200f2ccb50bb24f" },
+    };
+
+    for (AES::Engine engine : { AES::Engine::Portable, AES::Engine::Bitsliced, AES::Engine::AesNi, AES::Engine::Vaes }) {
+        if (!AES::isEngineSupported(engine)) {
+            continue;
+        }
+        AES::setEngine(engine);
+
+        for (const auto& vector : vectors) {
+            AES::Key kek = Base16::fromString(vector[0]);
+            ByteArray keyData = Base16::fromString(vector[1]);
+            ByteArray wrapped = Base16::fromString(vector[2]);
+            ASSERT_EQ(wrapped, aes.wrapKey(keyData, &kek));
+            ASSERT_EQ(keyData, aes.unwrapKey(wrapped, &kek));
+            wrapped[5] ^= 1;
+            ASSERT_THROW(aes.unwrapKey(wrapped, &kek), std::runtime_error);
+        }
+        for (const auto& vector : paddedVectors) {
+            AES::Key kek = Base16::fromString(vector[0]);
+            ByteArray keyData = Base16::fromString(vector[1]);
+            ByteArray wrapped = Base16::fromString(vector[2]);
+            ASSERT_EQ(wrapped, aes.wrapKey(keyData, &kek, true));
+            ASSERT_EQ(keyData, aes.unwrapKey(wrapped, &kek, true));
+            wrapped[wrapped.size() - 1] ^= 1;
+            ASSERT_THROW(aes.unwrapKey(wrapped, &kek, true), std::runtime_error);
+        }
+
+        // keys of different lengths in batch, more than a batch of lanes
+        AES aesKek(MineCommon::generateRandomBytes(32));
+        for (bool padding : { false, true }) {
+            std::vector<ByteArray> keys;
+            std::vector<ByteArray> wrappedKeys;
+            for (std::size_t i = 0; i < 21; ++i) {
+                const std::size_t length = padding ? 1 + (i * 3) : 16 + ((i % 5) * 8);
+                keys.push_back(MineCommon::generateRandomBytes(length));
+                ByteArray wrapped(AES::wrappedKeySize(length, padding));
+                ASSERT_EQ(wrapped.size(), aesKek.wrapKey(keys.back().data(), length, wrapped.data(), padding));
+                wrappedKeys.push_back(wrapped);
+            }
+            // tamper one of them
+            wrappedKeys[9][3] ^= 0x80;
+
+            std::vector<ByteArray> unwrapped(keys.size());
+            std::vector<AES::Message> messages;
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                unwrapped[i].resize(wrappedKeys[i].size() - 8);
+                messages.push_back({ wrappedKeys[i].data(), wrappedKeys[i].size(), unwrapped[i].data(), nullptr });
+            }
+            std::vector<std::size_t> lengths(keys.size());
+            ASSERT_FALSE(aesKek.unwrapKeyBatch(messages.data(), messages.size(), lengths.data(), padding));
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                if (i == 9) {
+                    ASSERT_EQ(0, lengths[i]);
+                    ASSERT_EQ(ByteArray(unwrapped[i].size(), 0), unwrapped[i]);
+                } else {
+                    ASSERT_EQ(keys[i].size(), lengths[i]);
+                    ASSERT_EQ(keys[i], ByteArray(unwrapped[i].begin(), unwrapped[i].begin() + lengths[i]));
+                }
+            }
+
+            // in-place
+            wrappedKeys[9][3] ^= 0x80;
+            ASSERT_EQ(keys[9].size(), aesKek.unwrapKey(wrappedKeys[9].data(), wrappedKeys[9].size(), wrappedKeys[9].data(), padding));
+            ASSERT_EQ(keys[9], ByteArray(wrappedKeys[9].begin(), wrappedKeys[9].begin() + keys[9].size()));
+        }
+    }
+
+    AES::Key kek = Base16::fromString(vectors[0][0]);
+    ASSERT_THROW(aes.wrapKey(ByteArray(8), &kek), std::invalid_argument);
+    ASSERT_THROW(aes.wrapKey(ByteArray(20), &kek), std::invalid_argument);
+    ASSERT_THROW(aes.wrapKey(ByteArray(), &kek, true), std::invalid_argument);
+    ASSERT_THROW(aes.unwrapKey(ByteArray(16), &kek), std::invalid_argument);
+    ASSERT_THROW(aes.unwrapKey(ByteArray(20), &kek, true), std::invalid_argument);
+    ASSERT_EQ(24, AES::wrappedKeySize(16));
+    ASSERT_EQ(16, AES::wrappedKeySize(7, true));
+    ASSERT_EQ(32, AES::wrappedKeySize(20, true));
+}
+
+TEST(AESTest, SharedContext)
+{
+    // const instance does not change so all threads use it at a time
+    const AES::Key key = MineCommon::generateRandomBytes(32);
+    const AES::Key tweakKey = MineCommon::generateRandomBytes(32);
+    const ByteArray iv = MineCommon::generateRandomBytes(16);
+    const ByteArray aad = MineCommon::generateRandomBytes(20);
+    const AES context(key);
+
+    std::vector<ByteArray> messages;
+    std::vector<ByteArray> expectedCbc;
+    std::vector<ByteArray> expectedCtr;
+    std::vector<ByteArray> expectedXts;
+    std::vector<ByteArray> expectedTags;
+    AES single(key);
+    for (std::size_t i = 0; i < 16; ++i) {
+        // byte array CBC adds no padding to whole blocks, so decr() could strip plain text that looks like padding
+        messages.push_back(MineCommon::generateRandomBytes(31 + (i * 96)));
+        ByteArray cbcIv = iv;
+        expectedCbc.push_back(single.encr(messages[i], cbcIv));
+        expectedCtr.push_back(single.encrCtr(messages[i], iv));
+        ByteArray xts(messages[i].size());
+        single.encrXts(messages[i].data(), messages[i].size(), xts.data(), &tweakKey, i);
+        expectedXts.push_back(xts);
+        expectedTags.push_back(single.cmac(messages[i], &key));
+    }
+
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < 8; ++t) {
+        workers.emplace_back([&, t]() {
+            // exception on a thread would terminate the test run
+            try {
+                for (std::size_t round = 0; round < 40; ++round) {
+                    const std::size_t i = (t + round) % messages.size();
+                    const ByteArray& message = messages[i];
+
+                    ByteArray cbcIv = iv;
+                    ByteArray cipher = context.encr(message, cbcIv);
+                    failures += cipher != expectedCbc[i] || context.decr(cipher, cbcIv) != message;
+
+                    failures += context.encrCtr(message, iv) != expectedCtr[i];
+
+                    ByteArray xts(message.size());
+                    context.encrXts(message.data(), message.size(), xts.data(), &tweakKey, i);
+                    failures += xts != expectedXts[i];
+
+                    byte tag[16];
+                    context.cmac(message.data(), message.size(), tag);
+                    failures += ByteArray(tag, tag + 16) != expectedTags[i];
+
+                    ByteArray gcmIv(iv.begin(), iv.begin() + 12);
+                    ByteArray gcmTag;
+                    ByteArray gcm = context.encrGcm(message, gcmIv, aad, gcmTag);
+                    failures += context.decrGcm(gcm, gcmIv, aad, gcmTag) != message;
+                }
+            } catch (const std::exception&) {
+                ++failures;
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    ASSERT_EQ(0, failures.load());
+
+    // keyed functions still change the key
+    AES::Key otherKey = MineCommon::generateRandomBytes(16);
+    ByteArray otherIv = iv;
+    ASSERT_EQ(single.encrypt(messages[0], &otherKey, otherIv), AES(otherKey).encr(messages[0], otherIv));
+    ASSERT_EQ(otherKey, single.m_key);
 
+    const AES noKey;
+    ASSERT_THROW(noKey.encr(messages[0]), std::runtime_error);
 }
 
 //
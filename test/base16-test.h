@@ -60,6 +60,10 @@ TEST(Base16Test, EncodeByteArray)
     for (const auto& item : Base16ByteArrayEncodingTestData) {
         std::string encoded = Base16::encode(PARAM(0).begin(), PARAM(0).end());
         ASSERT_STRCASEEQ(PARAM(1).c_str(), encoded.c_str());
+
+        std::string appended = "00";
+        Base16::encode(PARAM(0).begin(), PARAM(0).end(), std::back_inserter(appended));
+        ASSERT_STRCASEEQ(("00" + PARAM(1)).c_str(), appended.c_str());
     }
 }
 
@@ -74,6 +78,11 @@ TEST(Base16Test, ConvertToByteArray)
     for (const auto& item : Base16FromStringData) {
         ByteArray result = Base16::fromString(PARAM(0));
         ASSERT_EQ(PARAM(1), result);
+
+        ByteArray appended = { 0x01 };
+        Base16::fromString(PARAM(0), &appended);
+        ASSERT_EQ(0x01, appended[0]);
+        ASSERT_EQ(PARAM(1), ByteArray(appended.begin() + 1, appended.end()));
     }
 }
 
@@ -102,6 +102,14 @@ TEST(Base64Test, ByteArrayEncode)
     for (const auto& item : Base64ByteArrayEncodingTestData) {
         std::string encoded = Base64::encode(PARAM(0).begin(), PARAM(0).end());
         ASSERT_STREQ(PARAM(1).c_str(), encoded.c_str());
+
+        std::string appended = "AA";
+        Base64::encode(PARAM(0).begin(), PARAM(0).end(), std::back_inserter(appended));
+        ASSERT_STREQ(("AA" + PARAM(1)).c_str(), appended.c_str());
+
+        std::vector<int> decoded;
+        Base64::decode(encoded.begin(), encoded.end(), std::back_inserter(decoded));
+        ASSERT_EQ(PARAM(0), decoded);
     }
 }
 